@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Convert the Keras PNet weights (.weights.h5) into the binary model
+container read by model.c (MODEL_load / MODEL_map).
+
+    python3 convert_model.py "h5 model/p_net.weights.h5" p_net.bin
+
+The .weights.h5 file only holds variables, so the graph is described by
+PNET_GRAPH below. Layout (little endian, every field a u32):
+
+    header   MODEL_HEADER_WORDS words
+    records  layer_count * MODEL_RECORD_WORDS words
+    blob     float32 arrays, each 16 byte aligned, offsets relative to blob
+
+3x3 weights are stored [out][in][9] with taps in row-major order, 1x1
+weights [out][in]. Biases and PReLU alphas are one value per output.
+"""
+
+import struct
+import sys
+
+import h5py
+import numpy as np
+
+MODEL_MAGIC         = 0x4C444D50    # "PMDL"
+MODEL_VERSION       = 1
+MODEL_HEADER_WORDS  = 16
+MODEL_RECORD_WORDS  = 16
+MODEL_ALIGN         = 16
+
+# must match LAYER_TYPE and LAYER_ACTIVATION
+LAYER_TYPE_CNN_1X1, LAYER_TYPE_CNN_2X2, LAYER_TYPE_CNN_3X3, LAYER_TYPE_MAXPOOLING = range(4)
+LAYER_ACTIVATION_RELU, LAYER_ACTIVATION_SOFTMAX, LAYER_ACTIVATION_SIGMOID, LAYER_ACTIVATION_NOT_REQUIRED = range(4)
+
+INPUT_CHANNELS = 3
+INPUT_SIZE     = 100
+
+# (type, activation, source, conv vars, prelu vars, kernel, stride, padding)
+# source is the producer index, None for the network input
+PNET_GRAPH = [
+    (LAYER_TYPE_CNN_3X3,    LAYER_ACTIVATION_RELU,         None, "conv2d",   "p_re_lu",   3, 1, 0),
+    (LAYER_TYPE_MAXPOOLING, LAYER_ACTIVATION_NOT_REQUIRED, 0,    None,       None,        2, 2, 0),
+    (LAYER_TYPE_CNN_3X3,    LAYER_ACTIVATION_RELU,         1,    "conv2d_1", "p_re_lu_1", 3, 1, 0),
+    (LAYER_TYPE_CNN_3X3,    LAYER_ACTIVATION_RELU,         2,    "conv2d_2", "p_re_lu_2", 3, 1, 0),
+    (LAYER_TYPE_CNN_1X1,    LAYER_ACTIVATION_SOFTMAX,      3,    "conv2d_3", None,        1, 1, 0),
+    (LAYER_TYPE_CNN_1X1,    LAYER_ACTIVATION_NOT_REQUIRED, 3,    "conv2d_4", None,        1, 1, 0),
+]
+
+
+def align(value):
+    return (value + MODEL_ALIGN - 1) & ~(MODEL_ALIGN - 1)
+
+
+class Blob:
+    def __init__(self):
+        self.data = bytearray()
+
+    def add(self, array):
+        if array is None:
+            return 0, 0
+        array = np.ascontiguousarray(array, dtype="<f4").ravel()
+        offset = len(self.data)
+        self.data += array.tobytes()
+        self.data += bytes(align(len(self.data)) - len(self.data))
+        return offset, array.size
+
+
+def convert(h5_path, out_path):
+    h5     = h5py.File(h5_path, "r")
+    blob   = Blob()
+    records = []
+    channels = []
+
+    for index, (kind, activation, source, conv, prelu, kernel, stride, padding) in enumerate(PNET_GRAPH):
+        in_channels = INPUT_CHANNELS if source is None else channels[source]
+        weights = bias = alpha = None
+
+        if conv is not None:
+            w    = np.array(h5["layers/%s/vars/0" % conv])      # (kh, kw, in, out)
+            bias = np.array(h5["layers/%s/vars/1" % conv])
+            if w.shape[2] != in_channels:
+                raise ValueError("%s expects %d inputs, graph gives %d" % (conv, w.shape[2], in_channels))
+            weights = w.transpose(3, 2, 0, 1)                   # (out, in, kh, kw)
+            out_channels = w.shape[3]
+        else:
+            out_channels = in_channels
+
+        if prelu is not None:
+            alpha = np.array(h5["layers/%s/vars/0" % prelu]).ravel()
+
+        weights_offset, weights_count = blob.add(weights)
+        bias_offset,    bias_count    = blob.add(bias)
+        alpha_offset,   alpha_count   = blob.add(alpha)
+
+        records.append([kind, activation, index if source is None else source,
+                        in_channels, out_channels, kernel, stride, padding,
+                        weights_offset, weights_count, bias_offset, bias_count,
+                        alpha_offset, alpha_count, 0, 0])
+        channels.append(out_channels)
+
+    header_size = MODEL_HEADER_WORDS * 4
+    blob_offset = align(header_size + len(records) * MODEL_RECORD_WORDS * 4)
+    header = [MODEL_MAGIC, MODEL_VERSION, header_size, len(records),
+              INPUT_CHANNELS, INPUT_SIZE, INPUT_SIZE, MODEL_RECORD_WORDS * 4,
+              blob_offset, len(blob.data)] + [0] * (MODEL_HEADER_WORDS - 10)
+
+    with open(out_path, "wb") as out:
+        out.write(struct.pack("<%dI" % MODEL_HEADER_WORDS, *header))
+        for record in records:
+            out.write(struct.pack("<%dI" % MODEL_RECORD_WORDS, *record))
+        out.write(bytes(blob_offset - out.tell()))
+        out.write(blob.data)
+
+    print("%s: %d layers, %d blob bytes" % (out_path, len(records), len(blob.data)))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print("usage: %s <weights.h5> <model.bin>" % sys.argv[0])
+        sys.exit(1)
+    convert(sys.argv[1], sys.argv[2])
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Report the zero weights of a model container written by convert_model.py
+and optionally prune it.
+
+    python3 sparsity.py p_net.bin
+    python3 sparsity.py p_net.bin --prune 0.3 p_net_pruned.bin
+
+Without --prune every layer's zero taps, all zero 3x3 kernels and kernel L1
+norms are printed. --prune R zeroes, per 3x3 layer, the fraction R of
+(out, in) kernels with the smallest L1 norm and writes a new container; the
+target drops those kernels from its channel lists (SPARSITY_prune) and runs
+layers that end up sparse enough on CONV_BACKEND_CPU_SPARSE. The result has
+to be checked against the reference outputs, nothing here retrains.
+"""
+
+import argparse
+import struct
+
+import numpy as np
+
+from convert_model import (MODEL_MAGIC, MODEL_HEADER_WORDS, MODEL_RECORD_WORDS,
+                           LAYER_TYPE_CNN_1X1, LAYER_TYPE_CNN_3X3)
+
+TYPE_NAMES = {LAYER_TYPE_CNN_1X1: "1x1", LAYER_TYPE_CNN_3X3: "3x3"}
+
+
+def load(path):
+    data   = bytearray(open(path, "rb").read())
+    header = struct.unpack_from("<%dI" % MODEL_HEADER_WORDS, data, 0)
+    if header[0] != MODEL_MAGIC:
+        raise ValueError("%s is not a model container" % path)
+
+    layer_count, record_size, blob_offset = header[3], header[7], header[8]
+    records = [struct.unpack_from("<%dI" % MODEL_RECORD_WORDS, data, header[2] + index * record_size)
+               for index in range(layer_count)]
+    return data, records, blob_offset
+
+
+def weights(data, record, blob_offset):
+    kind, in_channels, out_channels = record[0], record[3], record[4]
+    offset, count = record[8], record[9]
+    if kind not in TYPE_NAMES or count == 0:
+        return None, None
+    start = blob_offset + offset
+    array = np.frombuffer(data, dtype="<f4", count=count, offset=start)
+    taps  = 9 if kind == LAYER_TYPE_CNN_3X3 else 1
+    return array.reshape(out_channels, in_channels, taps), start
+
+
+def report(data, records, blob_offset):
+    print("layer, type, weights, zero weights, kernels, zero kernels, min / median / max kernel L1")
+    for index, record in enumerate(records):
+        w, _ = weights(data, record, blob_offset)
+        if w is None:
+            continue
+        norms = np.abs(w).sum(axis=2).ravel()
+        print("%d, %s, %d, %d, %d, %d, %.4g / %.4g / %.4g" % (
+            index + 1, TYPE_NAMES[record[0]], w.size, int((w == 0).sum()), norms.size,
+            int((norms == 0).sum()), norms.min(), np.median(norms), norms.max()))
+
+
+def prune(data, records, blob_offset, ratio):
+    for index, record in enumerate(records):
+        w, start = weights(data, record, blob_offset)
+        if w is None or record[0] != LAYER_TYPE_CNN_3X3:
+            continue
+        w      = w.copy()
+        norms  = np.abs(w).sum(axis=2)
+        count  = int(ratio * norms.size)
+        # one kernel per output channel stays, so no channel loses every input
+        order  = [k for k in np.argsort(norms, axis=None) if norms.ravel()[k] != norms[k // norms.shape[1]].max()]
+        for k in order[:count]:
+            w[k // norms.shape[1], k % norms.shape[1], :] = 0.0
+        data[start:start + w.nbytes] = w.astype("<f4").tobytes()
+        print("layer %d: %d of %d kernels zeroed" % (index + 1, min(count, len(order)), norms.size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("model")
+    parser.add_argument("--prune", nargs=2, metavar=("RATIO", "OUT"))
+    args = parser.parse_args()
+
+    data, records, blob_offset = load(args.model)
+    if args.prune is not None:
+        prune(data, records, blob_offset, float(args.prune[0]))
+        open(args.prune[1], "wb").write(data)
+    report(data, records, blob_offset)
+
+
+if __name__ == "__main__":
+    main()
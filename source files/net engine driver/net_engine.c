@@ -16,6 +16,8 @@
 #include "time_measure.h"
 #endif
 
+#include "trace.h"
+
 /***************************** Defines   *******************************/
 #define RESET_TIMEOUT_COUNTER           10000
 
@@ -28,13 +30,13 @@
 #define NET_ENGINE_INPUT_ROW_LENGTH     100
 #define NET_ENGINE_OUTPUT_ROW_LENGTH    98
 
-#define NET_ENGINE_TOTAL_DMA_SEND_LENGTH(x)     ((x+2) * (x+2) * 4)
-#define NET_ENGINE_TOTAL_DMA_RECEIVE_LENGTH(x)  (x * x * 4)
-#define NET_ENGINE_INITIAL_SEND_LENGTH(x)       ((x+2) * 4 * 3)
-#define NET_ENGINE_SEND_LENGTH(x)               ((x+2) * 4)
+#define NET_ENGINE_TOTAL_DMA_SEND_LENGTH(h, w)      (((h)+2) * ((w)+2) * 4)
+#define NET_ENGINE_TOTAL_DMA_RECEIVE_LENGTH(h, w)   ((h) * (w) * 4)
+#define NET_ENGINE_INITIAL_SEND_LENGTH(w)           (((w)+2) * 4 * 3)
+#define NET_ENGINE_SEND_LENGTH(w)                   (((w)+2) * 4)
 
-#define DCACHE_FLUSH_INPUT_LENGTH(x)            ((x+2) *(x+2) * 4)
-#define DCACHE_FLUSH_OUTPUT_LENGTH(x)           (x     *   x  * 4)
+#define DCACHE_FLUSH_INPUT_LENGTH(h, w)             (((h)+2) * ((w)+2) * 4)
+#define DCACHE_FLUSH_OUTPUT_LENGTH(h, w)            ((h)     *  (w)    * 4)
 
 #define REG_DUMP(reg, value) xil_printf("\tReg %s - %08X \r\n", #reg, value )
 
@@ -46,6 +48,51 @@ static int count = 0;
 static int img_received = 1;
 
 /************************** Function Definitions ***************************/
+// skips ranges already written back in this epoch, input planes are shared
+// by every output channel of a layer and the temp slots are never CPU written
+static void NET_ENGINE_flush(Net_Engine_Inst *instance, UINTPTR base, u32 length){
+#ifndef NET_ENGINE_COHERENT_BUFFERS
+    Net_Engine_Cache *cache = &instance->cache;
+
+    for(u32 index = 0; index < cache->count; index++){
+        if(base >= cache->ranges[index].base && base + length <= cache->ranges[index].base + cache->ranges[index].length){
+            return;
+        }
+    }
+
+    Xil_DCacheFlushRange(base, length);
+
+    if(cache->count < NET_ENGINE_CLEAN_RANGES){
+        cache->ranges[cache->count].base   = base;
+        cache->ranges[cache->count].length = length;
+        cache->count++;
+    }
+#else
+    (void)instance;
+    (void)base;
+    (void)length;
+#endif
+}
+
+static void NET_ENGINE_invalidate(UINTPTR base, u32 length){
+#ifndef NET_ENGINE_COHERENT_BUFFERS
+    Xil_DCacheInvalidateRange(base, length);
+#else
+    (void)base;
+    (void)length;
+#endif
+}
+
+void NET_ENGINE_set_idle(Net_Engine_Inst *instance, Net_Engine_Idle_cb *cb, void *context){
+    instance->idle.cb      = cb;
+    instance->idle.context = context;
+}
+
+void NET_ENGINE_cache_reset(Net_Engine_Inst *instance){
+    instance->cache.count = 0;
+}
+
+
 u32 checkIdle(u32 baseAddress,u32 offset){
 	u32 status;
 	status = (XAxiDma_ReadReg(baseAddress,offset))&XAXIDMA_IDLE_MASK;
@@ -65,14 +112,16 @@ static void row_completed_ISR(void *CallBackRef){
 #endif
 
     instance = (Net_Engine_Inst*) CallBackRef;
+    TRACE_BEGIN_ISR("row isr", count);
 
     count++;
 	XScuGic_Disable(&(instance->intc_inst), instance->config.row_complete_isr_id);
     if(img_received){
-        status = XAxiDma_SimpleTransfer(&(instance->dma_inst), dma_input_ptr + 6 , NET_ENGINE_SEND_LENGTH(global_row_length), XAXIDMA_DMA_TO_DEVICE);
+        status = XAxiDma_SimpleTransfer(&(instance->dma_inst), dma_input_ptr + 6 , instance->transfer.row_send_length, XAXIDMA_DMA_TO_DEVICE);
         dma_input_ptr = dma_input_ptr + (global_row_length + 2);
 	}
 	XScuGic_Enable(&(instance->intc_inst), instance->config.row_complete_isr_id);
+    TRACE_END_ISR("row isr");
 
 #ifdef PROCESS_TIME_MEASURE
     measure_end(TIME_MEASURE_SIGNAL_4);
@@ -88,6 +137,7 @@ static void received_ISR(void *CallBackRef){
 
 	instance->cur_data.state = NET_STATE_COMPLETED;
     img_received = 0;
+    TRACE_INSTANT_ISR("receive isr", 0);
 }
 
 NET_STATUS NET_ENGINE_dma_setup(Net_Engine_Inst *instance, UINTPTR dmaaddr_p){
@@ -193,6 +243,10 @@ NET_STATUS NET_ENGINE_init(Net_Engine_Inst *instance, UINTPTR baseaddr_p, UINTPT
     NET_ENGINE_mWriteReg(instance->config.RegBase, NET_ENGINE_S00_AXI_SLV_REG7_OFFSET, NET_ENGINE_INPUT_ROW_LENGTH);
     NET_ENGINE_mWriteReg(instance->config.RegBase, NET_ENGINE_S00_AXI_SLV_REG8_OFFSET, NET_ENGINE_ENABLE_VALUE);
 
+    NET_ENGINE_transfer_init(&instance->transfer, NET_ENGINE_OUTPUT_ROW_LENGTH, NET_ENGINE_OUTPUT_ROW_LENGTH);
+    NET_ENGINE_cache_reset(instance);
+    NET_ENGINE_set_idle(instance, NULL, NULL);
+
     // NET_ENGINE_dump_regs(instance);
 
     ret = NET_ENGINE_dma_setup(instance, dmaaddr_p);
@@ -361,10 +415,35 @@ NET_STATUS NET_ENGINE_config_row_length(Net_Engine_Inst *instance, u32 row_lengt
     return NET_ENGINE_OK;
 }
 
+void NET_ENGINE_transfer_init(Net_Engine_Transfer *transfer, u32 height, u32 width){
+    transfer->height              = height;
+    transfer->row_length          = width;
+    transfer->initial_send_length = NET_ENGINE_INITIAL_SEND_LENGTH(width);
+    transfer->row_send_length     = NET_ENGINE_SEND_LENGTH(width);
+    transfer->receive_length      = NET_ENGINE_TOTAL_DMA_RECEIVE_LENGTH(height, width);
+    transfer->flush_input_length  = DCACHE_FLUSH_INPUT_LENGTH(height, width);
+    transfer->flush_output_length = DCACHE_FLUSH_OUTPUT_LENGTH(height, width);
+}
 
+// programs the input row length once and keeps the precomputed lengths for every kernel pass
+NET_STATUS NET_ENGINE_set_transfer(Net_Engine_Inst *instance, const Net_Engine_Transfer *transfer){
+    instance->transfer = *transfer;
+    return NET_ENGINE_config_row_length(instance, transfer->row_length + 2);
+}
 
-static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32 *output, u32 row_length){
+
+
+// arms the receive, flushes both buffers and sends the first three rows, the
+// row ISR streams the rest while the caller is free until NET_ENGINE_finish
+static NET_STATUS NET_ENGINE_begin(Net_Engine_Inst *instance, u32 *input, u32 *output, u32 row_length){
     NET_STATUS ret = NET_ENGINE_OK;
+    Net_Engine_Transfer transfer;
+
+    // square legacy callers, plan driven callers already programmed the transfer
+    if(row_length != instance->transfer.row_length){
+        NET_ENGINE_transfer_init(&transfer, row_length, row_length);
+        NET_ENGINE_set_transfer(instance, &transfer);
+    }
 
     instance->cur_data.input  = NULL;
     instance->cur_data.output = NULL;
@@ -375,7 +454,7 @@ static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32
     instance->cur_data.received_row_count = 0;
     instance->cur_data.send_row_count     = 0;
 
-    global_row_length = row_length;
+    global_row_length = instance->transfer.row_length;
     // dma_input_ptr     = input  + (NET_ENGINE_INPUT_ROW_LENGTH * 3);
     dma_input_ptr     = input  + (global_row_length * 3);
     
@@ -385,8 +464,8 @@ static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32
 
     NET_ENGINE_mWriteReg(instance->config.RegBase, NET_ENGINE_S00_AXI_SLV_REG8_OFFSET, NET_ENGINE_ENABLE_VALUE);
 
-    Xil_DCacheFlushRange((UINTPTR)input,  DCACHE_FLUSH_INPUT_LENGTH(global_row_length));
-    Xil_DCacheFlushRange((UINTPTR)output, DCACHE_FLUSH_OUTPUT_LENGTH(global_row_length));
+    NET_ENGINE_flush(instance, (UINTPTR)input,  instance->transfer.flush_input_length);
+    NET_ENGINE_flush(instance, (UINTPTR)output, instance->transfer.flush_output_length);
 
     // instance->cur_data.input = instance->cur_data.input + (NET_ENGINE_INPUT_ROW_LENGTH * 3);
     instance->cur_data.input = instance->cur_data.input + (global_row_length * 3);
@@ -396,25 +475,34 @@ static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32
 
     // NET_ENGINE_dump_regs(instance);
     img_received = 1;
-	ret = XAxiDma_SimpleTransfer(&(instance->dma_inst), (u32)output, NET_ENGINE_TOTAL_DMA_RECEIVE_LENGTH(global_row_length), XAXIDMA_DEVICE_TO_DMA);
+	ret = XAxiDma_SimpleTransfer(&(instance->dma_inst), (u32)output, instance->transfer.receive_length, XAXIDMA_DEVICE_TO_DMA);
     // ret = XAxiDma_SimpleTransfer(&(instance->dma_inst), (u32)output, 97*97*4, XAXIDMA_DEVICE_TO_DMA);
 	if(ret != XST_SUCCESS){
 		xil_printf("DMA Receive Transfer failed %d\n", ret);
 		return NET_ENGINE_FAIL;
 	}
 
-	ret = XAxiDma_SimpleTransfer(&(instance->dma_inst), (u32)input,  NET_ENGINE_INITIAL_SEND_LENGTH(global_row_length), XAXIDMA_DMA_TO_DEVICE);
+	ret = XAxiDma_SimpleTransfer(&(instance->dma_inst), (u32)input,  instance->transfer.initial_send_length, XAXIDMA_DMA_TO_DEVICE);
     // ret = XAxiDma_SimpleTransfer(&(instance->dma_inst), (u32)input,  100 * 3 * 4, XAXIDMA_DMA_TO_DEVICE);
 	if(ret != XST_SUCCESS){
 		xil_printf("DMA Transmit Transfer failed %d\n", ret);
 		return NET_ENGINE_FAIL;
 	}
 
+    return NET_ENGINE_OK;
+}
+
+static NET_STATUS NET_ENGINE_finish(Net_Engine_Inst *instance){
     int k = 0;
     
+    // the CPU only spins here while the engine streams rows
+    TRACE_BEGIN("engine wait", global_row_length);
     // while(instance->cur_data.state != NET_STATE_COMPLETED){
     while (img_received){
         // check_dma_status(&(instance->dma_inst));
+        if(instance->idle.cb != NULL){
+            instance->idle.cb(instance->idle.context);
+        }
         k++;
         // if(k>10){
         //     // XAxiDma_Pause(&(instance->dma_inst));
@@ -425,8 +513,10 @@ static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32
         // }
     }
 
+    TRACE_END("engine wait");
+
     // xil_printf("Completed \r\nOut : \n");
-    Xil_DCacheInvalidateRange((UINTPTR)output, DCACHE_FLUSH_OUTPUT_LENGTH(global_row_length));
+    NET_ENGINE_invalidate((UINTPTR)instance->cur_data.output, instance->transfer.flush_output_length);
 
     NET_ENGINE_mWriteReg(instance->config.RegBase, NET_ENGINE_S00_AXI_SLV_REG8_OFFSET, NET_ENGINE_DISABLE_VALUE);
     // NET_ENGINE_dump_regs(instance);
@@ -434,6 +524,17 @@ static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32
     return NET_ENGINE_OK;
 }
 
+static NET_STATUS NET_ENGINE_process(Net_Engine_Inst *instance, u32 *input, u32 *output, u32 row_length){
+    NET_STATUS ret = NET_ENGINE_OK;
+
+    ret = NET_ENGINE_begin(instance, input, output, row_length);
+    if(ret != NET_ENGINE_OK){
+        return ret;
+    }
+
+    return NET_ENGINE_finish(instance);
+}
+
 NET_STATUS NET_ENGINE_process_maxpooling(Net_Engine_Inst *instance, Net_Engine_Img *input, Net_Engine_Img *output){
     NET_STATUS ret = NET_ENGINE_OK;
 
@@ -488,6 +589,36 @@ static NET_STATUS NET_ENGINE_set_cnn_values(Net_Engine_Inst *instance, CNN_Confi
 
 
 
+static void NET_ENGINE_arm_intr(Net_Engine_Inst *instance){
+    XAxiDma_IntrDisable(&(instance->dma_inst), XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
+	XAxiDma_IntrAckIrq(&(instance->dma_inst), XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
+
+    XAxiDma_IntrEnable(&(instance->dma_inst), XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
+}
+
+static NET_STATUS NET_ENGINE_start_cnn(Net_Engine_Inst *instance, u32 *input, u32 *output, u32 row_length){
+    NET_STATUS ret = NET_ENGINE_OK;
+
+    NET_ENGINE_arm_intr(instance);
+
+// #ifdef NET_ENGINE_TIME_MEASURE
+//     measure_start();
+// #endif
+
+    ret = NET_ENGINE_process(instance, input, output, row_length);
+
+// #ifdef NET_ENGINE_TIME_MEASURE
+//     measure_end();
+// #endif
+
+    if(ret != XST_SUCCESS){
+		xil_printf("Net Engine Process failed\n");
+		return NET_ENGINE_FAIL;
+	}
+
+    return ret;
+}
+
 NET_STATUS NET_ENGINE_process_cnn(Net_Engine_Inst *instance, u32 *input, u32 *output, CNN_Config_Data data, u32 row_length){
     NET_STATUS ret = NET_ENGINE_OK;
 
@@ -517,22 +648,34 @@ NET_STATUS NET_ENGINE_process_cnn(Net_Engine_Inst *instance, u32 *input, u32 *ou
 		return NET_ENGINE_FAIL;
 	}
 
-    XAxiDma_IntrDisable(&(instance->dma_inst), XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
-	XAxiDma_IntrAckIrq(&(instance->dma_inst), XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
+    return NET_ENGINE_start_cnn(instance, input, output, row_length);
+}
 
-    XAxiDma_IntrEnable(&(instance->dma_inst), XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
+static void NET_ENGINE_set_cnn_words(Net_Engine_Inst *instance, const u32 *words){
+    NET_ENGINE_config(instance, NET_CONFIG_CNN);
 
-// #ifdef NET_ENGINE_TIME_MEASURE
-//     measure_start();
-// #endif
+    count = 0;
 
-    ret = NET_ENGINE_process(instance, input, output, row_length);
+    // bias and kernel registers are contiguous, one burst of ascending offsets
+    for(u32 index = 0; words != NULL && index < NET_ENGINE_CNN_CONFIG_WORDS; index++){
+        NET_ENGINE_mWriteReg(instance->config.RegBase, NET_ENGINE_BIAS_REG + (index * 4), words[index]);
+    }
+}
 
-// #ifdef NET_ENGINE_TIME_MEASURE
-//     measure_end();
-// #endif
+NET_STATUS NET_ENGINE_process_cnn_packed(Net_Engine_Inst *instance, u32 *input, u32 *output, const u32 *words, u32 row_length){
+    NET_ENGINE_set_cnn_words(instance, words);
 
-    if(ret != XST_SUCCESS){
+    return NET_ENGINE_start_cnn(instance, input, output, row_length);
+}
+
+NET_STATUS NET_ENGINE_start_cnn_packed(Net_Engine_Inst *instance, u32 *input, u32 *output, const u32 *words, u32 row_length){
+    NET_STATUS ret = NET_ENGINE_OK;
+
+    NET_ENGINE_set_cnn_words(instance, words);
+    NET_ENGINE_arm_intr(instance);
+
+    ret = NET_ENGINE_begin(instance, input, output, row_length);
+    if(ret != NET_ENGINE_OK){
 		xil_printf("Net Engine Process failed\n");
 		return NET_ENGINE_FAIL;
 	}
@@ -540,3 +683,14 @@ NET_STATUS NET_ENGINE_process_cnn(Net_Engine_Inst *instance, u32 *input, u32 *ou
     return ret;
 }
 
+NET_STATUS NET_ENGINE_wait(Net_Engine_Inst *instance){
+    if(instance->cur_data.state != NET_STATE_BUSY && instance->cur_data.state != NET_STATE_COMPLETED){
+        return NET_ENGINE_FAIL;
+    }
+
+    NET_ENGINE_finish(instance);
+    instance->cur_data.state = NET_STATE_IDLE;
+
+    return NET_ENGINE_OK;
+}
+
@@ -10,6 +10,11 @@
 #include "net_engine_type.h"
 
 /**************************** Type Definitions *****************************/
+
+// the activation arenas are non-cacheable or the DMA masters through the ACP,
+// the driver then skips all cache maintenance
+// #define NET_ENGINE_COHERENT_BUFFERS
+
 /**
  *
  * Write a value to a NET_ENGINE register. A 32 bit write is performed.
@@ -84,8 +89,43 @@ NET_STATUS NET_ENGINE_config(Net_Engine_Inst *instance, NET_CONFIG config);
 
 NET_STATUS NET_ENGINE_process_cnn(Net_Engine_Inst *instance, u32 *input, u32 *output, CNN_Config_Data data, u32 row_length);
 
+/**
+ * Same as NET_ENGINE_process_cnn with the configuration already laid out in
+ * register order (Bias, Kernal_1..Kernal_9), see PREPACK_engine_words.
+ * words may be NULL to run again with the kernel of the previous pass, e.g.
+ * for the following frames of a batch.
+ */
+NET_STATUS NET_ENGINE_process_cnn_packed(Net_Engine_Inst *instance, u32 *input, u32 *output, const u32 *words, u32 row_length);
+
+/**
+ * Non blocking half of NET_ENGINE_process_cnn_packed: loads the kernel and
+ * starts the transfers, the row ISR streams the remaining rows. The output
+ * buffer belongs to the engine until NET_ENGINE_wait returns, which spins
+ * for the receive ISR and invalidates it. One pass may be in flight.
+ */
+NET_STATUS NET_ENGINE_start_cnn_packed(Net_Engine_Inst *instance, u32 *input, u32 *output, const u32 *words, u32 row_length);
+
+NET_STATUS NET_ENGINE_wait(Net_Engine_Inst *instance);
+
+/**
+ * Calls cb repeatedly while a pass is in flight instead of just spinning,
+ * NULL turns it off. The engine is only restarted once cb returns.
+ */
+void NET_ENGINE_set_idle(Net_Engine_Inst *instance, Net_Engine_Idle_cb *cb, void *context);
+
+/**
+ * Forgets which buffers have been written back. Inside an epoch every input
+ * and output range is flushed once, so call this whenever the CPU may have
+ * written a buffer the engine reads, e.g. at the start of each layer.
+ */
+void NET_ENGINE_cache_reset(Net_Engine_Inst *instance);
+
 NET_STATUS NET_ENGINE_process_maxpooling(Net_Engine_Inst *instance, Net_Engine_Img *input, Net_Engine_Img *output);
 
 NET_STATUS NET_ENGINE_config_row_length(Net_Engine_Inst *instance, u32 row_length );
 
+void NET_ENGINE_transfer_init(Net_Engine_Transfer *transfer, u32 height, u32 width);
+
+NET_STATUS NET_ENGINE_set_transfer(Net_Engine_Inst *instance, const Net_Engine_Transfer *transfer);
+
 #endif // NET_ENGINE_H
@@ -53,6 +53,8 @@
 #define NET_ENGINE_KERNAL_REG_8 NET_ENGINE_S00_AXI_SLV_REG18_OFFSET 
 #define NET_ENGINE_KERNAL_REG_9 NET_ENGINE_S00_AXI_SLV_REG19_OFFSET 
 
+#define NET_ENGINE_CNN_CONFIG_WORDS 10      // NET_ENGINE_BIAS_REG through NET_ENGINE_KERNAL_REG_9
+
 
 /**************************** Type Definitions *****************************/
 
@@ -83,6 +83,31 @@ typedef enum{
     NET_ENGINE_RECEIVE_INTR
 } Net_Engine_Intr;
 
+// DMA and cache maintenance lengths (bytes) of one kernel pass
+typedef struct Net_Engine_Transfer_{
+    u32 height;                 // output rows
+    u32 row_length;             // output row length, input rows are row_length + 2
+    u32 initial_send_length;
+    u32 row_send_length;
+    u32 receive_length;
+    u32 flush_input_length;
+    u32 flush_output_length;
+} Net_Engine_Transfer;
+
+#define NET_ENGINE_CLEAN_RANGES 24      // input planes of the widest layer plus the temp slots
+
+// buffers written back since the last NET_ENGINE_cache_reset
+typedef struct Net_Engine_Cache_{
+    struct{
+        UINTPTR base;
+        u32     length;
+    } ranges[NET_ENGINE_CLEAN_RANGES];
+    u32 count;
+} Net_Engine_Cache;
+
+// CPU work run while NET_ENGINE_wait spins, keep each call short
+typedef void (Net_Engine_Idle_cb)(void *context);
+
 typedef struct Net_Engine_Inst_{
     Net_Engine_ID id;
     Net_Engine *net_engine_regs;
@@ -90,6 +115,12 @@ typedef struct Net_Engine_Inst_{
 	XAxiDma          dma_inst;
     XScuGic          intc_inst;
     Net_Engine_Data  cur_data;
+    Net_Engine_Transfer transfer;
+    Net_Engine_Cache    cache;
+    struct{
+        Net_Engine_Idle_cb *cb;
+        void               *context;
+    } idle;
 } Net_Engine_Inst;
 
 typedef enum{
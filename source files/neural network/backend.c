@@ -0,0 +1,187 @@
+#include "backend.h"
+#include "kernels.h"
+#include <stdio.h>
+#include <xil_printf.h>
+
+static void BACKEND_direct_band(const Prepacked_Conv *packed, const float *const *inputs, u32 in_width,
+                                float *const *outputs, u32 out_rows, u32 out_width){
+    KERNEL_conv3x3_direct(inputs, packed->in_channels, in_width, outputs, packed->out_channels,
+                          out_rows, out_width, packed->panels, packed->bias, packed->alpha);
+}
+
+static void BACKEND_sparse_band(const Prepacked_Conv *packed, const float *const *inputs, u32 in_width,
+                                float *const *outputs, u32 out_rows, u32 out_width){
+    KERNEL_conv3x3_sparse(inputs, in_width, outputs, packed->out_channels, out_rows, out_width, packed->sparse_start,
+                          packed->sparse_tap, packed->sparse_weight, packed->bias, packed->alpha);
+}
+
+static void BACKEND_engine_band(const Prepacked_Conv *packed, const float *const *inputs, u32 in_width,
+                                float *const *outputs, u32 out_rows, u32 out_width){
+    KERNEL_conv3x3_engine(inputs, packed->in_channels, in_width, outputs, packed->out_channels, out_rows, out_width,
+                          packed->engine, packed->engine_inputs, packed->alpha);
+}
+
+static void BACKEND_winograd_plane(const Prepacked_Conv *packed, const float *const *inputs, u32 in_height, u32 in_width,
+                                   float *const *outputs, u32 out_height, u32 out_width){
+    KERNEL_conv3x3_winograd(inputs, packed->in_channels, in_height, in_width, outputs, packed->out_channels,
+                            out_height, out_width, packed->winograd, packed->bias, packed->alpha, packed->scratch);
+}
+
+static u32 BACKEND_out_width(const Layer *layer){
+    if(layer->plan != NULL){
+        return layer->plan->out_width;
+    }
+    return (layer->output_channels.channels != NULL) ? layer->output_channels.channels->data.width : 0;
+}
+
+static int BACKEND_valid_any(const Layer *layer){
+    return layer->type == LAYER_TYPE_CNN_3X3;
+}
+
+static int BACKEND_valid_packed(const Layer *layer){
+    return layer->type == LAYER_TYPE_CNN_3X3 && layer->packed != NULL &&
+           layer->packed->in_channels <= LAYER_MAX_CONV_CHANNELS && layer->packed->out_channels <= LAYER_MAX_CONV_CHANNELS;
+}
+
+static int BACKEND_valid_winograd(const Layer *layer){
+    return BACKEND_valid_packed(layer) && BACKEND_out_width(layer) <= PREPACK_MAX_WIDTH;
+}
+
+static int BACKEND_valid_split(const Layer *layer){
+#ifdef USE_NET_ENGINE
+    // only a layer SPLIT_calibrate has run split
+    return BACKEND_valid_packed(layer) && layer->plan != NULL && layer->split.count != 0;
+#else
+    (void)layer;
+    return 0;
+#endif
+}
+
+static const Conv_Backend_Entry BACKEND_registry[CONV_BACKEND_COUNT] = {
+#ifdef USE_NET_ENGINE
+    [CONV_BACKEND_NET_ENGINE]   = {CONV_BACKEND_NET_ENGINE,   "net engine",   BACKEND_valid_any,      NULL,                   NULL},
+#else
+    [CONV_BACKEND_NET_ENGINE]   = {CONV_BACKEND_NET_ENGINE,   "scalar",       BACKEND_valid_any,      NULL,                   NULL},
+#endif
+    [CONV_BACKEND_CPU_DIRECT]   = {CONV_BACKEND_CPU_DIRECT,   "direct",       BACKEND_valid_packed,   BACKEND_direct_band,    NULL},
+    [CONV_BACKEND_CPU_WINOGRAD] = {CONV_BACKEND_CPU_WINOGRAD, "winograd",     BACKEND_valid_winograd, BACKEND_direct_band,    BACKEND_winograd_plane},
+    [CONV_BACKEND_CPU_SPARSE]   = {CONV_BACKEND_CPU_SPARSE,   "sparse",       BACKEND_valid_packed,   BACKEND_sparse_band,    NULL},
+    [CONV_BACKEND_CPU_ENGINE]   = {CONV_BACKEND_CPU_ENGINE,   "engine order", BACKEND_valid_packed,   BACKEND_engine_band,    NULL},
+    // without the engine a split layer runs both sides on the CPU
+    [CONV_BACKEND_SPLIT]        = {CONV_BACKEND_SPLIT,        "split",        BACKEND_valid_split,    BACKEND_engine_band,    NULL},
+};
+
+const Conv_Backend_Entry* BACKEND_get(CONV_BACKEND backend){
+    if((u32)backend >= CONV_BACKEND_COUNT){
+        return NULL;
+    }
+    return &BACKEND_registry[backend];
+}
+
+void BACKEND_report_init(Backend_Report *report){
+    report->count = 0;
+}
+
+int BACKEND_autotune(NeuralNetwork *network, u32 height, u32 width, u32 rounds, Backend_Report *report){
+    CONV_BACKEND saved[PLAN_MAX_LAYERS];
+    u64 ns[CONV_BACKEND_COUNT][PLAN_MAX_LAYERS] = {{0}};
+    u64 run[PLAN_MAX_LAYERS] = {0};
+    const Conv_Backend_Entry *entry;
+    Backend_Choice *choice;
+    Execution_Plan *plan;
+    NN_Layer_Node *cur_layer;
+    Layer *layer;
+    u32 index;
+    int ret = 0;
+
+    if(NEURAL_NETWORK_update(network, height, width) != 0){
+        return -1;
+    }
+    plan = network->active_plan;
+
+    index = 0;
+    for(cur_layer = network->layers; cur_layer != NULL && index < PLAN_MAX_LAYERS; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+        saved[index] = cur_layer->layer.conv_backend;
+    }
+
+    for(u32 backend = 0; backend < CONV_BACKEND_COUNT && ret == 0; backend++){
+        entry = &BACKEND_registry[backend];
+
+        // layers that can not run it keep their own, their times are not counted
+        index = 0;
+        for(cur_layer = network->layers; cur_layer != NULL && index < PLAN_MAX_LAYERS; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+            layer = &cur_layer->layer;
+            layer->conv_backend = entry->valid(layer) ? entry->backend : saved[index];
+        }
+
+        // best of rounds, timed without the per layer log line of NEURAL_NETWORK_process
+        for(u32 round = 0; round < rounds && ret == 0; round++){
+            ret = NEURAL_NETWORK_time_layers(network, run, PLAN_MAX_LAYERS);
+            for(index = 0; index < PLAN_MAX_LAYERS && ret == 0; index++){
+                if(ns[backend][index] == 0 || run[index] < ns[backend][index]){
+                    ns[backend][index] = run[index];
+                }
+            }
+        }
+
+        index = 0;
+        for(cur_layer = network->layers; cur_layer != NULL && index < PLAN_MAX_LAYERS; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+            if(!entry->valid(&cur_layer->layer)){
+                ns[backend][index] = 0;
+            }
+        }
+    }
+
+    index = 0;
+    for(cur_layer = network->layers; cur_layer != NULL && index < plan->layer_count; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+        layer = &cur_layer->layer;
+        layer->conv_backend = saved[index];
+        if(layer->type != LAYER_TYPE_CNN_3X3 || ret != 0){
+            continue;
+        }
+
+        for(u32 backend = 0; backend < CONV_BACKEND_COUNT; backend++){
+            if(ns[backend][index] != 0 && (ns[layer->conv_backend][index] == 0 || ns[backend][index] < ns[layer->conv_backend][index])){
+                layer->conv_backend = (CONV_BACKEND)backend;
+            }
+        }
+        plan->layers[index].conv_backend = layer->conv_backend;
+
+        if(report->count < BACKEND_MAX_CHOICES){
+            choice = &report->choices[report->count++];
+            choice->height  = height;
+            choice->width   = width;
+            choice->layer   = index;
+            choice->backend = layer->conv_backend;
+            for(u32 backend = 0; backend < CONV_BACKEND_COUNT; backend++){
+                choice->ns[backend] = ns[backend][index];
+            }
+        }
+    }
+
+    return ret;
+}
+
+void BACKEND_report(const Backend_Report *report){
+    const Backend_Choice *choice;
+
+    printf("Backend: size, layer, chosen");
+    for(u32 backend = 0; backend < CONV_BACKEND_COUNT; backend++){
+        printf(", %s us", BACKEND_registry[backend].name);
+    }
+    printf(" \n");
+
+    for(u32 index = 0; index < report->count; index++){
+        choice = &report->choices[index];
+        printf("\t%dx%d, %d, %s", choice->height, choice->width, choice->layer + 1, BACKEND_registry[choice->backend].name);
+        for(u32 backend = 0; backend < CONV_BACKEND_COUNT; backend++){
+            if(choice->ns[backend] != 0){
+                printf(", %d", (u32)(choice->ns[backend] / 1000));
+            }
+            else{
+                printf(", -");
+            }
+        }
+        printf(" \n");
+    }
+}
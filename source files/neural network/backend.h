@@ -0,0 +1,64 @@
+
+#ifndef NET_ENGINE_BACKEND_H
+#define NET_ENGINE_BACKEND_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+#include "prepack.h"
+
+/**************************** Type Definitions *****************************/
+#define BACKEND_MAX_CHOICES     (PLAN_CACHE_SIZE * PLAN_MAX_LAYERS)
+
+// CPU kernel over out_rows output rows, inputs and outputs point at the band's first row
+typedef void (Backend_Conv_Band)(const Prepacked_Conv *packed, const float *const *inputs, u32 in_width,
+                                 float *const *outputs, u32 out_rows, u32 out_width);
+
+// CPU kernel over whole planes
+typedef void (Backend_Conv_Plane)(const Prepacked_Conv *packed, const float *const *inputs, u32 in_height, u32 in_width,
+                                  float *const *outputs, u32 out_height, u32 out_width);
+
+// one 3x3 backend, the registry is indexed by CONV_BACKEND
+typedef struct Conv_Backend_Entry_{
+    CONV_BACKEND        backend;
+    const char         *name;
+    int               (*valid)(const Layer *layer);     // non zero when the layer can run it at its active plan
+    Backend_Conv_Band  *band;                           // NULL for the per kernel path
+    Backend_Conv_Plane *plane;                          // taken over band when set
+} Conv_Backend_Entry;
+
+// the autotuned backend of one 3x3 layer at one plan size
+typedef struct Backend_Choice_{
+    u32          height;
+    u32          width;
+    u32          layer;
+    CONV_BACKEND backend;
+    u64          ns[CONV_BACKEND_COUNT];    // best run of each backend, 0 when not valid
+} Backend_Choice;
+
+typedef struct Backend_Report_{
+    u32            count;
+    Backend_Choice choices[BACKEND_MAX_CHOICES];
+} Backend_Report;
+
+/************************** Function Prototypes ****************************/
+
+// NULL for CONV_BACKEND_COUNT and beyond
+const Conv_Backend_Entry* BACKEND_get(CONV_BACKEND backend);
+
+void BACKEND_report_init(Backend_Report *report);
+
+/**
+ * Times every valid backend on every 3x3 layer at (height, width), best of
+ * rounds runs on whatever the input planes hold, and writes the fastest
+ * into that plan's entry for the layer, so NEURAL_NETWORK_update switches
+ * backends along with the plan. CONV_BACKEND_SPLIT only takes part once
+ * SPLIT_calibrate has sized the layer's share. Adds a choice per layer to
+ * report.
+ */
+int BACKEND_autotune(NeuralNetwork *network, u32 height, u32 width, u32 rounds, Backend_Report *report);
+
+void BACKEND_report(const Backend_Report *report);
+
+#endif // NET_ENGINE_BACKEND_H
@@ -0,0 +1,434 @@
+#include "benchmark.h"
+#include "layer.h"
+#include "kernels.h"
+#include "prepack.h"
+#include "profiler.h"
+#include "utility.h"
+#include "nms.h"
+#include "xil_cache.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xil_printf.h>
+
+// input sizes of the three pyramid levels plus the full frame
+static const u32 BENCHMARK_sizes[] = {100, 62, 45, 30};
+
+// the three PNet 3x3 layers
+static const u32 BENCHMARK_conv_channels[][2] = {{3, 10}, {10, 16}, {16, 32}};
+
+static const float BENCHMARK_scales[] = {0.6f, 0.4254f, 0.3016f};
+
+static const u32 BENCHMARK_cache_lengths[] = {4096, 40000, 160000, 1048576};
+
+#define BENCHMARK_BOX_STEP  8
+#define BENCHMARK_BOX_BYTES (BENCHMARK_MAX_BOXES * BBOX_FIELDS * sizeof(float))
+#define BENCHMARK_MAX_BOXES 16
+
+typedef void (Benchmark_Fn)(void *context);
+
+typedef struct{
+    Layer           *layer;
+    Net_Engine_Inst *net_engine;
+} Benchmark_Layer_Context;
+
+typedef struct{
+    float *input;
+    float *output;
+    u32    height;
+    u32    width;
+    u32    channels;
+    float  scale;
+} Benchmark_Plane_Context;
+
+typedef struct{
+    Layer              *score;
+    Layer              *regression;
+    float               scale;
+    BoundingBox_Buffer  boxes;
+    Nms                 nms;
+    NMS_MODE            nms_mode;
+    float              *snapshot;       // extracted boxes NMS starts from, BENCHMARK_BOX_BYTES
+    u32                 snapshot_count;
+} Benchmark_Box_Context;
+
+typedef struct{
+    u8 *base;
+    u32 length;
+    u32 used;
+} Benchmark_Arena;
+
+static void* BENCHMARK_alloc(Benchmark_Arena *arena, u32 length){
+    void *ptr;
+
+    length = (length + 15) & ~15;
+    if(arena->used + length > arena->length){
+        return NULL;
+    }
+
+    ptr = arena->base + arena->used;
+    arena->used += length;
+    return ptr;
+}
+
+static void BENCHMARK_fill(float *data, u32 count, float low, float high){
+    for(u32 index = 0; index < count; index++){
+        data[index] = low + ((high - low) * (rand() / (float)RAND_MAX));
+    }
+}
+
+static void BENCHMARK_case(const Benchmark_Config *config, const char *name, u32 height, u32 width, u32 in, u32 out,
+                           Benchmark_Fn *fn, void *context){
+    u64 start;
+    u64 elapsed;
+    u64 total = 0;
+    u64 min   = (u64)-1;
+    u64 max   = 0;
+
+    for(u32 index = 0; index < config->warmup; index++){
+        fn(context);
+    }
+
+    for(u32 index = 0; index < config->repeats; index++){
+        start   = PROFILER_now();
+        fn(context);
+        elapsed = PROFILER_ticks_to_ns(PROFILER_now() - start);
+
+        total += elapsed;
+        min    = (elapsed < min) ? elapsed : min;
+        max    = (elapsed > max) ? elapsed : max;
+    }
+
+    if(config->repeats == 0){
+        return;
+    }
+
+    if(config->format == BENCHMARK_FORMAT_JSON){
+        printf("{\"bench\":\"%s\",\"h\":%lu,\"w\":%lu,\"in\":%lu,\"out\":%lu,\"repeats\":%lu,\"min_ns\":%llu,\"mean_ns\":%llu,\"max_ns\":%llu}\n",
+               name, (unsigned long)height, (unsigned long)width, (unsigned long)in, (unsigned long)out, (unsigned long)config->repeats,
+               (unsigned long long)min, (unsigned long long)(total / config->repeats), (unsigned long long)max);
+    }
+    else{
+        printf("bench,%s,%lu,%lu,%lu,%lu,%lu,%llu,%llu,%llu\n",
+               name, (unsigned long)height, (unsigned long)width, (unsigned long)in, (unsigned long)out, (unsigned long)config->repeats,
+               (unsigned long long)min, (unsigned long long)(total / config->repeats), (unsigned long long)max);
+    }
+}
+
+// LAYER_run, the UART line LAYER_process logs would dominate the small layers
+static void BENCHMARK_layer_fn(void *context){
+    Benchmark_Layer_Context *instance = (Benchmark_Layer_Context*)context;
+    LAYER_run(instance->layer, instance->net_engine);
+}
+
+static void BENCHMARK_maxpool_fn(void *context){
+    Benchmark_Plane_Context *instance = (Benchmark_Plane_Context*)context;
+    u32 out_height = instance->height / 2;
+    u32 out_width  = instance->width / 2;
+
+    for(u32 plane = 0; plane < instance->channels; plane++){
+        KERNEL_maxpool(MAXPOOL_KERNEL_2X2_S2, instance->input + (plane * instance->height * instance->width), instance->height, instance->width,
+                       instance->output + (plane * out_height * out_width), out_height, out_width, 2, 2);
+    }
+}
+
+static void BENCHMARK_softmax_fn(void *context){
+    Benchmark_Plane_Context *instance = (Benchmark_Plane_Context*)context;
+    u32 count = instance->height * instance->width;
+
+    KERNEL_softmax_2(instance->output, instance->output + count, count, KERNEL_EXP_ACCURATE);
+}
+
+static void BENCHMARK_resize_fn(void *context){
+    Benchmark_Plane_Context *instance = (Benchmark_Plane_Context*)context;
+    image_resize(instance->input, instance->output, instance->height, instance->width, instance->scale);
+}
+
+static void BENCHMARK_flush_fn(void *context){
+    Benchmark_Plane_Context *instance = (Benchmark_Plane_Context*)context;
+    Xil_DCacheFlushRange((UINTPTR)instance->input, instance->width);
+}
+
+static void BENCHMARK_invalidate_fn(void *context){
+    Benchmark_Plane_Context *instance = (Benchmark_Plane_Context*)context;
+    Xil_DCacheInvalidateRange((UINTPTR)instance->input, instance->width);
+}
+
+static void BENCHMARK_boxes_fn(void *context){
+    Benchmark_Box_Context *instance = (Benchmark_Box_Context*)context;
+
+    BBOX_buffer_reset(&instance->boxes);
+    generate_bounding_boxes(instance->score, instance->regression, instance->scale, 0.5f, &instance->boxes);
+}
+
+static void BENCHMARK_nms_fn(void *context){
+    Benchmark_Box_Context *instance = (Benchmark_Box_Context*)context;
+
+    // NMS compacts the buffer in place, restore the extracted boxes
+    memcpy(instance->boxes.cell, instance->snapshot, BENCHMARK_BOX_BYTES);
+    instance->boxes.count = instance->snapshot_count;
+    NMS_run(&instance->nms, &instance->boxes, 0.5f, instance->nms_mode);
+}
+
+#ifdef USE_NET_ENGINE
+static void BENCHMARK_engine_fn(void *context){
+    Benchmark_Layer_Context *instance = (Benchmark_Layer_Context*)context;
+    Channel *channel = &instance->layer->output_channels.channels->data;
+    const u32 *words = PREPACK_engine_words(instance->layer->packed, 0);
+
+    NET_ENGINE_process_cnn_packed(instance->net_engine, ((Channel*)channel->cnn_data.kernal_node->data.reference)->input_ptr,
+                                  channel->temp_ptr, words, channel->width);
+    NET_ENGINE_reset(instance->net_engine);
+}
+#endif
+
+// a 3x3 layer over random planes, built once at BENCHMARK_MAX_SIZE and shrunk with LAYER_update
+static Layer* BENCHMARK_conv_layer(Benchmark_Arena *arena, float *const *inputs, u32 in, u32 out, float *temp){
+    Channel_Kernal_Data *kernals;
+    float  *alpha;
+    float   value;
+    Layer  *layer;
+    Channel_Node *channel;
+    u32     out_size = BENCHMARK_MAX_SIZE - 2;
+    u32    *memory   = (u32*)BENCHMARK_alloc(arena, out * out_size * out_size * sizeof(float));
+
+    layer   = LAYER_init(LAYER_TYPE_CNN_3X3, LAYER_ACTIVATION_RELU, memory, out * out_size * out_size);
+    kernals = (Channel_Kernal_Data*)calloc(in * out, sizeof(Channel_Kernal_Data));
+    alpha   = (float*)calloc(out, sizeof(float));
+    if(memory == NULL || layer == NULL || kernals == NULL || alpha == NULL){
+        LAYER_free(layer);
+        free(kernals);
+        free(alpha);
+        return NULL;
+    }
+
+    for(u32 index = 0; index < in; index++){
+        LAYER_add_input_channel(layer, BENCHMARK_MAX_SIZE, BENCHMARK_MAX_SIZE, (u32*)inputs[index]);
+    }
+
+    for(u32 index = 0; index < in * out; index++){
+        BENCHMARK_fill((float*)&kernals[index].Kernal, 9, -0.5f, 0.5f);
+        BENCHMARK_fill(&value, 1, -0.1f, 0.1f);
+        memcpy(&kernals[index].Bias, &value, sizeof(value));
+    }
+    BENCHMARK_fill(alpha, out, 0.1f, 0.3f);
+
+    LAYER_add_cnn_output_channels(&layer, kernals, alpha, out, out_size, out_size);
+    free(kernals);
+    free(alpha);
+
+    // the per kernel path accumulates through a temp plane
+    for(channel = layer->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        channel->data.temp_ptr = (u32*)temp;
+    }
+
+    layer->packed = PREPACK_conv3x3(layer);
+    return layer;
+}
+
+static Layer* BENCHMARK_conv1x1_layer(Benchmark_Arena *arena, float *const *inputs, u32 in, u32 out, LAYER_ACTIVATION activation){
+    u32   *memory  = (u32*)BENCHMARK_alloc(arena, out * BENCHMARK_MAX_SIZE * BENCHMARK_MAX_SIZE * sizeof(float));
+    float *weights = (float*)BENCHMARK_alloc(arena, in * out * sizeof(float));
+    float *bias    = (float*)BENCHMARK_alloc(arena, out * sizeof(float));
+    Layer *layer;
+
+    if(memory == NULL || weights == NULL || bias == NULL){
+        return NULL;
+    }
+
+    layer = LAYER_init(LAYER_TYPE_CNN_1X1, activation, memory, out * BENCHMARK_MAX_SIZE * BENCHMARK_MAX_SIZE);
+    if(layer == NULL){
+        return NULL;
+    }
+
+    for(u32 index = 0; index < in; index++){
+        LAYER_add_input_channel(layer, BENCHMARK_MAX_SIZE, BENCHMARK_MAX_SIZE, (u32*)inputs[index]);
+    }
+
+    BENCHMARK_fill(weights, in * out, -0.5f, 0.5f);
+    BENCHMARK_fill(bias, out, -0.1f, 0.1f);
+    LAYER_add_cnn_1x1_output_channels(&layer, weights, bias, in * out, out, BENCHMARK_MAX_SIZE, BENCHMARK_MAX_SIZE);
+
+    return layer;
+}
+
+// scores below the threshold except 2x2 cell clusters every BENCHMARK_BOX_STEP
+// cells: neighbouring cells overlap above the NMS threshold (IoU 0.53 for the
+// diagonal), so NMS keeps one box of each cluster. Returns the boxes placed.
+static u32 BENCHMARK_place_boxes(Layer *score, u32 size){
+    float *face  = (float*)((Channel_Node*)score->output_channels.channels->next)->data.output_ptr;
+    u32    count = 0;
+
+    memset(face, 0, size * size * sizeof(float));
+    for(u32 y = 0; y + 1 < size && count < BENCHMARK_MAX_BOXES; y += BENCHMARK_BOX_STEP){
+        for(u32 x = 0; x + 1 < size && count < BENCHMARK_MAX_BOXES; x += BENCHMARK_BOX_STEP){
+            for(u32 cell = 0; cell < 4 && count < BENCHMARK_MAX_BOXES; cell++){
+                face[((y + (cell / 2)) * size) + x + (cell % 2)] = 0.9f - (0.05f * cell);
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+int BENCHMARK_run(const Benchmark_Config *config, Net_Engine_Inst *net_engine, u32 *memory, u32 memory_len){
+    Benchmark_Arena arena = {(u8*)memory, memory_len, 0};
+    Benchmark_Layer_Context layer_context;
+    Benchmark_Plane_Context plane_context;
+    Benchmark_Box_Context   box_context;
+    float *inputs[BENCHMARK_MAX_CHANNELS];
+    float *planes;
+    float *temp;
+    Layer *layer;
+    Layer *score;
+    Layer *regression;
+    u32    plane_len = BENCHMARK_MAX_SIZE * BENCHMARK_MAX_SIZE;
+    u32    size;
+    u32    boxes;
+
+    planes = (float*)BENCHMARK_alloc(&arena, BENCHMARK_MAX_CHANNELS * plane_len * sizeof(float));
+    temp   = (float*)BENCHMARK_alloc(&arena, CHANNEL_TEMP_SLOT_STRIDE(plane_len) * CHANNEL_TEMP_SLOTS * sizeof(float));
+    if(config == NULL || planes == NULL || temp == NULL){
+        xil_printf("Benchmark: not enough memory \r\n");
+        return -1;
+    }
+
+    srand(1);
+    BENCHMARK_fill(planes, BENCHMARK_MAX_CHANNELS * plane_len, -1.0f, 1.0f);
+    for(u32 index = 0; index < BENCHMARK_MAX_CHANNELS; index++){
+        inputs[index] = planes + (index * plane_len);
+    }
+
+    if(config->format == BENCHMARK_FORMAT_CSV){
+        printf("bench,name,h,w,in,out,repeats,min_ns,mean_ns,max_ns\n");
+    }
+
+    layer_context.net_engine = net_engine;
+
+    for(u32 pair = 0; pair < sizeof(BENCHMARK_conv_channels) / sizeof(BENCHMARK_conv_channels[0]); pair++){
+        u32 in  = BENCHMARK_conv_channels[pair][0];
+        u32 out = BENCHMARK_conv_channels[pair][1];
+        u32 mark = arena.used;
+
+        layer = BENCHMARK_conv_layer(&arena, inputs, in, out, temp);
+        if(layer == NULL || layer->packed == NULL){
+            xil_printf("Benchmark: conv layer build failed \r\n");
+            LAYER_free(layer);
+            return -1;
+        }
+        layer_context.layer = layer;
+
+        for(u32 index = 0; index < sizeof(BENCHMARK_sizes) / sizeof(BENCHMARK_sizes[0]); index++){
+            size = BENCHMARK_sizes[index];
+            LAYER_update(layer, layer, size, size);
+
+            layer->conv_backend = CONV_BACKEND_NET_ENGINE;
+#ifdef USE_NET_ENGINE
+            BENCHMARK_case(config, "conv3x3_engine", size, size, in, out, BENCHMARK_layer_fn, &layer_context);
+            BENCHMARK_case(config, "engine_kernel", size, size, 1, 1, BENCHMARK_engine_fn, &layer_context);
+#else
+            BENCHMARK_case(config, "conv3x3_scalar", size, size, in, out, BENCHMARK_layer_fn, &layer_context);
+#endif
+            layer->conv_backend = CONV_BACKEND_CPU_DIRECT;
+            BENCHMARK_case(config, "conv3x3_direct", size, size, in, out, BENCHMARK_layer_fn, &layer_context);
+            layer->conv_backend = CONV_BACKEND_CPU_WINOGRAD;
+            BENCHMARK_case(config, "conv3x3_winograd", size, size, in, out, BENCHMARK_layer_fn, &layer_context);
+            layer->conv_backend = CONV_BACKEND_CPU_SPARSE;
+            BENCHMARK_case(config, "conv3x3_sparse", size, size, in, out, BENCHMARK_layer_fn, &layer_context);
+            layer->conv_backend = CONV_BACKEND_CPU_ENGINE;
+            BENCHMARK_case(config, "conv3x3_engine_order", size, size, in, out, BENCHMARK_layer_fn, &layer_context);
+        }
+
+        LAYER_free(layer);
+        arena.used = mark;
+    }
+
+    // conv1 outputs of each level, 10 planes
+    plane_context.input    = planes;
+    plane_context.output   = planes + (10 * plane_len);
+    plane_context.channels = 10;
+    for(u32 index = 0; index < sizeof(BENCHMARK_sizes) / sizeof(BENCHMARK_sizes[0]); index++){
+        plane_context.height = BENCHMARK_sizes[index] - 2;
+        plane_context.width  = BENCHMARK_sizes[index] - 2;
+        BENCHMARK_case(config, "maxpool_2x2_s2", plane_context.height, plane_context.width, 10, 10, BENCHMARK_maxpool_fn, &plane_context);
+    }
+
+    score      = BENCHMARK_conv1x1_layer(&arena, inputs, 32, 2, LAYER_ACTIVATION_SOFTMAX);
+    regression = BENCHMARK_conv1x1_layer(&arena, inputs, 32, 4, LAYER_ACTIVATION_NOT_REQUIRED);
+    if(score == NULL || regression == NULL){
+        xil_printf("Benchmark: 1x1 layer build failed \r\n");
+        LAYER_free(score);
+        LAYER_free(regression);
+        return -1;
+    }
+
+    box_context.score      = score;
+    box_context.regression = regression;
+    box_context.scale      = BENCHMARK_scales[0];
+    box_context.snapshot   = (float*)BENCHMARK_alloc(&arena, BENCHMARK_BOX_BYTES);
+    if(box_context.snapshot == NULL ||
+       BBOX_buffer_init(&box_context.boxes, BENCHMARK_alloc(&arena, BENCHMARK_BOX_BYTES), BENCHMARK_BOX_BYTES) != 0 ||
+       NMS_init(&box_context.nms, BENCHMARK_alloc(&arena, BENCHMARK_MAX_BOXES * NMS_BYTES_PER_BOX),
+                BENCHMARK_MAX_BOXES * NMS_BYTES_PER_BOX) != 0){
+        xil_printf("Benchmark: not enough memory \r\n");
+        LAYER_free(score);
+        LAYER_free(regression);
+        return -1;
+    }
+
+    for(u32 index = 0; index < sizeof(BENCHMARK_sizes) / sizeof(BENCHMARK_sizes[0]); index++){
+        // head resolution of each level: conv, pool 2/2, conv, conv
+        size = ((BENCHMARK_sizes[index] - 2) / 2) - 4;
+        LAYER_update(score, score, size, size);
+        LAYER_update(regression, regression, size, size);
+
+        layer_context.layer = score;
+        BENCHMARK_case(config, "conv1x1_softmax", size, size, 32, 2, BENCHMARK_layer_fn, &layer_context);
+        layer_context.layer = regression;
+        BENCHMARK_case(config, "conv1x1", size, size, 32, 4, BENCHMARK_layer_fn, &layer_context);
+
+        plane_context.output = (float*)score->output_channels.channels->data.output_ptr;
+        plane_context.height = size;
+        plane_context.width  = size;
+        BENCHMARK_case(config, "softmax_2", size, size, 2, 2, BENCHMARK_softmax_fn, &plane_context);
+
+        boxes = BENCHMARK_place_boxes(score, size);
+        BENCHMARK_case(config, "generate_bounding_boxes", size, size, 6, boxes, BENCHMARK_boxes_fn, &box_context);
+
+        // extraction stays out of the NMS samples
+        BENCHMARK_boxes_fn(&box_context);
+        memcpy(box_context.snapshot, box_context.boxes.cell, BENCHMARK_BOX_BYTES);
+        box_context.snapshot_count = box_context.boxes.count;
+        box_context.nms_mode = NMS_MODE_SORTED;
+        BENCHMARK_case(config, "non_max_suppression", size, size, boxes, boxes, BENCHMARK_nms_fn, &box_context);
+        box_context.nms_mode = NMS_MODE_GRID;
+        BENCHMARK_case(config, "non_max_suppression_grid", size, size, boxes, boxes, BENCHMARK_nms_fn, &box_context);
+    }
+    LAYER_free(score);
+    LAYER_free(regression);
+
+    plane_context.input  = planes;
+    plane_context.output = planes + plane_len;
+    for(u32 index = 0; index < sizeof(BENCHMARK_scales) / sizeof(BENCHMARK_scales[0]); index++){
+        plane_context.height = BENCHMARK_MAX_SIZE;
+        plane_context.width  = BENCHMARK_MAX_SIZE;
+        plane_context.scale  = BENCHMARK_scales[index];
+        BENCHMARK_case(config, "image_resize", BENCHMARK_MAX_SIZE, BENCHMARK_MAX_SIZE, 1, (u32)roundf(BENCHMARK_MAX_SIZE * plane_context.scale),
+                       BENCHMARK_resize_fn, &plane_context);
+    }
+
+    // length in bytes rides in the width column
+    plane_context.input = planes;
+    for(u32 index = 0; index < sizeof(BENCHMARK_cache_lengths) / sizeof(BENCHMARK_cache_lengths[0]); index++){
+        plane_context.width = BENCHMARK_cache_lengths[index];
+        if(plane_context.width > BENCHMARK_MAX_CHANNELS * plane_len * sizeof(float)){
+            continue;
+        }
+        BENCHMARK_case(config, "dcache_flush", 1, plane_context.width, 0, 0, BENCHMARK_flush_fn, &plane_context);
+        BENCHMARK_case(config, "dcache_invalidate", 1, plane_context.width, 0, 0, BENCHMARK_invalidate_fn, &plane_context);
+    }
+
+    return 0;
+}
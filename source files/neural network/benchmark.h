@@ -0,0 +1,39 @@
+
+#ifndef NET_ENGINE_BENCHMARK_H
+#define NET_ENGINE_BENCHMARK_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "net_engine.h"
+
+/**************************** Type Definitions *****************************/
+#define BENCHMARK_MAX_CHANNELS  32
+#define BENCHMARK_MAX_SIZE      100
+// scratch needed by BENCHMARK_run: input and output planes plus small tables
+#define BENCHMARK_MEMORY_LEN    (((2 * BENCHMARK_MAX_CHANNELS) + 2) * BENCHMARK_MAX_SIZE * BENCHMARK_MAX_SIZE * sizeof(float) + 0x10000)
+
+typedef enum{
+    BENCHMARK_FORMAT_CSV,
+    BENCHMARK_FORMAT_JSON,      // one object per line
+} BENCHMARK_FORMAT;
+
+typedef struct Benchmark_Config_{
+    u32              warmup;        // untimed runs before every case
+    u32              repeats;       // timed runs, min / mean / max are reported
+    BENCHMARK_FORMAT format;
+} Benchmark_Config;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Times every building block of the PNet pass over the sizes the pyramid
+ * produces: 3x3 conv per backend, max pooling, 1x1 heads, softmax,
+ * image_resize, box extraction, NMS, cache maintenance and, with
+ * USE_NET_ENGINE, single Net Engine kernels. memory must hold
+ * BENCHMARK_MEMORY_LEN bytes; net_engine may be NULL without USE_NET_ENGINE.
+ * Rows are printed prefixed with "bench" so they can be grepped from the log.
+ */
+int BENCHMARK_run(const Benchmark_Config *config, Net_Engine_Inst *net_engine, u32 *memory, u32 memory_len);
+
+#endif // NET_ENGINE_BENCHMARK_H
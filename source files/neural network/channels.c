@@ -1,4 +1,8 @@
 #include "channels.h"
+#include "prepack.h"
+#include "trace.h"
+#include "tiling.h"
+#include <string.h>
 #include <math.h>
 #include <stdio.h>
 #include "time_measure.h"
@@ -18,7 +22,6 @@ DEFAULT SET TO 0x01000000
 #define RX_BUFFER_BASE		(MEM_BASE_ADDR + 0x00300000)
 #define RX_BUFFER_HIGH		(MEM_BASE_ADDR + 0x004FFFFF)
 
-// #define USE_NET_ENGINE
 #define PROCESS_TIME_MEASURE
 // add channel size
 Channel* CHANNEL_init(CHANNEL_TYPE type, u32 height, u32 width, u32 *input_ptr){
@@ -37,6 +40,7 @@ Channel* CHANNEL_init(CHANNEL_TYPE type, u32 height, u32 width, u32 *input_ptr){
     instance->kernal_data_count = 0;
 
     instance->cnn_data.kernal_node       = NULL;
+    instance->cnn_1x1_data.data          = NULL;
 
 
     if(type == CHANNEL_TYPE_INPUT){
@@ -101,9 +105,10 @@ int CHANNEL_load_kernal(Channel *instance, Channel_Kernal_Data data, Channel *re
     }
 }
 
-static void CHANNEL_post_process(Channel *instance){
-    float *temp_ptr = (float*)instance->temp_ptr;
-    float *out_ptr  = (float*)instance->output_ptr;
+#ifdef USE_NET_ENGINE
+static void CHANNEL_post_process(Channel *instance, const u32 *temp, u32 *output){
+    const float *temp_ptr = (const float*)temp;
+    float       *out_ptr  = (float*)output;
 
     for (int Index = 0; Index < instance->total_bytes; Index++) {
         out_ptr[Index] = out_ptr[Index] + temp_ptr[Index];
@@ -111,6 +116,7 @@ static void CHANNEL_post_process(Channel *instance){
         //     printf("temp %f, out %f \\r\n", temp_ptr[Index], out_ptr[Index]);
     }
 }
+#endif
 
 static float CHANNEL_RELU_activation(float value, float alpha){
     return value > 0? value : value * alpha;
@@ -121,8 +127,8 @@ static float CHANNEL_RELU_activation(float value, float alpha){
 //     return exp((double) value - max_value) / exp_sum;
 // }
 
-static void CHANNEL_activation(Channel *instance){
-    float *out_ptr  = (float*)instance->output_ptr;
+static void CHANNEL_activation(Channel *instance, u32 *output){
+    float *out_ptr  = (float*)output;
     float max_value = -1e10;
     float exp_sum   = 0.0f;
 
@@ -155,6 +161,7 @@ static void CHANNEL_activation(Channel *instance){
 
 }
 
+#ifndef USE_NET_ENGINE
 static void CHANNEL_kernal_to_net_config(Channel_Kernal_Data kernal_data, CNN_Config_Data* net_config_data){
     net_config_data->Kernal.Kernal_1 = kernal_data.Kernal.Kernal_1;
     net_config_data->Kernal.Kernal_2 = kernal_data.Kernal.Kernal_2;
@@ -171,59 +178,158 @@ static void CHANNEL_kernal_to_net_config(Channel_Kernal_Data kernal_data, CNN_Co
 }
 
 
-int CHANNEL_CNN_process(Channel *instance, Net_Engine_Inst* net_engine){
-    // xil_printf("Channel %d Processing \r\n", instance->index);
+// packed words are the prepacked register image, laid out like CHANNEL_kernal_to_net_config's output
+static void CHANNEL_packed_to_net_config(const u32 *words, CNN_Config_Data* net_config_data){
+    net_config_data->Bias = words[0];
+    memcpy(&net_config_data->Kernal, &words[1], sizeof(net_config_data->Kernal));
+    net_config_data->state = CONFIG_DATA_STATE_NOT_STARTED;
+}
+#endif
 
-    Channel_Kernal_Data_Node* cur_kernal = instance->cnn_data.kernal_node;
-    Channel *channel = NULL;
-    CNN_Config_Data net_config_data;
+static u32 CHANNEL_batch_count(const Channel_Batch *batch){
+    return (batch == NULL || batch->count == 0) ? 1 : batch->count;
+}
 
-    // check whether the channel loaded
-    if(cur_kernal == NULL){
-        xil_printf("No output channel available \r\n");
+#ifdef USE_NET_ENGINE
+// register words of one kernel, prepacked or converted from the kernel node
+static const u32* CHANNEL_engine_words(const Channel_Kernal_Data *kernal, const u32 *packed, u32 *words){
+    if(packed != NULL){
+        return &packed[kernal->index * PREPACK_ENGINE_WORDS];
+    }
+
+    words[0] = kernal->Bias;
+    memcpy(&words[1], &kernal->Kernal, sizeof(kernal->Kernal));
+    return words;
+}
+#endif
+
+#if defined(USE_NET_ENGINE) && defined(NET_ENGINE_PIPELINE)
+// one engine pass: a kernel over one frame of the batch
+typedef struct{
+    Channel_Kernal_Data_Node *kernal;
+    u32                       frame;
+} Channel_Pass;
+
+// next kernel with an input plane, the others add nothing to the output
+static Channel_Kernal_Data_Node* CHANNEL_next_engine_kernal(Channel_Kernal_Data_Node *kernal){
+    while(kernal != NULL && ((Channel*)kernal->data.reference)->input_ptr == NULL){
+        kernal = (Channel_Kernal_Data_Node*)kernal->next;
+    }
+    return kernal;
+}
+
+// frames of a batch run back to back under one kernel before moving on
+static Channel_Pass CHANNEL_next_pass(Channel_Pass pass, u32 frames){
+    if(pass.frame + 1 < frames){
+        pass.frame++;
+    }
+    else{
+        pass.kernal = CHANNEL_next_engine_kernal((Channel_Kernal_Data_Node*)pass.kernal->next);
+        pass.frame  = 0;
+    }
+    return pass;
+}
+
+static NET_STATUS CHANNEL_start_engine_pass(Channel *instance, Net_Engine_Inst *net_engine, Channel_Pass pass,
+                                            const Channel_Batch *batch, const u32 *packed, u32 *output){
+    Channel *channel = (Channel*)pass.kernal->data.reference;
+    u32 words[PREPACK_ENGINE_WORDS];
+    u32 offset = (pass.frame == 0) ? 0 : pass.frame * batch->in_stride;
+
+    // the kernel is still in the registers for every frame after the first
+    return NET_ENGINE_start_cnn_packed(net_engine, (u32*)channel->input_ptr + offset, output,
+                                       (pass.frame == 0) ? CHANNEL_engine_words(&pass.kernal->data, packed, words) : NULL,
+                                       instance->width);
+}
+
+// pass N+1 streams into one temp slot while the CPU accumulates pass N from the other
+static int CHANNEL_CNN_pipeline(Channel *instance, Net_Engine_Inst *net_engine, const u32 *packed, const Channel_Batch *batch){
+    Channel_Pass cur_pass  = {CHANNEL_next_engine_kernal(instance->cnn_data.kernal_node), 0};
+    Channel_Pass next_pass;
+    NET_STATUS   status;
+    u32  frames = CHANNEL_batch_count(batch);
+    u32 *slots[CHANNEL_TEMP_SLOTS];
+    u32  slot = 0;
+
+    slots[0] = instance->temp_ptr;
+    slots[1] = instance->temp_ptr + CHANNEL_TEMP_SLOT_STRIDE(instance->total_bytes);
+
+    if(cur_pass.kernal == NULL){
         return 0;
     }
 
-    for(int index = 0; index < instance->total_bytes; index++){
-        instance->output_ptr[index] = 0.0;
+    if(CHANNEL_start_engine_pass(instance, net_engine, cur_pass, batch, packed, slots[slot]) != NET_ENGINE_OK){
+        return -1;
     }
 
-#ifdef USE_NET_ENGINE
-    NET_ENGINE_config_row_length(net_engine, (instance->height + 2));
+    while(cur_pass.kernal != NULL){
+        next_pass = CHANNEL_next_pass(cur_pass, frames);
+
+#ifdef PROCESS_TIME_MEASURE
+    measure_start(TIME_MEASURE_SIGNAL_3);
+#endif
+        TRACE_BEGIN("kernel", cur_pass.kernal->data.index);
+        status = NET_ENGINE_wait(net_engine);
+        NET_ENGINE_reset(net_engine);
+        TRACE_END("kernel");
+#ifdef PROCESS_TIME_MEASURE
+    measure_end(TIME_MEASURE_SIGNAL_3);
+#endif
+
+        // the temp slot holds no valid pass, so stop before accumulating it
+        if(status != NET_ENGINE_OK){
+            return -1;
+        }
+
+        if(next_pass.kernal != NULL &&
+           CHANNEL_start_engine_pass(instance, net_engine, next_pass, batch, packed, slots[slot ^ 1]) != NET_ENGINE_OK){
+            return -1;
+        }
+
+#ifdef PROCESS_TIME_MEASURE
+    measure_start(TIME_MEASURE_SIGNAL_4);
+#endif
+        TRACE_BEGIN("post_process", cur_pass.kernal->data.index);
+        CHANNEL_post_process(instance, slots[slot], instance->output_ptr + (cur_pass.frame * (frames > 1 ? batch->out_stride : 0)));
+        TRACE_END("post_process");
+#ifdef PROCESS_TIME_MEASURE
+    measure_end(TIME_MEASURE_SIGNAL_4);
 #endif
 
+        slot    ^= 1;
+        cur_pass = next_pass;
+    }
+
+    return 0;
+}
+#endif
+
+#if defined(USE_NET_ENGINE) && !defined(NET_ENGINE_PIPELINE)
+// one kernel at a time, the CPU accumulates each engine pass before the next one starts
+static void CHANNEL_CNN_engine(Channel *instance, Net_Engine_Inst *net_engine, const u32 *packed, const Channel_Batch *batch){
+    Channel_Kernal_Data_Node* cur_kernal = instance->cnn_data.kernal_node;
+    Channel *channel;
+    u32  frames     = CHANNEL_batch_count(batch);
+    u32  in_stride  = (frames > 1) ? batch->in_stride  : 0;
+    u32  out_stride = (frames > 1) ? batch->out_stride : 0;
+    u32 *output;
+    u32  words[PREPACK_ENGINE_WORDS];
+
     while (cur_kernal != NULL){
         channel = (Channel*)cur_kernal->data.reference;
 
-        CHANNEL_kernal_to_net_config(cur_kernal->data, &net_config_data);
+        // the kernel is loaded once and every frame of the batch runs under it
+        for(u32 frame = 0; frame < frames && channel->input_ptr != NULL; frame++){
+            output = instance->output_ptr + (frame * out_stride);
 
         // xil_printf("\tKernal %d Processing %d, row length %d \r\n", cur_kernal->data.index, channel->index, (instance->height + 2));;
 #ifdef PROCESS_TIME_MEASURE
     measure_start(TIME_MEASURE_SIGNAL_3);
 #endif
-        if(channel->input_ptr != NULL){
-#ifdef USE_NET_ENGINE
-            NET_ENGINE_process_cnn(net_engine, (u32*)channel->input_ptr, (u32*)instance->temp_ptr, net_config_data, instance->height);
-#else
-            // Convolution operation
-            for (int i = 0; i < channel->height - 2; i++) {
-                for (int j = 0; j < channel->width - 2; j++) {
-                    float sum = 0.0f;
-
-                    for (int m = 0; m < 3; m++) {
-                        for (int n = 0; n < 3; n++) {
-                            int x = j + n;
-                            int y = i + m;
-                            if (x < channel->width && y < channel->height) {
-                                sum += channel->input_ptr[y * channel->width + x] * 1.0f;//kernel[m * 3 + n];
-                            }
-                        }
-                    }
-                    instance->temp_ptr[i * (channel->width - 2) + j] = sum;
-                }
-            }
-#endif
-        }
+            TRACE_BEGIN("kernel", cur_kernal->data.index);
+            NET_ENGINE_process_cnn_packed(net_engine, (u32*)channel->input_ptr + (frame * in_stride), (u32*)instance->temp_ptr,
+                                          (frame == 0) ? CHANNEL_engine_words(&cur_kernal->data, packed, words) : NULL, instance->width);
+            TRACE_END("kernel");
 #ifdef PROCESS_TIME_MEASURE
     measure_end(TIME_MEASURE_SIGNAL_3);
 #endif
@@ -232,24 +338,137 @@ int CHANNEL_CNN_process(Channel *instance, Net_Engine_Inst* net_engine){
     measure_start(TIME_MEASURE_SIGNAL_4);
 #endif
 
-        // calling post process function -> can add postprocess function here
-        CHANNEL_post_process(instance);
+            // calling post process function -> can add postprocess function here
+            TRACE_BEGIN("post_process", cur_kernal->data.index);
+            CHANNEL_post_process(instance, instance->temp_ptr, output);
+            TRACE_END("post_process");
 
 #ifdef PROCESS_TIME_MEASURE
     measure_end(TIME_MEASURE_SIGNAL_4);
 #endif
 
-#ifdef USE_NET_ENGINE
-        NET_ENGINE_reset(net_engine);
-#endif
+            NET_ENGINE_reset(net_engine);
+        }
 
         // jumping to next channel
-        cur_kernal = cur_kernal->next;
+        cur_kernal = (Channel_Kernal_Data_Node*)cur_kernal->next;
     }
+}
+#endif
+
+#ifndef USE_NET_ENGINE
+// same valid 3x3 window and bias as the Net Engine over output rows [first_row, last_row), added to output
+static void CHANNEL_cpu_kernal(const Channel *instance, const Channel *channel, const CNN_Config_Data *net_config_data,
+                               const float *input, float *output, u32 first_row, u32 last_row){
+    float kernel[9];
+    float weights[9];
+    u32   offsets[9];
+    u32   taps = 0;
+    float bias;
+
+    memcpy(kernel, &net_config_data->Kernal, sizeof(kernel));
+    memcpy(&bias, &net_config_data->Bias, sizeof(bias));
+
+    // zero taps are left out, a pruned kernel only adds its bias
+    for (int tap = 0; tap < 9; tap++) {
+        if (kernel[tap] != 0.0f) {
+            weights[taps] = kernel[tap];
+            offsets[taps] = ((tap / 3) * channel->width) + (tap % 3);
+            taps++;
+        }
+    }
+
+    for (int i = first_row; i < last_row; i++) {
+        for (int j = 0; j < instance->width; j++) {
+            const float *window = &input[i * channel->width + j];
+            float sum = bias;
+
+            for (u32 tap = 0; tap < taps; tap++) {
+                sum += window[offsets[tap]] * weights[tap];
+            }
+            output[i * instance->width + j] += sum;
+        }
+    }
+}
+
+// row bands of the output stay in L1 while every kernel adds its input channel to them
+static void CHANNEL_CNN_cpu(Channel *instance, const u32 *packed, u32 frames, u32 in_stride, u32 out_stride){
+    Channel_Kernal_Data_Node* cur_kernal;
+    Channel *channel;
+    CNN_Config_Data net_config_data;
+    u32 band;
+    u32 last_row;
+
+    band = TILING_conv_rows((instance->width + 2) * sizeof(float), instance->width * sizeof(float), instance->height, 1);
+
+    for(u32 frame = 0; frame < frames; frame++){
+        for(u32 first_row = 0; first_row < instance->height; first_row = last_row){
+            last_row = (band < instance->height - first_row) ? first_row + band : instance->height;
+
+            TRACE_BEGIN("band", first_row);
+            for(cur_kernal = instance->cnn_data.kernal_node; cur_kernal != NULL; cur_kernal = (Channel_Kernal_Data_Node*)cur_kernal->next){
+                channel = (Channel*)cur_kernal->data.reference;
+                if(channel->input_ptr == NULL){
+                    continue;
+                }
+
+                if(packed != NULL){
+                    CHANNEL_packed_to_net_config(&packed[cur_kernal->data.index * PREPACK_ENGINE_WORDS], &net_config_data);
+                }
+                else{
+                    CHANNEL_kernal_to_net_config(cur_kernal->data, &net_config_data);
+                }
+
+                CHANNEL_cpu_kernal(instance, channel, &net_config_data, (const float*)(channel->input_ptr + (frame * in_stride)),
+                                   (float*)(instance->output_ptr + (frame * out_stride)), first_row, last_row);
+            }
+            TRACE_END("band");
+        }
+    }
+}
+#endif
+
+int CHANNEL_CNN_process(Channel *instance, Net_Engine_Inst* net_engine, const u32 *packed, const Channel_Batch *batch){
+    // xil_printf("Channel %d Processing \r\n", instance->index);
+
+    Channel_Kernal_Data_Node* cur_kernal = instance->cnn_data.kernal_node;
+    u32  frames     = CHANNEL_batch_count(batch);
+    u32  out_stride = (frames > 1) ? batch->out_stride : 0;
+    u32 *output;
+
+    // check whether the channel loaded
+    if(cur_kernal == NULL){
+        xil_printf("No output channel available \r\n");
+        return 0;
+    }
+
+    for(u32 frame = 0; frame < frames; frame++){
+        output = instance->output_ptr + (frame * out_stride);
+        for(int index = 0; index < instance->total_bytes; index++){
+            output[index] = 0.0;
+        }
+    }
+
+#if !defined(USE_NET_ENGINE)
+    CHANNEL_CNN_cpu(instance, packed, frames, (frames > 1) ? batch->in_stride : 0, out_stride);
+#elif defined(NET_ENGINE_PIPELINE)
+    if(CHANNEL_CNN_pipeline(instance, net_engine, packed, batch) != 0){
+        xil_printf("Channel %d pipeline failed \r\n", instance->index);
+        return -1;
+    }
+#else
+    CHANNEL_CNN_engine(instance, net_engine, packed, batch);
+#endif
 
     if(instance->activation != LAYER_ACTIVATION_NOT_REQUIRED){
-        CHANNEL_activation(instance);
+        TRACE_BEGIN("activation", instance->index);
+        for(u32 frame = 0; frame < frames; frame++){
+            CHANNEL_activation(instance, instance->output_ptr + (frame * out_stride));
+        }
+        TRACE_END("activation");
     }
+
+    return 0;
 }
 
 int CHANNEL_update(Channel *instance, int height, int width){
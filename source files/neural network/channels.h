@@ -8,6 +8,22 @@
 
 /**************************** Type Definitions *****************************/
 
+// run the 3x3 convolutions on the Net Engine instead of the CPU
+// #define USE_NET_ENGINE
+
+// ping-pong the engine output between two temp slots so kernel N is
+// accumulated while kernel N+1 streams, temp_ptr then holds CHANNEL_TEMP_SLOTS planes
+#define NET_ENGINE_PIPELINE
+
+#if defined(USE_NET_ENGINE) && defined(NET_ENGINE_PIPELINE)
+#define CHANNEL_TEMP_SLOTS  2
+#else
+#define CHANNEL_TEMP_SLOTS  1
+#endif
+
+// slots start on a 32 byte cache line, the CPU reads one while the DMA writes the other
+#define CHANNEL_TEMP_SLOT_STRIDE(total_bytes)   (((total_bytes) + 7) & ~7)
+
 /************************** Function Prototypes ****************************/
 
 typedef enum{
@@ -88,6 +104,13 @@ typedef struct Channel_{
     } data;
 } Channel;
 
+// frames processed together, frame b sits b * stride u32 words after the channel pointers
+typedef struct Channel_Batch_{
+    u32 count;
+    u32 in_stride;
+    u32 out_stride;
+} Channel_Batch;
+
 typedef struct Channel_Node_{
     struct Channel_Node *next;
     Channel              data;
@@ -97,7 +120,13 @@ Channel* CHANNEL_init(CHANNEL_TYPE type, u32 height, u32 width, u32 *input_ptr);
 
 int CHANNEL_load_kernal(Channel *instance, Channel_Kernal_Data data, Channel *reference);
 
-int CHANNEL_CNN_process(Channel *instance, Net_Engine_Inst* net_engine);
+/**
+ * Runs every kernel of an output channel and accumulates the results. packed
+ * is the channel's prepacked register words (PREPACK_engine_words), or NULL
+ * to convert each kernel node on the fly. With a batch every frame runs
+ * under a kernel before the next one is loaded, NULL is a single frame.
+ */
+int CHANNEL_CNN_process(Channel *instance, Net_Engine_Inst* net_engine, const u32 *packed, const Channel_Batch *batch);
 
 int CHANNEL_RELU_process(Channel *instance);
 
@@ -0,0 +1,144 @@
+#include "detector.h"
+#include "kernels.h"
+#include <stdlib.h>
+
+int DETECTOR_init(Detector *instance, const Detector_Config *config, void *memory, u32 memory_len){
+    u8 *cursor = (u8*)memory;
+    u32 top_k  = config->top_k;
+
+    if(memory == NULL || top_k == 0 || memory_len < DETECTOR_MEMORY_SIZE(top_k)){
+        return -1;
+    }
+
+    instance->config = *config;
+    instance->heap   = (Nms_Key*)cursor;
+    cursor += top_k * sizeof(Nms_Key);
+
+    if(BBOX_buffer_init(&instance->boxes, cursor, 2 * top_k * BBOX_FIELDS * sizeof(float)) != 0){
+        return -1;
+    }
+    cursor += 2 * top_k * BBOX_FIELDS * sizeof(float);
+
+    if(NMS_init(&instance->nms, cursor, 2 * top_k * NMS_BYTES_PER_BOX) != 0){
+        return -1;
+    }
+
+    DETECTOR_reset(instance);
+    return 0;
+}
+
+void DETECTOR_reset(Detector *instance){
+    BBOX_buffer_reset(&instance->boxes);
+    instance->heap_count = 0;
+    instance->candidates = 0;
+    instance->evicted    = 0;
+}
+
+// heap order, on equal scores the later cell is the lower one so the earlier cell is kept
+static int DETECTOR_below(const Nms_Key *a, const Nms_Key *b){
+    return (a->score < b->score) || (a->score == b->score && a->index > b->index);
+}
+
+static void DETECTOR_sift_down(Nms_Key *heap, u32 count, u32 node){
+    Nms_Key key = heap[node];
+    u32 child;
+
+    while((child = (2 * node) + 1) < count){
+        if(child + 1 < count && DETECTOR_below(&heap[child + 1], &heap[child])){
+            child++;
+        }
+        if(!DETECTOR_below(&heap[child], &key)){
+            break;
+        }
+        heap[node] = heap[child];
+        node = child;
+    }
+    heap[node] = key;
+}
+
+static void DETECTOR_sift_up(Nms_Key *heap, u32 node){
+    Nms_Key key = heap[node];
+    u32 parent;
+
+    while(node > 0){
+        parent = (node - 1) / 2;
+        if(!DETECTOR_below(&key, &heap[parent])){
+            break;
+        }
+        heap[node] = heap[parent];
+        node = parent;
+    }
+    heap[node] = key;
+}
+
+static int DETECTOR_compare_cells(const void *a, const void *b){
+    u32 cell_a = *(const u32*)a;
+    u32 cell_b = *(const u32*)b;
+
+    return (cell_a < cell_b) ? -1 : (cell_a > cell_b);
+}
+
+// keeps the top_k best scores, a full heap only takes a score above its lowest
+static void DETECTOR_push(Detector *instance, float score, u32 cell){
+    Nms_Key *heap = instance->heap;
+
+    instance->candidates++;
+    if(instance->heap_count < instance->config.top_k){
+        heap[instance->heap_count].score = score;
+        heap[instance->heap_count].index = cell;
+        DETECTOR_sift_up(heap, instance->heap_count++);
+    }
+    else if(score > heap[0].score){
+        heap[0].score = score;
+        heap[0].index = cell;
+        DETECTOR_sift_down(heap, instance->heap_count, 0);
+        instance->evicted++;
+    }
+}
+
+u32 DETECTOR_add_level(Detector *instance, const float *const heads[6], u32 height, u32 width, float scale){
+    BoundingBox_Buffer *boxes = &instance->boxes;
+    BoundingBox_Buffer  level;
+    u32   first = boxes->count;
+    u32   cells = height * width;
+    u32   length;
+    u32   found;
+    float floor;
+
+    instance->heap_count = 0;
+    for(u32 base = 0; base < cells; base += DETECTOR_CHUNK){
+        length = (cells - base < DETECTOR_CHUNK) ? cells - base : DETECTOR_CHUNK;
+
+        // once the heap is full only scores above its lowest can get in
+        floor = instance->config.score_threshold;
+        if(instance->heap_count == instance->config.top_k && instance->heap[0].score > floor){
+            floor = instance->heap[0].score;
+        }
+
+        found = KERNEL_threshold_compact(&heads[1][base], length, floor, instance->cells, DETECTOR_CHUNK);
+        for(u32 i = 0; i < found; i++){
+            DETECTOR_push(instance, heads[1][base + instance->cells[i]], base + instance->cells[i]);
+        }
+    }
+
+    // only the kept cells are decoded, in scan order so score ties resolve as in BBOX_extract
+    for(u32 i = 0; i < instance->heap_count; i++){
+        boxes->cell[first + i] = instance->heap[i].index;
+    }
+    qsort(&boxes->cell[first], instance->heap_count, sizeof(u32), DETECTOR_compare_cells);
+    BBOX_gather(boxes, heads, &boxes->cell[first], instance->heap_count, width, scale);
+
+    BBOX_buffer_slice(boxes, first, &level);
+    NMS_run(&instance->nms, &level, instance->config.level_iou, instance->config.nms_mode);
+    boxes->count = first + level.count;
+
+    // the new level against the frame's survivors, the best top_k of the result stay
+    if(first != 0){
+        NMS_run(&instance->nms, boxes, instance->config.frame_iou, instance->config.nms_mode);
+    }
+    if(boxes->count > instance->config.top_k){
+        boxes->count = instance->config.top_k;
+    }
+
+    return boxes->count;
+}
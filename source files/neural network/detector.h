@@ -0,0 +1,58 @@
+
+#ifndef NET_ENGINE_DETECTOR_H
+#define NET_ENGINE_DETECTOR_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "utility.h"
+#include "nms.h"
+
+/**************************** Type Definitions *****************************/
+#define DETECTOR_CHUNK      256     // score cells scanned per compaction
+
+// the heap, plus a box buffer and NMS scratch for the frame's survivors and one level
+#define DETECTOR_MEMORY_SIZE(top_k) \
+    ((top_k) * (sizeof(Nms_Key) + (2 * BBOX_FIELDS * sizeof(float)) + (2 * NMS_BYTES_PER_BOX)))
+
+typedef struct Detector_Config_{
+    u32      top_k;             // candidates kept per level and survivors kept per frame
+    float    score_threshold;
+    float    level_iou;         // NMS within a level
+    float    frame_iou;         // NMS of a level's survivors against the frame's
+    NMS_MODE nms_mode;
+} Detector_Config;
+
+/**
+ * Streams the pyramid levels of one frame into at most top_k boxes. Each
+ * level's scan keeps its top_k scores in a bounded heap (lowest score at the
+ * root, evicted first), only those are decoded, suppressed within the level
+ * and then against the frame's survivors so far. Memory and NMS work stay
+ * bounded by top_k however many cells pass the threshold.
+ */
+typedef struct Detector_{
+    Detector_Config    config;
+    Nms_Key           *heap;
+    u32                heap_count;
+    BoundingBox_Buffer boxes;           // frame survivors, then the level being added
+    Nms                nms;
+    u32                cells[DETECTOR_CHUNK];
+    u32                candidates;      // cells offered to the heap since the last reset
+    u32                evicted;         // heap entries replaced by a better score
+} Detector;
+
+/************************** Function Prototypes ****************************/
+
+// memory_len has to be at least DETECTOR_MEMORY_SIZE(config->top_k)
+int DETECTOR_init(Detector *instance, const Detector_Config *config, void *memory, u32 memory_len);
+
+// starts a new frame
+void DETECTOR_reset(Detector *instance);
+
+/**
+ * Adds one level, heads as in BBOX_extract. Returns the frame's survivors
+ * so far, they are instance->boxes in descending score order.
+ */
+u32 DETECTOR_add_level(Detector *instance, const float *const heads[6], u32 height, u32 width, float scale);
+
+#endif // NET_ENGINE_DETECTOR_H
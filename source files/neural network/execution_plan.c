@@ -0,0 +1,77 @@
+#include "execution_plan.h"
+#include <xil_printf.h>
+
+void PLAN_cache_init(Plan_Cache *cache){
+    cache->count       = 0;
+    cache->next_victim = 0;
+}
+
+Execution_Plan* PLAN_cache_find(Plan_Cache *cache, u32 height, u32 width){
+    for(u32 index = 0; index < cache->count; index++){
+        if(cache->plans[index].height == height && cache->plans[index].width == width){
+            cache->plans[index].use_count++;
+            return &cache->plans[index];
+        }
+    }
+    return NULL;
+}
+
+Execution_Plan* PLAN_cache_reserve(Plan_Cache *cache, u32 height, u32 width, const Execution_Plan *in_use){
+    Execution_Plan *plan = NULL;
+
+    if(cache->count < PLAN_CACHE_SIZE){
+        plan = &cache->plans[cache->count++];
+    }
+    else{
+        // the layers are wired to the plan in use, it is never recycled under them
+        if(&cache->plans[cache->next_victim] == in_use){
+            cache->next_victim = (cache->next_victim + 1) % PLAN_CACHE_SIZE;
+        }
+        plan = &cache->plans[cache->next_victim];
+        cache->next_victim = (cache->next_victim + 1) % PLAN_CACHE_SIZE;
+    }
+
+    plan->height      = height;
+    plan->width       = width;
+    plan->layer_count = 0;
+    plan->use_count   = 0;
+
+    return plan;
+}
+
+int PLAN_layer_build(Layer_Plan *plan, const Layer *layer, u32 in_height, u32 in_width){
+    u32 out_height = 0;
+    u32 out_width  = 0;
+
+    if(LAYER_output_shape(layer, in_height, in_width, &out_height, &out_width) != 0){
+        xil_printf("Plan: layer %d has no output for %dx%d input \r\n", layer->index, in_height, in_width);
+        return -1;
+    }
+
+    plan->in_height      = in_height;
+    plan->in_width       = in_width;
+    plan->out_height     = out_height;
+    plan->out_width      = out_width;
+    plan->channel_stride = out_height * out_width;
+    plan->frame_stride   = plan->channel_stride * layer->output_channels.count;
+
+    // planes are packed back to back, they have to fit the pool sized for the largest input
+    if((plan->frame_stride * sizeof(u32)) > layer->memory.availale_mem_size){
+        xil_printf("Plan: layer %d needs %d bytes, pool has %d \r\n", layer->index,
+            plan->frame_stride * sizeof(u32), layer->memory.availale_mem_size);
+        return -1;
+    }
+
+    NET_ENGINE_transfer_init(&plan->transfer, out_height, out_width);
+
+    plan->maxpool_kernel = MAXPOOL_KERNEL_GENERIC;
+    if(layer->type == LAYER_TYPE_MAXPOOLING){
+        plan->maxpool_kernel = KERNEL_maxpool_select(layer->geometry.kernal_size, layer->geometry.stride);
+    }
+
+    plan->exp_mode = LAYER_SOFTMAX_EXP_MODE;
+
+    plan->conv_backend = CONV_BACKEND_COUNT;
+
+    return 0;
+}
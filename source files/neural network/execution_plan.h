@@ -0,0 +1,60 @@
+
+#ifndef NET_ENGINE_EXECUTION_PLAN_H
+#define NET_ENGINE_EXECUTION_PLAN_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "net_engine.h"
+#include "kernels.h"
+#include "layer.h"
+
+/**************************** Type Definitions *****************************/
+#define PLAN_CACHE_SIZE     8
+#define PLAN_MAX_LAYERS     10
+
+// everything a layer needs at one input resolution, computed once per (H, W)
+typedef struct Layer_Plan_{
+    u32 in_height;
+    u32 in_width;
+    u32 out_height;
+    u32 out_width;
+    u32 channel_stride;         // u32 words between consecutive output planes
+    u32 frame_stride;           // u32 words between the outputs of consecutive batch frames
+    Net_Engine_Transfer transfer;
+    MAXPOOL_KERNEL  maxpool_kernel;
+    KERNEL_EXP_MODE exp_mode;
+    CONV_BACKEND    conv_backend;       // autotuned 3x3 backend, CONV_BACKEND_COUNT keeps the layer's own
+} Layer_Plan;
+
+typedef struct Execution_Plan_{
+    u32 height;
+    u32 width;
+    u32 layer_count;
+    u32 use_count;
+    Layer_Plan layers[PLAN_MAX_LAYERS];
+} Execution_Plan;
+
+typedef struct Plan_Cache_{
+    Execution_Plan plans[PLAN_CACHE_SIZE];
+    u32 count;
+    u32 next_victim;
+} Plan_Cache;
+
+/************************** Function Prototypes ****************************/
+
+void PLAN_cache_init(Plan_Cache *cache);
+
+Execution_Plan* PLAN_cache_find(Plan_Cache *cache, u32 height, u32 width);
+
+/**
+ * Returns an empty plan slot for (height, width). Once the cache is full the
+ * slots are recycled round robin, skipping in_use (the plan the layers are
+ * wired to, or NULL), so plans built at startup for the configured scale
+ * set stay resident as long as there are at most PLAN_CACHE_SIZE of them.
+ */
+Execution_Plan* PLAN_cache_reserve(Plan_Cache *cache, u32 height, u32 width, const Execution_Plan *in_use);
+
+int PLAN_layer_build(Layer_Plan *plan, const Layer *layer, u32 in_height, u32 in_width);
+
+#endif // NET_ENGINE_EXECUTION_PLAN_H
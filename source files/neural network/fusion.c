@@ -0,0 +1,222 @@
+#include "fusion.h"
+#include "kernels.h"
+#include "prepack.h"
+#include "trace.h"
+#include <string.h>
+#include <xil_printf.h>
+
+int FUSION_init(Fusion *instance, NeuralNetwork *network, u32 *memory, u32 memory_len){
+    NN_Layer_Info info[FUSION_MAX_LAYERS];
+    Fusion_Stage *stage;
+    Fusion_Stage *source;
+    int count;
+
+    instance->network     = network;
+    instance->memory      = memory;
+    instance->memory_len  = memory_len;
+    instance->used        = 0;
+    instance->stage_count = 0;
+
+    count = NEURAL_NETWORK_layer_info(network, info, FUSION_MAX_LAYERS, FUSION_MAX_CHANNELS);
+    if(count < 0){
+        return -1;
+    }
+
+    for(u32 index = 0; index < (u32)count; index++){
+        stage                = &instance->stages[index];
+        stage->layer         = info[index].layer;
+        stage->source        = info[index].source;
+        stage->kernal_size   = info[index].kernal_size;
+        stage->stride        = info[index].stride;
+        stage->in_channels   = info[index].in_channels;
+        stage->out_channels  = info[index].out_channels;
+        stage->depth         = 0;
+        stage->rows          = NULL;
+        stage->rows_done     = 0;
+
+        switch(stage->layer->type){
+            case LAYER_TYPE_CNN_3X3:
+                if(stage->layer->packed == NULL){
+                    xil_printf("Fusion: layer %d is not prepacked \r\n", index);
+                    return -1;
+                }
+                break;
+            case LAYER_TYPE_CNN_1X1:
+                break;
+            case LAYER_TYPE_MAXPOOLING:
+                if(stage->source < 0){
+                    return -1;
+                }
+                break;
+            default:
+                xil_printf("Fusion: layer %d type %d not supported \r\n", index, stage->layer->type);
+                return -1;
+        }
+
+        // the window of this layer plus the rows it steps over before the oldest one is released
+        if(stage->source >= 0){
+            source = &instance->stages[stage->source];
+            if(source->depth < stage->kernal_size + stage->stride - 1){
+                source->depth = stage->kernal_size + stage->stride - 1;
+            }
+        }
+    }
+
+    instance->stage_count = count;
+    return 0;
+}
+
+// line buffers for the active plan's widths
+static int FUSION_layout(Fusion *instance){
+    Fusion_Stage *stage;
+    u32 offset = 0;
+
+    for(u32 index = 0; index < instance->stage_count; index++){
+        stage = &instance->stages[index];
+        if(stage->layer->plan == NULL){
+            xil_printf("Fusion: no plan for layer %d \r\n", index);
+            return -1;
+        }
+
+        stage->row_words = stage->layer->plan->out_width;
+        stage->rows_done = 0;
+        if(stage->depth != 0){
+            stage->rows = (float*)(instance->memory + offset);
+            offset     += stage->out_channels * 2 * stage->depth * stage->row_words;
+        }
+    }
+
+    instance->used = offset * sizeof(u32);
+    if(instance->used > instance->memory_len){
+        xil_printf("Fusion: line buffers need %d bytes, have %d \r\n", instance->used, instance->memory_len);
+        return -1;
+    }
+
+    return 0;
+}
+
+static float* FUSION_row(const Fusion_Stage *stage, u32 channel, u32 row){
+    return stage->rows + ((((channel * 2 * stage->depth) + (row % stage->depth))) * stage->row_words);
+}
+
+static void FUSION_conv1x1_row(const Fusion_Stage *stage, const float *const *inputs, float *const *outputs){
+    const Layer *layer = stage->layer;
+    u32 width = layer->plan->out_width;
+    Channel_Node *output_channel = layer->output_channels.channels;
+    CNN_1x1_Data *data;
+
+    for(u32 out = 0; output_channel != NULL; out++){
+        data = output_channel->data.cnn_1x1_data.data;
+        KERNEL_conv1x1(inputs, stage->in_channels, width, outputs[out], (const float*)data->kernal_data, data->bias);
+        output_channel = (Channel_Node*)output_channel->next;
+    }
+
+    if(layer->activation == LAYER_ACTIVATION_SOFTMAX){
+        KERNEL_softmax((float**)outputs, stage->out_channels, width, layer->plan->exp_mode);
+    }
+}
+
+static void FUSION_compute(const Fusion_Stage *stage, const float *const *inputs, float *const *outputs, u32 window){
+    const Layer          *layer  = stage->layer;
+    const Layer_Plan     *plan   = layer->plan;
+    const Prepacked_Conv *packed = layer->packed;
+
+    switch(layer->type){
+        case LAYER_TYPE_CNN_3X3:
+            KERNEL_conv3x3_direct(inputs, packed->in_channels, plan->in_width, outputs, packed->out_channels,
+                                  1, plan->out_width, packed->panels, packed->bias, packed->alpha);
+            break;
+        case LAYER_TYPE_MAXPOOLING:
+            for(u32 channel = 0; channel < stage->out_channels; channel++){
+                KERNEL_maxpool(plan->maxpool_kernel, inputs[channel], window, plan->in_width,
+                               outputs[channel], 1, plan->out_width, stage->kernal_size, stage->stride);
+            }
+            break;
+        case LAYER_TYPE_CNN_1X1:
+            FUSION_conv1x1_row(stage, inputs, outputs);
+            break;
+        default:
+            break;
+    }
+}
+
+// produces rows of stage up to (not including) rows, pulling its source along
+static int FUSION_pull(Fusion *instance, Fusion_Stage *stage, u32 rows){
+    const Layer_Plan *plan   = stage->layer->plan;
+    Fusion_Stage     *source = (stage->source >= 0) ? &instance->stages[stage->source] : NULL;
+    const float      *inputs[FUSION_MAX_CHANNELS];
+    float            *outputs[FUSION_MAX_CHANNELS];
+    Channel_Node     *channel;
+    u32 first;
+    u32 window;
+    u32 index;
+
+    while(stage->rows_done < rows){
+        first  = stage->rows_done * stage->stride;
+        window = (stage->kernal_size < plan->in_height - first) ? stage->kernal_size : plan->in_height - first;
+
+        if(source != NULL){
+            if(FUSION_pull(instance, source, first + window) != 0){
+                return -1;
+            }
+            // another reader ran ahead and the window has already been recycled
+            if(first + source->depth < source->rows_done){
+                xil_printf("Fusion: line buffer of layer %d too shallow \r\n", stage->source);
+                return -1;
+            }
+        }
+
+        index = 0;
+        for(channel = stage->layer->input_channels.channels; channel != NULL && index < stage->in_channels; channel = (Channel_Node*)channel->next){
+            inputs[index] = (source != NULL) ? FUSION_row(source, index, first)
+                                             : (const float*)channel->data.input_ptr + (first * plan->in_width);
+            index++;
+        }
+
+        index = 0;
+        for(channel = stage->layer->output_channels.channels; channel != NULL && index < stage->out_channels; channel = (Channel_Node*)channel->next){
+            outputs[index] = (stage->depth != 0) ? FUSION_row(stage, index, stage->rows_done)
+                                                 : (float*)channel->data.output_ptr + (stage->rows_done * plan->out_width);
+            index++;
+        }
+
+        FUSION_compute(stage, inputs, outputs, window);
+
+        // the second copy keeps a window contiguous when it wraps around the ring
+        if(stage->depth != 0){
+            for(index = 0; index < stage->out_channels; index++){
+                memcpy(outputs[index] + (stage->depth * stage->row_words), outputs[index], plan->out_width * sizeof(float));
+            }
+        }
+
+        stage->rows_done++;
+    }
+
+    return 0;
+}
+
+int FUSION_process(Fusion *instance){
+    Fusion_Stage *stage;
+    u8  pending = 1;
+    int ret     = 0;
+
+    if(FUSION_layout(instance) != 0){
+        return -1;
+    }
+
+    TRACE_BEGIN("fused", instance->stage_count);
+    // heads advance a row at a time together, so a shared source serves both from the same window
+    for(u32 row = 0; pending && ret == 0; row++){
+        pending = 0;
+        for(u32 index = 0; index < instance->stage_count && ret == 0; index++){
+            stage = &instance->stages[index];
+            if(stage->depth == 0 && row < stage->layer->plan->out_height){
+                ret     = FUSION_pull(instance, stage, row + 1);
+                pending = 1;
+            }
+        }
+    }
+    TRACE_END("fused");
+
+    return ret;
+}
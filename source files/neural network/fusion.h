@@ -0,0 +1,55 @@
+
+#ifndef NET_ENGINE_FUSION_H
+#define NET_ENGINE_FUSION_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+
+/**************************** Type Definitions *****************************/
+#define FUSION_MAX_LAYERS       PLAN_MAX_LAYERS
+#define FUSION_MAX_CHANNELS     64
+
+// one layer of the fused network
+typedef struct Fusion_Stage_{
+    Layer  *layer;
+    int     source;             // stage feeding this one, -1 for the network input
+    u32     kernal_size;
+    u32     stride;
+    u32     in_channels;
+    u32     out_channels;
+    u32     depth;              // rows kept per output channel, 0 when rows go straight to the layer's output planes
+    u32     row_words;          // u32 words per output row
+    float  *rows;               // [channel][2 * depth][row_words], each row is written twice so depth rows in a row are contiguous
+    u32     rows_done;
+} Fusion_Stage;
+
+typedef struct Fusion_{
+    NeuralNetwork *network;
+    u32           *memory;
+    u32            memory_len;      // bytes
+    u32            used;            // bytes of line buffers for the active plan
+    u32            stage_count;
+    Fusion_Stage   stages[FUSION_MAX_LAYERS];
+} Fusion;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Sets up depth first execution of a built network. Every 3x3 layer has to
+ * be prepacked. Layers read by another layer only keep a few rows in line
+ * buffers carved from memory, the others (the heads) still write their
+ * full output planes.
+ */
+int FUSION_init(Fusion *instance, NeuralNetwork *network, u32 *memory, u32 memory_len);
+
+/**
+ * Runs the network's active plan one output row at a time: every head row
+ * pulls just the rows it needs through the layers before it, like the row
+ * FIFOs of the Net Engine. The results match the direct CPU backend, but
+ * only the head layers' outputs are written to their pools.
+ */
+int FUSION_process(Fusion *instance);
+
+#endif // NET_ENGINE_FUSION_H
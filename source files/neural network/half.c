@@ -0,0 +1,247 @@
+#include "half.h"
+#include "kernels.h"
+#include "prepack.h"
+#include "tiling.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <xil_printf.h>
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+int HALF_init(Half_Network *instance, NeuralNetwork *network, u16 *memory, u32 memory_len, float *scratch, u32 scratch_len){
+    NN_Layer_Info info[HALF_MAX_LAYERS];
+    Half_Layer   *layer;
+    const Prepacked_Conv *packed;
+    int count;
+
+    instance->network     = network;
+    instance->memory      = memory;
+    instance->memory_len  = memory_len;
+    instance->used        = 0;
+    instance->scratch     = scratch;
+    instance->scratch_len = scratch_len;
+    instance->layer_count = 0;
+
+    count = NEURAL_NETWORK_layer_info(network, info, HALF_MAX_LAYERS, HALF_MAX_CHANNELS);
+    if(count < 0){
+        return -1;
+    }
+
+    for(u32 index = 0; index < (u32)count; index++){
+        layer               = &instance->layers[index];
+        layer->layer        = info[index].layer;
+        layer->source       = info[index].source;
+        layer->head         = info[index].head;
+        layer->in_channels  = info[index].in_channels;
+        layer->out_channels = info[index].out_channels;
+        layer->kernal_size  = info[index].kernal_size;
+        layer->stride       = info[index].stride;
+        layer->panels       = NULL;
+        layer->panel_count  = 0;
+        layer->output       = NULL;
+        instance->layer_count = index + 1;
+
+        switch(layer->layer->type){
+            case LAYER_TYPE_CNN_3X3:
+                packed = layer->layer->packed;
+                if(packed == NULL){
+                    xil_printf("Half: layer %d is not prepacked \r\n", index);
+                    HALF_free(instance);
+                    return -1;
+                }
+                layer->panel_count = ((packed->out_channels + KERNEL_CONV_LANES - 1) / KERNEL_CONV_LANES) * packed->in_channels * 9 * KERNEL_CONV_LANES;
+                layer->panels      = (u16*)malloc(layer->panel_count * sizeof(u16));
+                if(layer->panels == NULL){
+                    xil_printf("Half malloc failed \r\n");
+                    HALF_free(instance);
+                    return -1;
+                }
+                KERNEL_float_to_half(packed->panels, layer->panels, layer->panel_count);
+                break;
+            case LAYER_TYPE_CNN_1X1:
+            case LAYER_TYPE_MAXPOOLING:
+                break;
+            default:
+                xil_printf("Half: layer %d type %d not supported \r\n", index, layer->layer->type);
+                HALF_free(instance);
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+// half planes for the active plan's shapes
+static int HALF_layout(Half_Network *instance){
+    Half_Layer *layer;
+    u32 offset = 0;
+
+    for(u32 index = 0; index < instance->layer_count; index++){
+        layer = &instance->layers[index];
+        if(layer->layer->plan == NULL){
+            xil_printf("Half: no plan for layer %d \r\n", index);
+            return -1;
+        }
+        if(!layer->head){
+            layer->output = instance->memory + offset;
+            offset       += layer->out_channels * layer->layer->plan->out_height * layer->layer->plan->out_width;
+        }
+    }
+
+    instance->used = offset * sizeof(u16);
+    if(instance->used > instance->memory_len){
+        xil_printf("Half: half planes need %d bytes, have %d \r\n", instance->used, instance->memory_len);
+        return -1;
+    }
+
+    return 0;
+}
+
+// output rows per band that fit scratch next to the widened weights
+static u32 HALF_band_rows(const Half_Network *instance, const Half_Layer *layer){
+    const Layer_Plan *plan = layer->layer->plan;
+    u32 available = instance->scratch_len / sizeof(float);
+    u32 fixed     = layer->panel_count;
+    u32 per_row   = 0;
+    u32 rows;
+
+    if(layer->source >= 0){
+        fixed   += layer->in_channels * ((layer->kernal_size > layer->stride) ? layer->kernal_size - layer->stride : 0) * plan->in_width;
+        per_row += layer->in_channels * layer->stride * plan->in_width;
+    }
+    if(!layer->head){
+        per_row += layer->out_channels * plan->out_width;
+    }
+    if(fixed >= available){
+        return 0;
+    }
+
+    rows = (per_row != 0) ? (available - fixed) / per_row : plan->out_height;
+    rows = min(rows, TILING_conv_rows(layer->in_channels * plan->in_width * sizeof(float),
+                                      layer->out_channels * plan->out_width * sizeof(float), plan->out_height, 1));
+    return rows;
+}
+
+static void HALF_conv1x1(const Half_Layer *layer, const float *const *inputs, float *const *outputs, u32 count){
+    Channel_Node *output_channel = layer->layer->output_channels.channels;
+    CNN_1x1_Data *data;
+
+    for(u32 out = 0; output_channel != NULL && out < layer->out_channels; out++){
+        data = output_channel->data.cnn_1x1_data.data;
+        KERNEL_conv1x1(inputs, layer->in_channels, count, outputs[out], (const float*)data->kernal_data, data->bias);
+        output_channel = (Channel_Node*)output_channel->next;
+    }
+
+    if(layer->layer->activation == LAYER_ACTIVATION_SOFTMAX){
+        KERNEL_softmax((float**)outputs, layer->out_channels, count, layer->layer->plan->exp_mode);
+    }
+}
+
+static int HALF_layer(Half_Network *instance, const Half_Layer *layer){
+    const Layer_Plan     *plan   = layer->layer->plan;
+    const Prepacked_Conv *packed = layer->layer->packed;
+    const u16  *source = (layer->source >= 0) ? instance->layers[layer->source].output : NULL;
+    const float *planes[HALF_MAX_CHANNELS];
+    const float *inputs[HALF_MAX_CHANNELS];
+    float       *heads[HALF_MAX_CHANNELS];
+    float       *outputs[HALF_MAX_CHANNELS];
+    float       *in_band;
+    float       *out_band;
+    Channel_Node *channel;
+    u32 in_plane  = plan->in_height  * plan->in_width;
+    u32 out_plane = plan->out_height * plan->out_width;
+    u32 rows      = HALF_band_rows(instance, layer);
+    u32 band_in;
+    u32 count;
+    u32 first;
+    u32 in_rows;
+    u32 index;
+
+    if(rows == 0){
+        xil_printf("Half: scratch too small for layer %d \r\n", layer->layer->index);
+        return -1;
+    }
+
+    index = 0;
+    for(channel = layer->layer->input_channels.channels; channel != NULL && index < layer->in_channels; channel = (Channel_Node*)channel->next){
+        planes[index++] = (const float*)channel->data.input_ptr;
+    }
+    index = 0;
+    for(channel = layer->layer->output_channels.channels; channel != NULL && index < layer->out_channels; channel = (Channel_Node*)channel->next){
+        heads[index++] = (float*)channel->data.output_ptr;
+    }
+
+    // weights are widened once per layer, then bands of input rows
+    KERNEL_half_to_float(layer->panels, instance->scratch, layer->panel_count);
+    band_in  = min(((rows - 1) * layer->stride) + layer->kernal_size, plan->in_height);
+    in_band  = instance->scratch + layer->panel_count;
+    out_band = in_band + ((source != NULL) ? layer->in_channels * band_in * plan->in_width : 0);
+
+    for(u32 row = 0; row < plan->out_height; row += rows){
+        count   = min(rows, plan->out_height - row);
+        first   = row * layer->stride;
+        in_rows = min(((row + count - 1) * layer->stride) + layer->kernal_size, plan->in_height) - first;
+
+        for(u32 in = 0; in < layer->in_channels; in++){
+            if(source != NULL){
+                KERNEL_half_to_float(source + (in * in_plane) + (first * plan->in_width), in_band + (in * band_in * plan->in_width), in_rows * plan->in_width);
+                inputs[in] = in_band + (in * band_in * plan->in_width);
+            }
+            else{
+                inputs[in] = planes[in] + (first * plan->in_width);
+            }
+        }
+        for(u32 out = 0; out < layer->out_channels; out++){
+            outputs[out] = layer->head ? heads[out] + (row * plan->out_width) : out_band + (out * rows * plan->out_width);
+        }
+
+        switch(layer->layer->type){
+            case LAYER_TYPE_CNN_3X3:
+                KERNEL_conv3x3_direct(inputs, layer->in_channels, plan->in_width, outputs, layer->out_channels,
+                                      count, plan->out_width, instance->scratch, packed->bias, packed->alpha);
+                break;
+            case LAYER_TYPE_MAXPOOLING:
+                for(u32 out = 0; out < layer->out_channels; out++){
+                    KERNEL_maxpool(plan->maxpool_kernel, inputs[out], in_rows, plan->in_width, outputs[out], count,
+                                   plan->out_width, layer->kernal_size, layer->stride);
+                }
+                break;
+            case LAYER_TYPE_CNN_1X1:
+                HALF_conv1x1(layer, inputs, outputs, count * plan->out_width);
+                break;
+            default:
+                break;
+        }
+
+        if(!layer->head){
+            for(u32 out = 0; out < layer->out_channels; out++){
+                KERNEL_float_to_half(outputs[out], layer->output + (out * out_plane) + (row * plan->out_width), count * plan->out_width);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int HALF_process(Half_Network *instance){
+    int ret = 0;
+
+    if(instance->layer_count == 0 || HALF_layout(instance) != 0){
+        return -1;
+    }
+
+    TRACE_BEGIN("half", instance->layer_count);
+    for(u32 index = 0; index < instance->layer_count && ret == 0; index++){
+        ret = HALF_layer(instance, &instance->layers[index]);
+    }
+    TRACE_END("half");
+
+    return ret;
+}
+
+void HALF_free(Half_Network *instance){
+    for(u32 index = 0; index < instance->layer_count && index < HALF_MAX_LAYERS; index++){
+        free(instance->layers[index].panels);
+        instance->layers[index].panels = NULL;
+    }
+}
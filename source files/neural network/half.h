@@ -0,0 +1,57 @@
+
+#ifndef NET_ENGINE_HALF_H
+#define NET_ENGINE_HALF_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+
+/**************************** Type Definitions *****************************/
+#define HALF_MAX_LAYERS         PLAN_MAX_LAYERS
+#define HALF_MAX_CHANNELS       64
+
+typedef struct Half_Layer_{
+    Layer  *layer;
+    int     source;             // layer feeding this one, -1 for the network input
+    u8      head;               // no other layer reads it, written as float into the layer's pool
+    u32     in_channels;
+    u32     out_channels;
+    u32     kernal_size;
+    u32     stride;
+    u16    *panels;             // 3x3: prepacked direct panels in half precision
+    u32     panel_count;        // floats in the widened panels
+    u16    *output;             // half planes of the active plan, NULL for heads
+} Half_Layer;
+
+typedef struct Half_Network_{
+    NeuralNetwork *network;
+    u16           *memory;
+    u32            memory_len;      // bytes
+    u32            used;            // bytes of half planes for the active plan
+    float         *scratch;         // fp32 weights and row bands of the layer being computed
+    u32            scratch_len;     // bytes
+    u32            layer_count;
+    Half_Layer     layers[HALF_MAX_LAYERS];
+} Half_Network;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Sets up half precision storage for a built network. Every 3x3 layer has to
+ * be prepacked; its panels are kept in half precision. Layers read by another
+ * layer store their outputs as half planes carved from memory, the heads still
+ * write float planes to their pools.
+ */
+int HALF_init(Half_Network *instance, NeuralNetwork *network, u16 *memory, u32 memory_len, float *scratch, u32 scratch_len);
+
+/**
+ * Runs the network's active plan with half precision storage and fp32
+ * compute: each layer widens its weights and a band of input rows into
+ * scratch, runs the float kernels and narrows the band it produced.
+ */
+int HALF_process(Half_Network *instance);
+
+void HALF_free(Half_Network *instance);
+
+#endif // NET_ENGINE_HALF_H
@@ -0,0 +1,1048 @@
+#include "kernels.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+MAXPOOL_KERNEL KERNEL_maxpool_select(u32 pool_size, u32 stride){
+    if(pool_size == 2 && stride == 2){
+        return MAXPOOL_KERNEL_2X2_S2;
+    }
+    if(pool_size == 3 && stride == 2){
+        return MAXPOOL_KERNEL_3X3_S2;
+    }
+    return MAXPOOL_KERNEL_GENERIC;
+}
+
+// number of output pixels (along one axis) whose window fits inside the input
+static u32 KERNEL_maxpool_full_extent(u32 in_size, u32 out_size, u32 pool_size, u32 stride){
+    if(in_size < pool_size){
+        return 0;
+    }
+    return min(out_size, ((in_size - pool_size) / stride) + 1);
+}
+
+// window clipped to the input, used for the ragged edges and the generic kernel
+static float KERNEL_maxpool_window(const float *input, u32 in_height, u32 in_width,
+                                   u32 start_y, u32 start_x, u32 pool_size){
+    float max_value = -FLT_MAX;
+    u32   end_y, end_x;
+
+    if(start_y >= in_height || start_x >= in_width){
+        return max_value;
+    }
+
+    end_y = min(start_y + pool_size, in_height);
+    end_x = min(start_x + pool_size, in_width);
+
+    for(u32 iy = start_y; iy < end_y; iy++){
+        const float *row = &input[iy * in_width];
+        for(u32 ix = start_x; ix < end_x; ix++){
+            if(row[ix] > max_value){
+                max_value = row[ix];
+            }
+        }
+    }
+    return max_value;
+}
+
+static inline float KERNEL_max(float a, float b){
+    return a > b ? a : b;
+}
+
+static inline float KERNEL_min(float a, float b){
+    return a < b ? a : b;
+}
+
+static void KERNEL_maxpool_2x2_s2(const float *input, u32 in_width, float *output,
+                                  u32 out_width, u32 full_height, u32 full_width){
+    for(u32 y = 0; y < full_height; y++){
+        const float *row_0 = &input[(2 * y) * in_width];
+        const float *row_1 = row_0 + in_width;
+        float       *out   = &output[y * out_width];
+        u32 x = 0;
+
+#ifdef KERNEL_USE_NEON
+        for(; x + 4 <= full_width; x += 4){
+            float32x4x2_t top    = vld2q_f32(&row_0[2 * x]);
+            float32x4x2_t bottom = vld2q_f32(&row_1[2 * x]);
+
+            float32x4_t max_top    = vmaxq_f32(top.val[0],    top.val[1]);
+            float32x4_t max_bottom = vmaxq_f32(bottom.val[0], bottom.val[1]);
+
+            vst1q_f32(&out[x], vmaxq_f32(max_top, max_bottom));
+        }
+#endif
+        for(; x < full_width; x++){
+            out[x] = KERNEL_max(KERNEL_max(row_0[2 * x], row_0[2 * x + 1]),
+                                KERNEL_max(row_1[2 * x], row_1[2 * x + 1]));
+        }
+    }
+}
+
+static void KERNEL_maxpool_3x3_s2(const float *input, u32 in_width, float *output,
+                                  u32 out_width, u32 full_height, u32 full_width){
+    for(u32 y = 0; y < full_height; y++){
+        const float *row_0 = &input[(2 * y) * in_width];
+        const float *row_1 = row_0 + in_width;
+        const float *row_2 = row_1 + in_width;
+        float       *out   = &output[y * out_width];
+        u32 x = 0;
+
+#ifdef KERNEL_USE_NEON
+        for(; x + 4 <= full_width; x += 4){
+            // even / odd taps of the three rows, columns 2x .. 2x+7
+            float32x4x2_t r0 = vld2q_f32(&row_0[2 * x]);
+            float32x4x2_t r1 = vld2q_f32(&row_1[2 * x]);
+            float32x4x2_t r2 = vld2q_f32(&row_2[2 * x]);
+
+            float32x4_t even = vmaxq_f32(vmaxq_f32(r0.val[0], r1.val[0]), r2.val[0]);
+            float32x4_t odd  = vmaxq_f32(vmaxq_f32(r0.val[1], r1.val[1]), r2.val[1]);
+
+            // column 2x+8 closes the last window, shift it into the even lane set
+            float tail = KERNEL_max(KERNEL_max(row_0[2 * x + 8], row_1[2 * x + 8]), row_2[2 * x + 8]);
+            float32x4_t next = vextq_f32(even, vdupq_n_f32(tail), 1);
+
+            vst1q_f32(&out[x], vmaxq_f32(vmaxq_f32(even, odd), next));
+        }
+#endif
+        for(; x < full_width; x++){
+            u32 ix = 2 * x;
+            float m0 = KERNEL_max(KERNEL_max(row_0[ix],     row_0[ix + 1]), row_0[ix + 2]);
+            float m1 = KERNEL_max(KERNEL_max(row_1[ix],     row_1[ix + 1]), row_1[ix + 2]);
+            float m2 = KERNEL_max(KERNEL_max(row_2[ix],     row_2[ix + 1]), row_2[ix + 2]);
+            out[x] = KERNEL_max(KERNEL_max(m0, m1), m2);
+        }
+    }
+}
+
+void KERNEL_maxpool(MAXPOOL_KERNEL kernel, const float *input, u32 in_height, u32 in_width,
+                    float *output, u32 out_height, u32 out_width, u32 pool_size, u32 stride){
+    u32 full_height = 0;
+    u32 full_width  = 0;
+
+    if(kernel != MAXPOOL_KERNEL_GENERIC){
+        full_height = KERNEL_maxpool_full_extent(in_height, out_height, pool_size, stride);
+        full_width  = KERNEL_maxpool_full_extent(in_width,  out_width,  pool_size, stride);
+    }
+
+    switch(kernel){
+        case MAXPOOL_KERNEL_2X2_S2: KERNEL_maxpool_2x2_s2(input, in_width, output, out_width, full_height, full_width); break;
+        case MAXPOOL_KERNEL_3X3_S2: KERNEL_maxpool_3x3_s2(input, in_width, output, out_width, full_height, full_width); break;
+        case MAXPOOL_KERNEL_GENERIC: break;
+    }
+
+    // ragged right columns of the rows handled above
+    for(u32 y = 0; y < full_height; y++){
+        for(u32 x = full_width; x < out_width; x++){
+            output[y * out_width + x] = KERNEL_maxpool_window(input, in_height, in_width, y * stride, x * stride, pool_size);
+        }
+    }
+
+    // ragged bottom rows (every row for the generic kernel)
+    for(u32 y = full_height; y < out_height; y++){
+        for(u32 x = 0; x < out_width; x++){
+            output[y * out_width + x] = KERNEL_maxpool_window(input, in_height, in_width, y * stride, x * stride, pool_size);
+        }
+    }
+}
+
+#define EXP_INPUT_MAX        88.0f
+#define EXP_INPUT_MIN       -87.0f
+#define EXP_LOG2E            1.44269504088896341f
+#define EXP_LN2_HI           0.693359375f
+#define EXP_LN2_LO          -2.12194440e-4f
+
+// cephes expf polynomial, exp(r) = 1 + r + r^2 * P(r)
+#define EXP_ACCURATE_P0      1.9875691500e-4f
+#define EXP_ACCURATE_P1      1.3981999507e-3f
+#define EXP_ACCURATE_P2      8.3334519073e-3f
+#define EXP_ACCURATE_P3      4.1665795894e-2f
+#define EXP_ACCURATE_P4      1.6666665459e-1f
+#define EXP_ACCURATE_P5      5.0000001201e-1f
+
+// least squares fit on [-ln2/2, ln2/2], exp(r) = 1 + r + r^2 * Q(r)
+#define EXP_FAST_Q0          3.9878670e-2f
+#define EXP_FAST_Q1          1.6736105e-1f
+#define EXP_FAST_Q2          5.0015545e-1f
+
+typedef union{
+    float f;
+    s32   i;
+} Kernel_Float_Bits;
+
+float KERNEL_expf(float x, KERNEL_EXP_MODE mode){
+    Kernel_Float_Bits scale;
+    float n, r, p;
+
+    if(x > EXP_INPUT_MAX) x = EXP_INPUT_MAX;
+    if(x < EXP_INPUT_MIN) x = EXP_INPUT_MIN;
+
+    // x = n * ln2 + r
+    n = (float)(s32)(x * EXP_LOG2E + (x >= 0.0f ? 0.5f : -0.5f));
+    r = x - n * EXP_LN2_HI;
+    r = r - n * EXP_LN2_LO;
+
+    if(mode == KERNEL_EXP_FAST){
+        p = EXP_FAST_Q0;
+        p = p * r + EXP_FAST_Q1;
+        p = p * r + EXP_FAST_Q2;
+    }
+    else{
+        p = EXP_ACCURATE_P0;
+        p = p * r + EXP_ACCURATE_P1;
+        p = p * r + EXP_ACCURATE_P2;
+        p = p * r + EXP_ACCURATE_P3;
+        p = p * r + EXP_ACCURATE_P4;
+        p = p * r + EXP_ACCURATE_P5;
+    }
+    p = p * r * r + r + 1.0f;
+
+    // 2^n, n is within [-126, 127] after clamping
+    scale.i = ((s32)n + 127) << 23;
+    return p * scale.f;
+}
+
+#ifdef KERNEL_USE_NEON
+static inline float32x4_t KERNEL_expq_f32(float32x4_t x, KERNEL_EXP_MODE mode){
+    float32x4_t n, r, p;
+    int32x4_t   ni;
+    uint32x4_t  round_down;
+
+    x = vminq_f32(x, vdupq_n_f32(EXP_INPUT_MAX));
+    x = vmaxq_f32(x, vdupq_n_f32(EXP_INPUT_MIN));
+
+    // round to nearest: truncate (x * log2e + 0.5), then fix up negatives
+    n  = vmlaq_f32(vdupq_n_f32(0.5f), x, vdupq_n_f32(EXP_LOG2E));
+    ni = vcvtq_s32_f32(n);
+    round_down = vcgtq_f32(vcvtq_f32_s32(ni), n);
+    ni = vaddq_s32(ni, vreinterpretq_s32_u32(round_down));
+    n  = vcvtq_f32_s32(ni);
+
+    r = vmlsq_f32(x, n, vdupq_n_f32(EXP_LN2_HI));
+    r = vmlsq_f32(r, n, vdupq_n_f32(EXP_LN2_LO));
+
+    if(mode == KERNEL_EXP_FAST){
+        p = vdupq_n_f32(EXP_FAST_Q0);
+        p = vmlaq_f32(vdupq_n_f32(EXP_FAST_Q1), p, r);
+        p = vmlaq_f32(vdupq_n_f32(EXP_FAST_Q2), p, r);
+    }
+    else{
+        p = vdupq_n_f32(EXP_ACCURATE_P0);
+        p = vmlaq_f32(vdupq_n_f32(EXP_ACCURATE_P1), p, r);
+        p = vmlaq_f32(vdupq_n_f32(EXP_ACCURATE_P2), p, r);
+        p = vmlaq_f32(vdupq_n_f32(EXP_ACCURATE_P3), p, r);
+        p = vmlaq_f32(vdupq_n_f32(EXP_ACCURATE_P4), p, r);
+        p = vmlaq_f32(vdupq_n_f32(EXP_ACCURATE_P5), p, r);
+    }
+    p = vmlaq_f32(vaddq_f32(r, vdupq_n_f32(1.0f)), p, vmulq_f32(r, r));
+
+    ni = vshlq_n_s32(vaddq_s32(ni, vdupq_n_s32(127)), 23);
+    return vmulq_f32(p, vreinterpretq_f32_s32(ni));
+}
+
+// reciprocal estimate refined by two Newton-Raphson steps
+static inline float32x4_t KERNEL_recipq_f32(float32x4_t x){
+    float32x4_t y = vrecpeq_f32(x);
+    y = vmulq_f32(y, vrecpsq_f32(x, y));
+    y = vmulq_f32(y, vrecpsq_f32(x, y));
+    return y;
+}
+#endif
+
+void KERNEL_exp(const float *input, float *output, u32 count, KERNEL_EXP_MODE mode){
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+    for(; i + 4 <= count; i += 4){
+        vst1q_f32(&output[i], KERNEL_expq_f32(vld1q_f32(&input[i]), mode));
+    }
+#endif
+    for(; i < count; i++){
+        output[i] = KERNEL_expf(input[i], mode);
+    }
+}
+
+void KERNEL_softmax_2(float *class_0, float *class_1, u32 count, KERNEL_EXP_MODE mode){
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+    for(; i + 4 <= count; i += 4){
+        float32x4_t x0 = vld1q_f32(&class_0[i]);
+        float32x4_t x1 = vld1q_f32(&class_1[i]);
+        float32x4_t e  = KERNEL_expq_f32(vsubq_f32(x1, x0), mode);
+        float32x4_t p0 = KERNEL_recipq_f32(vaddq_f32(e, vdupq_n_f32(1.0f)));
+
+        vst1q_f32(&class_0[i], p0);
+        vst1q_f32(&class_1[i], vmulq_f32(e, p0));
+    }
+#endif
+    for(; i < count; i++){
+        float e  = KERNEL_expf(class_1[i] - class_0[i], mode);
+        float p0 = 1.0f / (1.0f + e);
+
+        class_0[i] = p0;
+        class_1[i] = e * p0;
+    }
+}
+
+void KERNEL_softmax(float **classes, u32 class_count, u32 count, KERNEL_EXP_MODE mode){
+    u32 i = 0;
+
+    if(class_count == 2){
+        KERNEL_softmax_2(classes[0], classes[1], count, mode);
+        return;
+    }
+
+#ifdef KERNEL_USE_NEON
+    for(; i + 4 <= count; i += 4){
+        float32x4_t max_value = vld1q_f32(&classes[0][i]);
+        float32x4_t sum       = vdupq_n_f32(0.0f);
+        float32x4_t inv_sum;
+
+        for(u32 c = 1; c < class_count; c++){
+            max_value = vmaxq_f32(max_value, vld1q_f32(&classes[c][i]));
+        }
+        for(u32 c = 0; c < class_count; c++){
+            float32x4_t e = KERNEL_expq_f32(vsubq_f32(vld1q_f32(&classes[c][i]), max_value), mode);
+            vst1q_f32(&classes[c][i], e);
+            sum = vaddq_f32(sum, e);
+        }
+        inv_sum = KERNEL_recipq_f32(sum);
+        for(u32 c = 0; c < class_count; c++){
+            vst1q_f32(&classes[c][i], vmulq_f32(vld1q_f32(&classes[c][i]), inv_sum));
+        }
+    }
+#endif
+    for(; i < count; i++){
+        float max_value = classes[0][i];
+        float sum       = 0.0f;
+        float inv_sum;
+
+        for(u32 c = 1; c < class_count; c++){
+            if(classes[c][i] > max_value){
+                max_value = classes[c][i];
+            }
+        }
+        for(u32 c = 0; c < class_count; c++){
+            classes[c][i] = KERNEL_expf(classes[c][i] - max_value, mode);
+            sum += classes[c][i];
+        }
+        inv_sum = 1.0f / sum;
+        for(u32 c = 0; c < class_count; c++){
+            classes[c][i] *= inv_sum;
+        }
+    }
+}
+
+// PReLU, alpha == NULL means the layer has no activation
+static inline float KERNEL_prelu(float value, const float *alpha, u32 channel){
+    if(alpha == NULL || value > 0){
+        return value;
+    }
+    return value * alpha[channel];
+}
+
+static void KERNEL_conv3x3_pixel(const float *const *inputs, u32 in_channels, u32 in_width,
+                                 float *const *outputs, u32 out_width, u32 y, u32 x,
+                                 u32 block, u32 lanes, const float *panel, const float *bias, const float *alpha){
+    for(u32 lane = 0; lane < lanes; lane++){
+        float sum = bias[block + lane];
+        for(u32 in = 0; in < in_channels; in++){
+            const float *row    = inputs[in] + (y * in_width) + x;
+            const float *weight = panel + (in * 9 * KERNEL_CONV_LANES) + lane;
+            for(u32 m = 0; m < 3; m++){
+                for(u32 n = 0; n < 3; n++){
+                    sum += row[(m * in_width) + n] * weight[((m * 3) + n) * KERNEL_CONV_LANES];
+                }
+            }
+        }
+        outputs[block + lane][(y * out_width) + x] = KERNEL_prelu(sum, alpha, block + lane);
+    }
+}
+
+void KERNEL_conv3x3_direct(const float *const *inputs, u32 in_channels, u32 in_width,
+                           float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                           const float *panels, const float *bias, const float *alpha){
+    for(u32 block = 0; block < out_channels; block += KERNEL_CONV_LANES){
+        const float *panel = panels + ((block / KERNEL_CONV_LANES) * in_channels * 9 * KERNEL_CONV_LANES);
+        u32 lanes = min(KERNEL_CONV_LANES, out_channels - block);
+
+        for(u32 y = 0; y < out_height; y++){
+            u32 x = 0;
+
+#ifdef KERNEL_USE_NEON
+            // 4 output channels x 4 pixels per step, one weight vector per tap feeds all four accumulators
+            for(; x + 4 <= out_width; x += 4){
+                float32x4_t acc[KERNEL_CONV_LANES];
+                float       lane_out[KERNEL_CONV_LANES][4];
+
+                for(u32 lane = 0; lane < KERNEL_CONV_LANES; lane++){
+                    acc[lane] = vdupq_n_f32((lane < lanes) ? bias[block + lane] : 0.0f);
+                }
+
+                for(u32 in = 0; in < in_channels; in++){
+                    const float *row    = inputs[in] + (y * in_width) + x;
+                    const float *weight = panel + (in * 9 * KERNEL_CONV_LANES);
+
+                    for(u32 m = 0; m < 3; m++){
+                        for(u32 n = 0; n < 3; n++){
+                            float32x4_t pixels = vld1q_f32(row + (m * in_width) + n);
+                            float32x4_t taps   = vld1q_f32(weight);
+                            acc[0] = vmlaq_lane_f32(acc[0], pixels, vget_low_f32(taps),  0);
+                            acc[1] = vmlaq_lane_f32(acc[1], pixels, vget_low_f32(taps),  1);
+                            acc[2] = vmlaq_lane_f32(acc[2], pixels, vget_high_f32(taps), 0);
+                            acc[3] = vmlaq_lane_f32(acc[3], pixels, vget_high_f32(taps), 1);
+                            weight += KERNEL_CONV_LANES;
+                        }
+                    }
+                }
+
+                for(u32 lane = 0; lane < lanes; lane++){
+                    if(alpha != NULL){
+                        uint32x4_t positive = vcgtq_f32(acc[lane], vdupq_n_f32(0.0f));
+                        acc[lane] = vbslq_f32(positive, acc[lane], vmulq_n_f32(acc[lane], alpha[block + lane]));
+                    }
+                    if(lanes == KERNEL_CONV_LANES){
+                        vst1q_f32(outputs[block + lane] + (y * out_width) + x, acc[lane]);
+                    }
+                    else{
+                        vst1q_f32(lane_out[lane], acc[lane]);
+                        for(u32 i = 0; i < 4; i++){
+                            outputs[block + lane][(y * out_width) + x + i] = lane_out[lane][i];
+                        }
+                    }
+                }
+            }
+#endif
+
+            for(; x < out_width; x++){
+                KERNEL_conv3x3_pixel(inputs, in_channels, in_width, outputs, out_width, y, x, block, lanes, panel, bias, alpha);
+            }
+        }
+    }
+}
+
+void KERNEL_conv3x3_sparse(const float *const *inputs, u32 in_width,
+                           float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                           const u32 *starts, const u16 *taps, const float *weights, const float *bias, const float *alpha){
+    for(u32 out = 0; out < out_channels; out++){
+        for(u32 y = 0; y < out_height; y++){
+            float *row = outputs[out] + (y * out_width);
+
+            for(u32 x = 0; x < out_width; x++){
+                row[x] = bias[out];
+            }
+
+            // one row wide multiply accumulate per nonzero tap
+            for(u32 i = starts[out]; i < starts[out + 1]; i++){
+                const float *input = inputs[taps[i] / 9] + ((y + ((taps[i] % 9) / 3)) * in_width) + (taps[i] % 3);
+                float weight = weights[i];
+                u32 x = 0;
+
+#ifdef KERNEL_USE_NEON
+                for(; x + 4 <= out_width; x += 4){
+                    vst1q_f32(row + x, vmlaq_n_f32(vld1q_f32(row + x), vld1q_f32(input + x), weight));
+                }
+#endif
+                for(; x < out_width; x++){
+                    row[x] += input[x] * weight;
+                }
+            }
+
+            if(alpha != NULL){
+                for(u32 x = 0; x < out_width; x++){
+                    row[x] = KERNEL_prelu(row[x], alpha, out);
+                }
+            }
+        }
+    }
+}
+
+// denormal operands and results of the engine's float operators read as zero
+static inline float KERNEL_ftz(float value){
+    return (fabsf(value) < FLT_MIN) ? value * 0.0f : value;
+}
+
+static float KERNEL_engine_cell(const float *window, u32 in_width, const float *kernel, float bias){
+    float p[9];
+
+    for(u32 tap = 0; tap < 9; tap++){
+        p[tap] = KERNEL_ftz(KERNEL_ftz(window[((tap / 3) * in_width) + (tap % 3)]) * kernel[tap]);
+    }
+
+    return KERNEL_ftz(KERNEL_ftz(KERNEL_ftz(KERNEL_ftz(p[0] + p[1]) + KERNEL_ftz(p[2] + p[3])) +
+                                 KERNEL_ftz(KERNEL_ftz(p[4] + p[5]) + KERNEL_ftz(p[6] + p[7]))) +
+                      KERNEL_ftz(KERNEL_ftz(KERNEL_ftz(p[8] + 0.0f) + 0.0f) + bias));
+}
+
+void KERNEL_conv3x3_engine(const float *const *inputs, u32 in_channels, u32 in_width,
+                           float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                           const u32 *words, const u16 *slots, const float *alpha){
+    float kernel[9];
+    float bias;
+
+    for(u32 out = 0; out < out_channels; out++){
+        for(u32 y = 0; y < out_height; y++){
+            float *row = outputs[out] + (y * out_width);
+
+            for(u32 x = 0; x < out_width; x++){
+                row[x] = 0.0f;
+            }
+
+            for(u32 slot = 0; slot < in_channels; slot++){
+                const u32   *word   = words + (((out * in_channels) + slot) * KERNEL_ENGINE_WORDS);
+                const float *window;
+                u32 x = 0;
+
+                if(slots[(out * in_channels) + slot] >= in_channels){
+                    continue;
+                }
+                window = inputs[slots[(out * in_channels) + slot]] + (y * in_width);
+                memcpy(&bias, &word[0], sizeof(bias));
+                memcpy(kernel, &word[1], sizeof(kernel));
+                bias = KERNEL_ftz(bias);
+                for(u32 tap = 0; tap < 9; tap++){
+                    kernel[tap] = KERNEL_ftz(kernel[tap]);
+                }
+
+#ifdef KERNEL_USE_NEON_FTZ
+                // the tree for 4 pixels at once, the running sum stays scalar like CHANNEL_post_process
+                for(; x + 4 <= out_width; x += 4){
+                    float32x4_t zero = vdupq_n_f32(0.0f);
+                    float32x4_t p[9];
+                    float       cell[4];
+
+                    for(u32 tap = 0; tap < 9; tap++){
+                        p[tap] = vmulq_n_f32(vld1q_f32(window + ((tap / 3) * in_width) + (tap % 3) + x), kernel[tap]);
+                    }
+                    p[0] = vaddq_f32(vaddq_f32(vaddq_f32(p[0], p[1]), vaddq_f32(p[2], p[3])),
+                                     vaddq_f32(vaddq_f32(p[4], p[5]), vaddq_f32(p[6], p[7])));
+                    p[8] = vaddq_f32(vaddq_f32(vaddq_f32(p[8], zero), zero), vdupq_n_f32(bias));
+                    vst1q_f32(cell, vaddq_f32(p[0], p[8]));
+                    for(u32 i = 0; i < 4; i++){
+                        row[x + i] += cell[i];
+                    }
+                }
+#endif
+                for(; x < out_width; x++){
+                    row[x] += KERNEL_engine_cell(window + x, in_width, kernel, bias);
+                }
+            }
+
+            if(alpha != NULL){
+                for(u32 x = 0; x < out_width; x++){
+                    row[x] = KERNEL_prelu(row[x], alpha, out);
+                }
+            }
+        }
+    }
+}
+
+u32 KERNEL_winograd_scratch_size(u32 in_channels, u32 out_width){
+    return in_channels * ((out_width + 1) / 2) * KERNEL_WINOGRAD_TILE;
+}
+
+// V = B^T d B for one 4x4 input tile, samples outside the input read as zero
+static void KERNEL_winograd_input_tile(const float *input, u32 in_height, u32 in_width, u32 top, u32 left, float *v){
+    float d[4][4];
+    float t[4][4];
+
+    for(u32 m = 0; m < 4; m++){
+        for(u32 n = 0; n < 4; n++){
+            d[m][n] = (top + m < in_height && left + n < in_width) ? input[((top + m) * in_width) + left + n] : 0.0f;
+        }
+    }
+
+    for(u32 n = 0; n < 4; n++){
+        t[0][n] = d[0][n] - d[2][n];
+        t[1][n] = d[1][n] + d[2][n];
+        t[2][n] = d[2][n] - d[1][n];
+        t[3][n] = d[1][n] - d[3][n];
+    }
+    for(u32 m = 0; m < 4; m++){
+        v[(m * 4) + 0] = t[m][0] - t[m][2];
+        v[(m * 4) + 1] = t[m][1] + t[m][2];
+        v[(m * 4) + 2] = t[m][2] - t[m][1];
+        v[(m * 4) + 3] = t[m][1] - t[m][3];
+    }
+}
+
+void KERNEL_conv3x3_winograd(const float *const *inputs, u32 in_channels, u32 in_height, u32 in_width,
+                             float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                             const float *transformed, const float *bias, const float *alpha, float *scratch){
+    u32 tiles_x = (out_width  + 1) / 2;
+    u32 tiles_y = (out_height + 1) / 2;
+    float m[KERNEL_WINOGRAD_TILE];
+    float y[2][2];
+    float t[2][4];
+
+    for(u32 tile_y = 0; tile_y < tiles_y; tile_y++){
+        // transform one row of input tiles for every input channel, reused by all output channels
+        for(u32 in = 0; in < in_channels; in++){
+            for(u32 tile_x = 0; tile_x < tiles_x; tile_x++){
+                KERNEL_winograd_input_tile(inputs[in], in_height, in_width, tile_y * 2, tile_x * 2,
+                                           &scratch[((in * tiles_x) + tile_x) * KERNEL_WINOGRAD_TILE]);
+            }
+        }
+
+        for(u32 out = 0; out < out_channels; out++){
+            const float *u_out = transformed + (out * in_channels * KERNEL_WINOGRAD_TILE);
+
+            for(u32 tile_x = 0; tile_x < tiles_x; tile_x++){
+                const float *v = &scratch[tile_x * KERNEL_WINOGRAD_TILE];
+                const float *u = u_out;
+                u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+                float32x4_t acc[4] = {vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f)};
+                for(u32 in = 0; in < in_channels; in++){
+                    for(u32 q = 0; q < 4; q++){
+                        acc[q] = vmlaq_f32(acc[q], vld1q_f32(u + (q * 4)), vld1q_f32(v + (q * 4)));
+                    }
+                    u += KERNEL_WINOGRAD_TILE;
+                    v += tiles_x * KERNEL_WINOGRAD_TILE;
+                }
+                for(u32 q = 0; q < 4; q++){
+                    vst1q_f32(&m[q * 4], acc[q]);
+                }
+                i = KERNEL_WINOGRAD_TILE;
+#endif
+                for(; i < KERNEL_WINOGRAD_TILE; i++){
+                    m[i] = 0.0f;
+                    for(u32 in = 0; in < in_channels; in++){
+                        m[i] += u[(in * KERNEL_WINOGRAD_TILE) + i] * v[(in * tiles_x * KERNEL_WINOGRAD_TILE) + i];
+                    }
+                }
+
+                // Y = A^T M A
+                for(u32 n = 0; n < 4; n++){
+                    t[0][n] = m[n] + m[4 + n] + m[8 + n];
+                    t[1][n] = m[4 + n] - m[8 + n] - m[12 + n];
+                }
+                for(u32 r = 0; r < 2; r++){
+                    y[r][0] = t[r][0] + t[r][1] + t[r][2];
+                    y[r][1] = t[r][1] - t[r][2] - t[r][3];
+                }
+
+                for(u32 r = 0; r < 2; r++){
+                    u32 out_y = (tile_y * 2) + r;
+                    for(u32 c = 0; c < 2; c++){
+                        u32 out_x = (tile_x * 2) + c;
+                        if(out_y < out_height && out_x < out_width){
+                            outputs[out][(out_y * out_width) + out_x] = KERNEL_prelu(y[r][c] + bias[out], alpha, out);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void KERNEL_conv1x1(const float *const *inputs, u32 in_channels, u32 count,
+                    float *output, const float *weights, float bias){
+    for(u32 i = 0; i < count; i++){
+        output[i] = 0.0f;
+    }
+    for(u32 in = 0; in < in_channels; in++){
+        if(weights[in] == 0.0f){
+            continue;
+        }
+        for(u32 i = 0; i < count; i++){
+            output[i] += inputs[in][i] * weights[in];
+        }
+    }
+    for(u32 i = 0; i < count; i++){
+        output[i] += bias;
+    }
+}
+
+// round half away from zero and saturate, the NEON paths round the same way
+static inline s8 KERNEL_saturate_s8(float value){
+    if(value >= 127.0f){
+        return 127;
+    }
+    if(value <= -128.0f){
+        return -128;
+    }
+    return (s8)(s32)(value + ((value >= 0.0f) ? 0.5f : -0.5f));
+}
+
+#ifdef KERNEL_USE_NEON
+static inline int32x4_t KERNEL_round_s32(float32x4_t value){
+    uint32x4_t  positive = vcgeq_f32(value, vdupq_n_f32(0.0f));
+    float32x4_t half     = vbslq_f32(positive, vdupq_n_f32(0.5f), vdupq_n_f32(-0.5f));
+    return vcvtq_s32_f32(vaddq_f32(value, half));
+}
+
+static inline int8x8_t KERNEL_narrow_s8(int32x4_t low, int32x4_t high){
+    return vqmovn_s16(vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+}
+
+// acc * scale, PReLU, zero point, round and saturate for 8 pixels
+static inline int8x8_t KERNEL_requant_s8(int32x4_t acc_low, int32x4_t acc_high, float scale, const float *alpha, u32 channel, float zero_point){
+    float32x4_t low  = vmulq_n_f32(vcvtq_f32_s32(acc_low),  scale);
+    float32x4_t high = vmulq_n_f32(vcvtq_f32_s32(acc_high), scale);
+
+    if(alpha != NULL){
+        low  = vbslq_f32(vcgtq_f32(low,  vdupq_n_f32(0.0f)), low,  vmulq_n_f32(low,  alpha[channel]));
+        high = vbslq_f32(vcgtq_f32(high, vdupq_n_f32(0.0f)), high, vmulq_n_f32(high, alpha[channel]));
+    }
+    low  = vaddq_f32(low,  vdupq_n_f32(zero_point));
+    high = vaddq_f32(high, vdupq_n_f32(zero_point));
+    return KERNEL_narrow_s8(KERNEL_round_s32(low), KERNEL_round_s32(high));
+}
+#endif
+
+void KERNEL_quantize_s8(const float *input, s8 *output, u32 count, float inv_scale, s32 zero_point){
+    float zero = (float)zero_point;
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+    for(; i + 8 <= count; i += 8){
+        int32x4_t low  = KERNEL_round_s32(vaddq_f32(vmulq_n_f32(vld1q_f32(&input[i]),     inv_scale), vdupq_n_f32(zero)));
+        int32x4_t high = KERNEL_round_s32(vaddq_f32(vmulq_n_f32(vld1q_f32(&input[i + 4]), inv_scale), vdupq_n_f32(zero)));
+        vst1_s8(&output[i], KERNEL_narrow_s8(low, high));
+    }
+#endif
+    for(; i < count; i++){
+        output[i] = KERNEL_saturate_s8((input[i] * inv_scale) + zero);
+    }
+}
+
+void KERNEL_conv3x3_s8(const s8 *const *inputs, u32 in_channels, u32 in_width,
+                       s8 *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                       const s8 *weights, const s32 *bias, const float *requant, const float *alpha, s32 zero_point){
+    float zero = (float)zero_point;
+
+    for(u32 out = 0; out < out_channels; out++){
+        const s8 *kernel = weights + (out * in_channels * 9);
+
+        for(u32 y = 0; y < out_height; y++){
+            s8 *output = outputs[out] + (y * out_width);
+            u32 x = 0;
+
+#ifdef KERNEL_USE_NEON
+            // 8 pixels per step: s8 x s8 products widen to s16, then add into two s32 accumulators
+            for(; x + 8 <= out_width; x += 8){
+                int32x4_t acc_low  = vdupq_n_s32(bias[out]);
+                int32x4_t acc_high = acc_low;
+
+                for(u32 in = 0; in < in_channels; in++){
+                    const s8 *row    = inputs[in] + (y * in_width) + x;
+                    const s8 *weight = kernel + (in * 9);
+
+                    for(u32 m = 0; m < 3; m++){
+                        for(u32 n = 0; n < 3; n++){
+                            int16x8_t product = vmull_s8(vld1_s8(row + (m * in_width) + n), vdup_n_s8(weight[(m * 3) + n]));
+                            acc_low  = vaddw_s16(acc_low,  vget_low_s16(product));
+                            acc_high = vaddw_s16(acc_high, vget_high_s16(product));
+                        }
+                    }
+                }
+
+                vst1_s8(&output[x], KERNEL_requant_s8(acc_low, acc_high, requant[out], alpha, out, zero));
+            }
+#endif
+
+            for(; x < out_width; x++){
+                s32 acc = bias[out];
+                for(u32 in = 0; in < in_channels; in++){
+                    const s8 *row    = inputs[in] + (y * in_width) + x;
+                    const s8 *weight = kernel + (in * 9);
+                    for(u32 m = 0; m < 3; m++){
+                        for(u32 n = 0; n < 3; n++){
+                            acc += row[(m * in_width) + n] * weight[(m * 3) + n];
+                        }
+                    }
+                }
+                output[x] = KERNEL_saturate_s8(KERNEL_prelu((float)acc * requant[out], alpha, out) + zero);
+            }
+        }
+    }
+}
+
+void KERNEL_conv1x1_s8(const s8 *const *inputs, u32 in_channels, u32 count,
+                       float *const *outputs, u32 out_channels,
+                       const s8 *weights, const s32 *offset, const float *dequant, const float *bias){
+    for(u32 out = 0; out < out_channels; out++){
+        const s8 *weight = weights + (out * in_channels);
+        float    *output = outputs[out];
+        u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+        for(; i + 8 <= count; i += 8){
+            int32x4_t acc_low  = vdupq_n_s32(offset[out]);
+            int32x4_t acc_high = acc_low;
+
+            for(u32 in = 0; in < in_channels; in++){
+                int16x8_t product = vmull_s8(vld1_s8(inputs[in] + i), vdup_n_s8(weight[in]));
+                acc_low  = vaddw_s16(acc_low,  vget_low_s16(product));
+                acc_high = vaddw_s16(acc_high, vget_high_s16(product));
+            }
+
+            vst1q_f32(&output[i],     vaddq_f32(vmulq_n_f32(vcvtq_f32_s32(acc_low),  dequant[out]), vdupq_n_f32(bias[out])));
+            vst1q_f32(&output[i + 4], vaddq_f32(vmulq_n_f32(vcvtq_f32_s32(acc_high), dequant[out]), vdupq_n_f32(bias[out])));
+        }
+#endif
+        for(; i < count; i++){
+            s32 acc = offset[out];
+            for(u32 in = 0; in < in_channels; in++){
+                acc += inputs[in][i] * weight[in];
+            }
+            output[i] = ((float)acc * dequant[out]) + bias[out];
+        }
+    }
+}
+
+void KERNEL_maxpool_s8(const s8 *input, u32 in_height, u32 in_width,
+                       s8 *output, u32 out_height, u32 out_width, u32 pool_size, u32 stride){
+    u32 full_height = 0;
+    u32 full_width  = 0;
+
+#ifdef KERNEL_USE_NEON
+    if(pool_size == 2 && stride == 2){
+        full_height = KERNEL_maxpool_full_extent(in_height, out_height, pool_size, stride);
+        full_width  = KERNEL_maxpool_full_extent(in_width,  out_width,  pool_size, stride) & ~7u;
+
+        // 8 outputs from 16 columns of two rows
+        for(u32 y = 0; y < full_height; y++){
+            const s8 *row_0 = &input[(2 * y) * in_width];
+            const s8 *row_1 = row_0 + in_width;
+
+            for(u32 x = 0; x < full_width; x += 8){
+                int8x8x2_t top    = vld2_s8(&row_0[2 * x]);
+                int8x8x2_t bottom = vld2_s8(&row_1[2 * x]);
+                vst1_s8(&output[(y * out_width) + x], vmax_s8(vmax_s8(top.val[0], top.val[1]), vmax_s8(bottom.val[0], bottom.val[1])));
+            }
+        }
+    }
+#endif
+
+    // clamped windows for everything the NEON loop left
+    for(u32 y = 0; y < out_height; y++){
+        u32 start_y = y * stride;
+        u32 end_y   = min(start_y + pool_size, in_height);
+
+        for(u32 x = (y < full_height) ? full_width : 0; x < out_width; x++){
+            u32 start_x = x * stride;
+            u32 end_x   = min(start_x + pool_size, in_width);
+            s8  max_value = -128;
+
+            for(u32 iy = start_y; iy < end_y; iy++){
+                for(u32 ix = start_x; ix < end_x; ix++){
+                    if(input[(iy * in_width) + ix] > max_value){
+                        max_value = input[(iy * in_width) + ix];
+                    }
+                }
+            }
+            output[(y * out_width) + x] = max_value;
+        }
+    }
+}
+
+static inline u16 KERNEL_half(float value){
+    Kernel_Float_Bits bits;
+    u32 sign;
+    u32 magnitude;
+    u32 mantissa;
+    u32 shift;
+    u32 half;
+    u32 rest;
+
+    bits.f    = value;
+    sign      = ((u32)bits.i >> 16) & 0x8000;
+    magnitude = (u32)bits.i & 0x7FFFFFFF;
+
+    if(magnitude > 0x7F800000){
+        return sign | 0x7E00;                   // NaN
+    }
+    if(magnitude >= 0x47800000){
+        return sign | 0x7C00;                   // >= 65536 (or inf), 65520 and up round to inf below
+    }
+    if(magnitude < 0x33000000){
+        return sign;                            // below half of the smallest denormal
+    }
+
+    if(magnitude < 0x38800000){
+        // denormal, units of 2^-24
+        mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        shift    = 126 - (magnitude >> 23);
+        half     = mantissa >> shift;
+        rest     = mantissa & ((1u << shift) - 1);
+        if(rest > (1u << (shift - 1)) || (rest == (1u << (shift - 1)) && (half & 1))){
+            half++;
+        }
+        return sign | half;
+    }
+
+    // rebias the exponent, a carry out of the mantissa bumps the exponent
+    half = (magnitude - 0x38000000) >> 13;
+    rest = magnitude & 0x1FFF;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))){
+        half++;
+    }
+    return sign | half;
+}
+
+static inline float KERNEL_float(u16 half){
+    Kernel_Float_Bits bits;
+    u32 sign     = (u32)(half & 0x8000) << 16;
+    u32 exponent = (half >> 10) & 0x1F;
+    u32 mantissa = half & 0x3FF;
+
+    if(exponent == 0x1F){
+        bits.i = (s32)(sign | 0x7F800000 | (mantissa << 13));
+    }
+    else if(exponent != 0){
+        bits.i = (s32)(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+    else if(mantissa == 0){
+        bits.i = (s32)sign;
+    }
+    else{
+        // denormal, normalize into a float exponent
+        exponent = 113;
+        while(!(mantissa & 0x400)){
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits.i = (s32)(sign | (exponent << 23) | ((mantissa & 0x3FF) << 13));
+    }
+    return bits.f;
+}
+
+void KERNEL_float_to_half(const float *input, u16 *output, u32 count){
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON_FP16
+    for(; i + 4 <= count; i += 4){
+        vst1_u16(&output[i], vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&input[i]))));
+    }
+#endif
+    for(; i < count; i++){
+        output[i] = KERNEL_half(input[i]);
+    }
+}
+
+void KERNEL_half_to_float(const u16 *input, float *output, u32 count){
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON_FP16
+    for(; i + 4 <= count; i += 4){
+        vst1q_f32(&output[i], vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(&input[i]))));
+    }
+#endif
+    for(; i < count; i++){
+        output[i] = KERNEL_float(input[i]);
+    }
+}
+
+u32 KERNEL_threshold_compact(const float *values, u32 count, float threshold, u32 *indices, u32 capacity){
+    u32 found = 0;
+    u32 i     = 0;
+
+#ifdef KERNEL_USE_NEON
+    static const u32 lane_bits[4] = {1, 2, 4, 8};
+    uint32x4_t  bits  = vld1q_u32(lane_bits);
+    float32x4_t limit = vdupq_n_f32(threshold);
+
+    for(; i + 4 <= count && found + 4 <= capacity; i += 4){
+        uint32x4_t hits = vandq_u32(vcgeq_f32(vld1q_f32(&values[i]), limit), bits);
+        uint32x2_t sum  = vpadd_u32(vget_low_u32(hits), vget_high_u32(hits));
+        u32        mask = vget_lane_u32(vpadd_u32(sum, sum), 0);
+
+        // scores are mostly below the threshold, most blocks end here
+        for(u32 lane = 0; mask != 0; lane++, mask >>= 1){
+            if(mask & 1){
+                indices[found++] = i + lane;
+            }
+        }
+    }
+#endif
+    for(; i < count && found < capacity; i++){
+        if(values[i] >= threshold){
+            indices[found++] = i;
+        }
+    }
+
+    return found;
+}
+
+// corners are never negative, so half away from zero is a truncation of value + 0.5
+static inline float KERNEL_round_corner(float value){
+    return (float)(s32)(value + 0.5f);
+}
+
+void KERNEL_bbox_decode(float *x1, float *y1, float *x2, float *y2, u32 count, float stride, float cell_size, float scale){
+    float inv_scale = 1.0f / scale;
+    float near      = 1.0f * inv_scale;
+    float far       = cell_size * inv_scale;
+    float step      = stride * inv_scale;
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+    float32x4_t half = vdupq_n_f32(0.5f);
+
+    for(; i + 4 <= count; i += 4){
+        float32x4_t x = vmulq_n_f32(vld1q_f32(&x1[i]), step);
+        float32x4_t y = vmulq_n_f32(vld1q_f32(&y1[i]), step);
+
+        vst1q_f32(&x1[i], vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(vaddq_f32(x, vdupq_n_f32(near)), half))));
+        vst1q_f32(&y1[i], vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(vaddq_f32(y, vdupq_n_f32(near)), half))));
+        vst1q_f32(&x2[i], vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(vaddq_f32(x, vdupq_n_f32(far)), half))));
+        vst1q_f32(&y2[i], vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(vaddq_f32(y, vdupq_n_f32(far)), half))));
+    }
+#endif
+    for(; i < count; i++){
+        float x = x1[i] * step;
+        float y = y1[i] * step;
+
+        x1[i] = KERNEL_round_corner(x + near);
+        y1[i] = KERNEL_round_corner(y + near);
+        x2[i] = KERNEL_round_corner(x + far);
+        y2[i] = KERNEL_round_corner(y + far);
+    }
+}
+
+static inline int KERNEL_iou_over(float x1, float y1, float x2, float y2, float area,
+                                  float box_x1, float box_y1, float box_x2, float box_y2, float box_area, float threshold){
+    float width  = KERNEL_max(KERNEL_min(x2, box_x2) - KERNEL_max(x1, box_x1), 0.0f);
+    float height = KERNEL_max(KERNEL_min(y2, box_y2) - KERNEL_max(y1, box_y1), 0.0f);
+    float inter  = width * height;
+
+    return inter > (threshold * ((area + box_area) - inter));
+}
+
+u32 KERNEL_iou_first_over(float x1, float y1, float x2, float y2,
+                          const float *box_x1, const float *box_y1, const float *box_x2, const float *box_y2,
+                          const float *box_area, u32 count, float threshold){
+    float area = (x2 - x1) * (y2 - y1);
+    u32 i = 0;
+
+#ifdef KERNEL_USE_NEON
+    float32x4_t zero = vdupq_n_f32(0.0f);
+
+    for(; i + 4 <= count; i += 4){
+        float32x4_t width  = vsubq_f32(vminq_f32(vdupq_n_f32(x2), vld1q_f32(&box_x2[i])), vmaxq_f32(vdupq_n_f32(x1), vld1q_f32(&box_x1[i])));
+        float32x4_t height = vsubq_f32(vminq_f32(vdupq_n_f32(y2), vld1q_f32(&box_y2[i])), vmaxq_f32(vdupq_n_f32(y1), vld1q_f32(&box_y1[i])));
+        float32x4_t inter  = vmulq_f32(vmaxq_f32(width, zero), vmaxq_f32(height, zero));
+        float32x4_t uni    = vsubq_f32(vaddq_f32(vdupq_n_f32(area), vld1q_f32(&box_area[i])), inter);
+        uint32x4_t  over   = vcgtq_f32(inter, vmulq_n_f32(uni, threshold));
+        uint32x2_t  any    = vorr_u32(vget_low_u32(over), vget_high_u32(over));
+
+        if((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) != 0){
+            break;
+        }
+    }
+#endif
+    // the rest, and the lanes of the block that hit
+    for(; i < count; i++){
+        if(KERNEL_iou_over(x1, y1, x2, y2, area, box_x1[i], box_y1[i], box_x2[i], box_y2[i], box_area[i], threshold)){
+            return i;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,192 @@
+
+#ifndef NET_ENGINE_KERNELS_H
+#define NET_ENGINE_KERNELS_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define KERNEL_USE_NEON
+#include <arm_neon.h>
+#endif
+
+// half precision vector conversions need the fp16 extension (-mfpu=neon-fp16 -mfp16-format=ieee)
+#if defined(KERNEL_USE_NEON) && defined(__ARM_FP16_FORMAT_IEEE)
+#define KERNEL_USE_NEON_FP16
+#endif
+
+// ARMv7 Advanced SIMD always flushes denormals to zero, like the Net Engine's float operators
+#if defined(KERNEL_USE_NEON) && !defined(__aarch64__)
+#define KERNEL_USE_NEON_FTZ
+#endif
+
+/**************************** Type Definitions *****************************/
+#define KERNEL_CONV_LANES       4       // output channels per direct conv weight panel
+#define KERNEL_WINOGRAD_TILE    16      // F(2x2, 3x3) transformed 4x4 tile
+#define KERNEL_ENGINE_WORDS     10      // Bias, Kernal_1..9 per kernel, as PREPACK_ENGINE_WORDS
+
+typedef enum{
+    MAXPOOL_KERNEL_2X2_S2,
+    MAXPOOL_KERNEL_3X3_S2,
+    MAXPOOL_KERNEL_GENERIC,
+} MAXPOOL_KERNEL;
+
+typedef enum{
+    KERNEL_EXP_ACCURATE,    // relative error < 3e-7 (about 2 ulp)
+    KERNEL_EXP_FAST,        // relative error < 2e-5, two fewer multiply-adds
+} KERNEL_EXP_MODE;
+
+/************************** Function Prototypes ****************************/
+
+MAXPOOL_KERNEL KERNEL_maxpool_select(u32 pool_size, u32 stride);
+
+/**
+ * Max pooling over a single plane. Output pixels whose window lies fully
+ * inside the input go through the specialized (NEON when available) loop,
+ * the ragged right/bottom edges are finished with a clamped window.
+ */
+void KERNEL_maxpool(MAXPOOL_KERNEL kernel, const float *input, u32 in_height, u32 in_width,
+                    float *output, u32 out_height, u32 out_width, u32 pool_size, u32 stride);
+
+/**
+ * Polynomial exp approximation with range reduction to [-ln2/2, ln2/2].
+ * Inputs are clamped to the finite float range, so the result never
+ * overflows to inf or underflows to a denormal.
+ */
+float KERNEL_expf(float x, KERNEL_EXP_MODE mode);
+
+void KERNEL_exp(const float *input, float *output, u32 count, KERNEL_EXP_MODE mode);
+
+/**
+ * Softmax over two class planes of count pixels each, in place.
+ * Uses p0 = 1 / (1 + exp(x1 - x0)), p1 = exp(x1 - x0) * p0, one exp per pixel.
+ */
+void KERNEL_softmax_2(float *class_0, float *class_1, u32 count, KERNEL_EXP_MODE mode);
+
+/**
+ * Softmax across class_count planes of count pixels each, in place.
+ */
+void KERNEL_softmax(float **classes, u32 class_count, u32 count, KERNEL_EXP_MODE mode);
+
+/**
+ * Valid 3x3 convolution (stride 1) of in_channels planes into out_channels
+ * planes with bias and optional PReLU (alpha NULL for none). panels holds the
+ * weights as [out / KERNEL_CONV_LANES][in][9 taps][KERNEL_CONV_LANES]; the
+ * NEON path computes four output channels by four pixels per step.
+ */
+void KERNEL_conv3x3_direct(const float *const *inputs, u32 in_channels, u32 in_width,
+                           float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                           const float *panels, const float *bias, const float *alpha);
+
+/**
+ * Same convolution with only the nonzero taps: output channel o sums
+ * weights[i] * tap taps[i] (in * 9 + row * 3 + column) for i in
+ * [starts[o], starts[o + 1]), in the order the direct kernel adds them.
+ * Pruned kernels and zero taps cost nothing, a dense layer is slower than
+ * the direct kernel.
+ */
+void KERNEL_conv3x3_sparse(const float *const *inputs, u32 in_width,
+                           float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                           const u32 *starts, const u16 *taps, const float *weights, const float *bias, const float *alpha);
+
+/**
+ * Same convolution bit exact with the Net Engine: every kernel goes through
+ * conv_cell's adder tree, ((p1 + p2) + (p3 + p4)) + ((p5 + p6) + (p7 + p8))
+ * plus ((p9 + 0) + 0 + bias), with denormals flushed to zero, and the
+ * kernels are added to the zeroed output one after the other in engine word
+ * order before PReLU, as CHANNEL_CNN_process does. words holds the engine
+ * words as [out][in_channels][Bias, Kernal_1..9], slots[out][slot] the input
+ * channel of each word slot (in_channels or more for an unused slot).
+ */
+void KERNEL_conv3x3_engine(const float *const *inputs, u32 in_channels, u32 in_width,
+                           float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                           const u32 *words, const u16 *slots, const float *alpha);
+
+u32 KERNEL_winograd_scratch_size(u32 in_channels, u32 out_width);
+
+/**
+ * Same convolution via Winograd F(2x2, 3x3): 16 multiplies per 2x2 output
+ * tile and input channel instead of 36. transformed holds U = G g G^T as
+ * [out][in][16]; scratch needs KERNEL_winograd_scratch_size floats.
+ */
+void KERNEL_conv3x3_winograd(const float *const *inputs, u32 in_channels, u32 in_height, u32 in_width,
+                             float *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                             const float *transformed, const float *bias, const float *alpha, float *scratch);
+
+/**
+ * One output channel of a 1x1 convolution over count pixels, in the
+ * summation order of LAYER_CNN_1x1_process: input by input, zero weights
+ * skipped, bias added last.
+ */
+void KERNEL_conv1x1(const float *const *inputs, u32 in_channels, u32 count,
+                    float *output, const float *weights, float bias);
+
+/**
+ * int8 quantization, q = round(x * inv_scale + zero_point) saturated to
+ * [-128, 127]. Rounding is half away from zero in every int8 kernel.
+ */
+void KERNEL_quantize_s8(const float *input, s8 *output, u32 count, float inv_scale, s32 zero_point);
+
+/**
+ * Valid 3x3 convolution of int8 planes. weights holds [out][in][9 taps],
+ * bias is in accumulator units with the input zero point folded in.
+ * Products are summed in int32, then the epilogue scales by requant[out],
+ * applies PReLU (alpha NULL for none), adds the output zero point and rounds
+ * back to int8. The A9 has no int8 dot product, the NEON path widens 8
+ * products to int16 per multiply and adds them into int32 lanes.
+ */
+void KERNEL_conv3x3_s8(const s8 *const *inputs, u32 in_channels, u32 in_width,
+                       s8 *const *outputs, u32 out_channels, u32 out_height, u32 out_width,
+                       const s8 *weights, const s32 *bias, const float *requant, const float *alpha, s32 zero_point);
+
+/**
+ * 1x1 convolution of int8 planes of count pixels into float planes,
+ * output = (offset[out] + acc) * dequant[out] + bias[out], offset carries
+ * the input zero point. weights holds [out][in].
+ */
+void KERNEL_conv1x1_s8(const s8 *const *inputs, u32 in_channels, u32 count,
+                       float *const *outputs, u32 out_channels,
+                       const s8 *weights, const s32 *offset, const float *dequant, const float *bias);
+
+/**
+ * Max pooling over a single int8 plane, the scale carries over unchanged.
+ */
+void KERNEL_maxpool_s8(const s8 *input, u32 in_height, u32 in_width,
+                       s8 *output, u32 out_height, u32 out_width, u32 pool_size, u32 stride);
+
+/**
+ * IEEE half precision storage: float to half rounds to nearest even,
+ * overflow gives inf; half to float is exact. The NEON fp16 path may flush
+ * half denormals (|x| < 6.1e-5) to zero.
+ */
+void KERNEL_float_to_half(const float *input, u16 *output, u32 count);
+
+void KERNEL_half_to_float(const u16 *input, float *output, u32 count);
+
+/**
+ * Writes the index of every value >= threshold, in order, to indices and
+ * returns how many there were, at most capacity. The NEON path compares
+ * four scores at once and only looks at the lanes of blocks with a hit.
+ */
+u32 KERNEL_threshold_compact(const float *values, u32 count, float threshold, u32 *indices, u32 capacity);
+
+/**
+ * Turns cell coordinates into image corners in place: on entry x and y
+ * hold each box's cell column and row, on return x1 = round((stride * x + 1)
+ * / scale), x2 = round((stride * x + cell_size) / scale), y likewise.
+ * Rounding is half away from zero, the division a multiply by 1 / scale.
+ */
+void KERNEL_bbox_decode(float *x1, float *y1, float *x2, float *y2, u32 count, float stride, float cell_size, float scale);
+
+/**
+ * Index of the first of count boxes whose IoU with (x1, y1, x2, y2) is
+ * above threshold, count when there is none. IoU is tested as
+ * intersection > threshold * union, without a division; the NEON path
+ * tests four boxes per step and stops at the first step with a hit.
+ */
+u32 KERNEL_iou_first_over(float x1, float y1, float x2, float y2,
+                          const float *box_x1, const float *box_y1, const float *box_x2, const float *box_y2,
+                          const float *box_area, u32 count, float threshold);
+
+#endif // NET_ENGINE_KERNELS_H
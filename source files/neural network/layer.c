@@ -8,6 +8,13 @@
 #include <xil_printf.h>
 #include <math.h>
 #include "neural_network.h"
+#include "kernels.h"
+#include "execution_plan.h"
+#include "prepack.h"
+#include "trace.h"
+#include "tiling.h"
+#include "profiler.h"
+#include "backend.h"
 
 #define PROCESS_TIME_MEASURE
 
@@ -21,6 +28,7 @@
 
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
+
 Layer* LAYER_init(LAYER_TYPE type, LAYER_ACTIVATION activation, u32* memory_ptr, u32 memory_len){
     Layer *instance; 
 
@@ -47,6 +55,29 @@ Layer* LAYER_init(LAYER_TYPE type, LAYER_ACTIVATION activation, u32* memory_ptr,
     instance->memory.availale_mem_size  = memory_len;
     instance->memory.used_mem_size      = 0;
     instance->activation                = activation;
+    instance->source_index              = 0;
+    instance->plan                      = NULL;
+    instance->conv_backend              = CONV_BACKEND_NET_ENGINE;
+    instance->default_backend           = CONV_BACKEND_NET_ENGINE;
+    instance->packed                    = NULL;
+    instance->split.mode                = CONV_SPLIT_CHANNELS;
+    instance->split.cpu_share           = 0.0f;
+    instance->split.count               = 0;
+    instance->split.cpu_count           = 0;
+    instance->split.engine_ticks        = 0;
+    instance->split.cpu_ticks           = 0;
+    instance->batch.count               = 1;
+    instance->batch.in_stride           = 0;
+    instance->batch.out_stride          = 0;
+    instance->geometry.stride           = 1;
+    instance->geometry.padding          = 0;
+
+    switch (type) {
+        case LAYER_TYPE_CNN_1X1:    instance->geometry.kernal_size = 1; break;
+        case LAYER_TYPE_CNN_2X2:    instance->geometry.kernal_size = 2; break;
+        case LAYER_TYPE_CNN_3X3:    instance->geometry.kernal_size = 3; break;
+        case LAYER_TYPE_MAXPOOLING: instance->geometry.kernal_size = 2; break;
+    };
 
     switch (type) {
         case LAYER_TYPE_CNN_3X3:    instance->data.cnn_data.data     = NULL; break;
@@ -56,6 +87,34 @@ Layer* LAYER_init(LAYER_TYPE type, LAYER_ACTIVATION activation, u32* memory_ptr,
     return instance;
 }
 
+static void free_channel_nodes(Channel_Node *channel){
+    Channel_Node *next_channel;
+    Channel_Kernal_Data_Node *kernal;
+    Channel_Kernal_Data_Node *next_kernal;
+
+    while(channel != NULL){
+        next_channel = (Channel_Node*)channel->next;
+        for(kernal = channel->data.cnn_data.kernal_node; kernal != NULL; kernal = next_kernal){
+            next_kernal = (Channel_Kernal_Data_Node*)kernal->next;
+            free(kernal);
+        }
+        free(channel->data.cnn_1x1_data.data);
+        free(channel);
+        channel = next_channel;
+    }
+}
+
+void LAYER_free(Layer *instance){
+    if(instance == NULL){
+        return;
+    }
+
+    free_channel_nodes(instance->input_channels.channels);
+    free_channel_nodes(instance->output_channels.channels);
+    PREPACK_free(instance->packed);
+    free(instance);
+}
+
 static Channel_Node* create_channel_node(Channel data){
     Channel_Node* new = (Channel_Node*)malloc(sizeof(Channel_Node));
     if(new == NULL){
@@ -115,6 +174,10 @@ int LAYER_add_maxpool_output_channels(Layer **instance, u32 pool_size, u32 strid
         return -1; // Invalid arguments
     }
 
+    (*instance)->geometry.kernal_size = pool_size;
+    (*instance)->geometry.stride      = stride;
+    (*instance)->geometry.padding     = padding;
+
     for(int chan = 0; chan < channel_count; chan++){
         channel = CHANNEL_init(CHANNEL_TYPE_OUTPUT, height, width, NULL);
         if(channel == NULL){
@@ -142,6 +205,8 @@ int LAYER_add_maxpool_output_channels(Layer **instance, u32 pool_size, u32 strid
         }
         (*instance)->output_channels.count++;
     }
+
+    return 0;
 }
 
 int LAYER_add_cnn_1x1_output_channels(Layer **instance, void *weights, void *bias, int weights_count, int channel_count, u32 height, u32 width){
@@ -194,6 +259,8 @@ int LAYER_add_cnn_1x1_output_channels(Layer **instance, void *weights, void *bia
         }
         (*instance)->output_channels.count++;
     }
+
+    return 0;
 }
 
 int LAYER_add_cnn_output_channels(Layer **instance, void* ptr, void* ptr_activation, int channel_count, u32 height, u32 width){
@@ -250,6 +317,8 @@ int LAYER_add_cnn_output_channels(Layer **instance, void* ptr, void* ptr_activat
         }
         (*instance)->output_channels.count++;
     }
+
+    return 0;
 }
 
 int LAYER_link(Layer *input_layer, Layer *output_layer){
@@ -332,12 +401,8 @@ int LAYER_MAXPOOLING_process(Layer *instance){
     u32 out_width  = 0;
     u32 stride = 0;
     u32 size   = 0;
-    u32 y_out  = 0;
-    u32 x_out  = 0;
-    u32 start_x = 0;
-    u32 start_y = 0;
 
-    float max_value = 0.0;
+    MAXPOOL_KERNEL kernel;
 
     Channel_Node *input_channel  = instance->input_channels.channels;
     Channel_Node *output_channel = instance->output_channels.channels;
@@ -353,40 +418,18 @@ int LAYER_MAXPOOLING_process(Layer *instance){
     stride = output_channel->data.data.mx_data.stride;
     size   = output_channel->data.data.mx_data.pool_size;
 
-    while(input_channel != NULL){
-        for (int Index = 0; Index < output_channel->data.total_bytes; Index++) {
-            output_channel->data.output_ptr[Index] = -FLT_MAX;
-        }
-
-        for(y_out = 0; y_out < out_height; y_out++){
-            for(x_out = 0; x_out < out_width; x_out++){
-                max_value = -1e10;
-                max_value = -FLT_MAX;
-                
-                start_y = y_out * stride;
-                start_x = x_out * stride;
-
-                // Iterate over the pooling window
-                for (u32 ky = 0; ky < size; ky++) {
-                    for (u32 kx = 0; kx < size; kx++) {
-                        u32 iy = start_y + ky;
-                        u32 ix = start_x + kx;
-                        
-                        // Check bounds
-                        if (iy < in_height && ix < in_width) {
-                            float value = *(float*)&input_channel->data.output_ptr[iy * in_width + ix];
-                            if (value > max_value) {
-                                max_value = value;
-                            }
-                        }
-                    }
-                }
-                
-                // Assign the maximum value to the output feature map
-                output_channel->data.output_ptr[y_out * out_width + x_out] = *(u32*)&max_value;
-            }
-        }
+    if(instance->plan != NULL){
+        kernel = instance->plan->maxpool_kernel;
+    }
+    else{
+        kernel = KERNEL_maxpool_select(size, stride);
+    }
 
+    while(input_channel != NULL && output_channel != NULL){
+        KERNEL_maxpool(kernel,
+            (const float*)input_channel->data.output_ptr, in_height, in_width,
+            (float*)output_channel->data.output_ptr, out_height, out_width,
+            size, stride);
 
         // for (int Index = 0; Index < 10; Index++) {
         //     printf("\t %d maxp %f \\r\n", Index, *(float*)&output_channel->data.output_ptr[Index]);
@@ -396,8 +439,6 @@ int LAYER_MAXPOOLING_process(Layer *instance){
         output_channel = (Channel_Node *)output_channel->next;
     }
 
-
-
     return 0;
 }
 
@@ -530,40 +571,33 @@ int LAYER_MAXPOOLING_process(Layer *instance){
 // }
 
 static int LAYER_activate_softmax(Layer *layer){
+    float *classes[LAYER_SOFTMAX_MAX_CLASSES];
+    u32   class_count = 0;
 
-    Channel_Node* first_chan  = (Channel_Node*)layer->output_channels.channels;
-    Channel_Node* second_chan = (Channel_Node*)first_chan->next;
-
-    int height = first_chan->data.height;
-    int width  = first_chan->data.width;
+    Channel_Node* chan_node = (Channel_Node*)layer->output_channels.channels;
 
-    float x1, x2, exp_x1, exp_x2, sum_exp, max_val;
-
-    float *f_data_ptr, *s_data_ptr;
+    if(chan_node == NULL){
+        return -1;
+    }
 
-    f_data_ptr = (float*)first_chan->data.output_ptr;
-    s_data_ptr = (float*)second_chan->data.output_ptr;
+    // each output channel is one class plane of height * width pixels
+    while(chan_node != NULL && class_count < LAYER_SOFTMAX_MAX_CLASSES){
+        classes[class_count++] = (float*)chan_node->data.output_ptr;
+        chan_node = (Channel_Node*)chan_node->next;
+    }
 
-    // Iterate over each position in the spatial dimensions
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            // Get the input values for the current position
-            x1 = f_data_ptr[(i*height)+j];
-            x2 = s_data_ptr[(i*height)+j];
+    // normalizing over only some of the classes would give wrong probabilities
+    if(chan_node != NULL){
+        xil_printf("Softmax: layer %d has more than %d classes \r\n", layer->index, LAYER_SOFTMAX_MAX_CLASSES);
+        return -1;
+    }
 
-            // Compute max value for numerical stability
-            max_val = fmaxf(x1, x2);
+    chan_node = (Channel_Node*)layer->output_channels.channels;
 
-            // Compute exponentials and sum
-            exp_x1  = expf(x1 - max_val);
-            exp_x2  = expf(x2 - max_val);
-            sum_exp = exp_x1 + exp_x2;
+    KERNEL_softmax(classes, class_count, chan_node->data.height * chan_node->data.width,
+        (layer->plan != NULL) ? layer->plan->exp_mode : LAYER_SOFTMAX_EXP_MODE);
 
-            // Normalize and store back
-            f_data_ptr[(i*height)+j] = exp_x1 / sum_exp;
-            s_data_ptr[(i*height)+j] = exp_x2 / sum_exp;
-        }
-    }
+    return 0;
 }
 
 // void softmax(float *channel, int height, int width, int channels) {
@@ -636,6 +670,12 @@ static int LAYER_CNN_1x1_process(Layer *instance){
 
         while (input_channel != NULL) {
             weight = *(float*)&data_ptr->kernal_data[input_position];
+            // pruned inputs add nothing
+            if(weight == 0.0f){
+                input_position++;
+                input_channel = (Channel_Node*)input_channel->next;
+                continue;
+            }
 
             input_ptr_f = (float*)input_channel->data.input_ptr;
             // printf("\tInput Channel %d - W(%f) (%f) \n ", input_channel->data.index, weight, data_ptr->bias);
@@ -658,14 +698,254 @@ static int LAYER_CNN_1x1_process(Layer *instance){
     }
 
     if(instance->activation == LAYER_ACTIVATION_SOFTMAX){
-        LAYER_activate_softmax(instance);
+        ret = LAYER_activate_softmax(instance);
+    }
+
+    return ret;
+}
+
+// whole layer on the CPU from the prepacked weights, every output plane in one pass
+static int LAYER_CNN_3x3_cpu_process(Layer *instance){
+    const Prepacked_Conv *packed = instance->packed;
+    const float *inputs[LAYER_MAX_CONV_CHANNELS];
+    float       *outputs[LAYER_MAX_CONV_CHANNELS];
+    Channel_Node *input_channel  = instance->input_channels.channels;
+    Channel_Node *output_channel = instance->output_channels.channels;
+    const Conv_Backend_Entry *entry;
+    Backend_Conv_Band *band_kernel;
+    u32 in_height;
+    u32 in_width;
+    u32 out_height;
+    u32 out_width;
+    u32 band;
+    u32 rows;
+
+    if(packed->in_channels > LAYER_MAX_CONV_CHANNELS || packed->out_channels > LAYER_MAX_CONV_CHANNELS ||
+       input_channel == NULL || output_channel == NULL){
+        return -1;
+    }
+
+    in_height  = input_channel->data.height;
+    in_width   = input_channel->data.width;
+    out_height = output_channel->data.height;
+    out_width  = output_channel->data.width;
+
+    for(u32 in = 0; in < packed->in_channels && input_channel != NULL; in++){
+        inputs[in]    = (const float*)input_channel->data.input_ptr;
+        input_channel = (Channel_Node*)input_channel->next;
+    }
+    for(u32 out = 0; out < packed->out_channels && output_channel != NULL; out++){
+        outputs[out]   = (float*)output_channel->data.output_ptr;
+        output_channel->data.state = CHANNEL_STATE_COMPLETED;
+        output_channel = (Channel_Node*)output_channel->next;
+    }
+
+#ifdef PROCESS_TIME_MEASURE
+    measure_start(TIME_MEASURE_SIGNAL_2);
+#endif
+
+    TRACE_BEGIN("conv3x3 cpu", instance->index);
+    entry = BACKEND_get(instance->conv_backend);
+    if(entry->plane != NULL && entry->valid(instance)){
+        entry->plane(packed, inputs, in_height, in_width, outputs, out_height, out_width);
+    }
+    else{
+        // the per kernel path and planes too wide for a plane kernel fall back to the direct kernel
+        band_kernel = (entry->band != NULL) ? entry->band : BACKEND_get(CONV_BACKEND_CPU_DIRECT)->band;
+
+        // row bands whose input rows stay in cache while every weight panel sweeps them
+        band = TILING_conv_rows(packed->in_channels * in_width * sizeof(float), KERNEL_CONV_LANES * out_width * sizeof(float),
+                                out_height, 1);
+        for(u32 row = 0; row < out_height; row += rows){
+            rows = (band < out_height - row) ? band : out_height - row;
+            band_kernel(packed, inputs, in_width, outputs, rows, out_width);
+            for(u32 in = 0; in < packed->in_channels; in++){
+                inputs[in] += rows * in_width;
+            }
+            for(u32 out = 0; out < packed->out_channels; out++){
+                outputs[out] += rows * out_width;
+            }
+        }
+    }
+    TRACE_END("conv3x3 cpu");
+
+#ifdef PROCESS_TIME_MEASURE
+    measure_end(TIME_MEASURE_SIGNAL_2);
+#endif
+
+    return 0;
+}
+
+// moves the layer's channel pointers to a frame of the batch, negative frames move back
+static void LAYER_shift_frame(Layer *instance, int frame){
+    Channel_Node *channel;
+
+    for(channel = instance->input_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        // linked (maxpool) inputs are the producer's output nodes
+        if(instance->type == LAYER_TYPE_MAXPOOLING){
+            channel->data.output_ptr += frame * (int)instance->batch.in_stride;
+        }
+        else{
+            channel->data.input_ptr  += frame * (int)instance->batch.in_stride;
+        }
+    }
+    for(channel = instance->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        channel->data.output_ptr += frame * (int)instance->batch.out_stride;
+    }
+}
+
+// CPU layers run the whole layer for a frame before the next one, the
+// weights stay in cache across the batch
+static int LAYER_process_frames(Layer *instance, int (*process)(Layer *instance)){
+    int ret = 0;
+
+    for(u32 frame = 0; frame < instance->batch.count && ret == 0; frame++){
+        LAYER_shift_frame(instance, frame);
+        ret = process(instance);
+        LAYER_shift_frame(instance, -(int)frame);
+    }
+
+    return ret;
+}
+
+#ifdef USE_NET_ENGINE
+// CPU side of a split layer, handed out an output row of one channel at a time
+typedef struct{
+    const Prepacked_Conv *packed;
+    const float *inputs[LAYER_MAX_CONV_CHANNELS];
+    float       *outputs[LAYER_MAX_CONV_CHANNELS];
+    u32 in_width;
+    u32 out_width;
+    u32 out_height;
+    u32 first_channel;
+    u32 channel;
+    u32 row;
+    u64 done_at;
+    Net_Engine_Idle_cb *idle;           // whoever used the engine's idle time before
+    void               *idle_context;
+} Layer_Split_Work;
+
+// one unit of the CPU side, 0 once it is done
+static int LAYER_split_step(Layer_Split_Work *work){
+    const Prepacked_Conv *packed = work->packed;
+    const float *inputs[LAYER_MAX_CONV_CHANNELS];
+    float       *output;
+
+    if(work->row >= work->out_height){
+        return 0;
+    }
+
+    for(u32 in = 0; in < packed->in_channels; in++){
+        inputs[in] = work->inputs[in] + (work->row * work->in_width);
+    }
+    output = work->outputs[work->channel] + (work->row * work->out_width);
+    KERNEL_conv3x3_engine(inputs, packed->in_channels, work->in_width, &output, 1, 1, work->out_width,
+                          packed->engine + (work->channel * packed->in_channels * PREPACK_ENGINE_WORDS),
+                          packed->engine_inputs + (work->channel * packed->in_channels),
+                          (packed->alpha != NULL) ? packed->alpha + work->channel : NULL);
+
+    if(++work->channel == packed->out_channels){
+        work->channel = work->first_channel;
+        if(++work->row == work->out_height){
+            work->done_at = PROFILER_now();
+        }
+    }
+    return 1;
+}
+
+static void LAYER_split_idle(void *context){
+    Layer_Split_Work *work = (Layer_Split_Work*)context;
+
+    if(LAYER_split_step(work) == 0 && work->idle != NULL){
+        work->idle(work->idle_context);
+    }
+}
+
+// engine channels (or top rows) stream while the CPU computes the rest in the engine's idle time
+static int LAYER_CNN_3x3_split_process(Layer *instance, Net_Engine_Inst *net_engine){
+    const Layer_Plan *plan = instance->plan;
+    Layer_Split_Work  work;
+    Net_Engine_Transfer transfer;
+    Channel_Node *channel;
+    u32 engine_channels = instance->packed->out_channels;
+    u32 engine_rows     = plan->out_height;
+    u32 index;
+    u64 start;
+    int ret = 0;
+
+    instance->split.count     = (instance->split.mode == CONV_SPLIT_ROWS) ? plan->out_height : instance->packed->out_channels;
+    instance->split.cpu_count = (u32)((instance->split.cpu_share * instance->split.count) + 0.5f);
+    if(instance->split.cpu_count > instance->split.count){
+        instance->split.cpu_count = instance->split.count;
+    }
+    if(instance->split.mode == CONV_SPLIT_ROWS){
+        engine_rows -= instance->split.cpu_count;
+    }
+    else{
+        engine_channels -= instance->split.cpu_count;
+    }
+
+    work.packed        = instance->packed;
+    work.in_width      = plan->in_width;
+    work.out_width     = plan->out_width;
+    work.out_height    = plan->out_height;
+    work.first_channel = (instance->split.mode == CONV_SPLIT_ROWS) ? 0 : engine_channels;
+    work.channel       = work.first_channel;
+    work.row           = (instance->split.cpu_count == 0) ? plan->out_height :
+                         (instance->split.mode == CONV_SPLIT_ROWS) ? engine_rows : 0;
+    work.done_at       = 0;
+    work.idle          = net_engine->idle.cb;
+    work.idle_context  = net_engine->idle.context;
+
+    index = 0;
+    for(channel = instance->input_channels.channels; channel != NULL && index < work.packed->in_channels; channel = (Channel_Node*)channel->next){
+        work.inputs[index++] = (const float*)channel->data.input_ptr;
+    }
+    index = 0;
+    for(channel = instance->output_channels.channels; channel != NULL && index < work.packed->out_channels; channel = (Channel_Node*)channel->next){
+        work.outputs[index++] = (float*)channel->data.output_ptr;
+    }
+
+    start = PROFILER_now();
+    NET_ENGINE_set_idle(net_engine, LAYER_split_idle, &work);
+
+    // the engine only streams the rows it keeps
+    transfer = plan->transfer;
+    if(engine_rows != plan->out_height){
+        NET_ENGINE_transfer_init(&transfer, engine_rows, plan->out_width);
+    }
+    NET_ENGINE_set_transfer(net_engine, &transfer);
+    NET_ENGINE_cache_reset(net_engine);
+
+    index = 0;
+    for(channel = instance->output_channels.channels; channel != NULL && index < engine_channels && engine_rows != 0 && ret == 0;
+        channel = (Channel_Node*)channel->next, index++){
+        CHANNEL_update(&channel->data, engine_rows, plan->out_width);
+        TRACE_BEGIN("channel", channel->data.index);
+        ret = CHANNEL_CNN_process(&channel->data, net_engine, PREPACK_engine_words(instance->packed, channel->data.index), &instance->batch);
+        TRACE_END("channel");
+        CHANNEL_update(&channel->data, plan->out_height, plan->out_width);
+    }
+    instance->split.engine_ticks = PROFILER_now() - start;
+
+    NET_ENGINE_set_idle(net_engine, work.idle, work.idle_context);
+    TRACE_BEGIN("split cpu", instance->index);
+    while(LAYER_split_step(&work)){
+    }
+    TRACE_END("split cpu");
+    instance->split.cpu_ticks = (work.done_at != 0) ? work.done_at - start : 0;
+
+    for(channel = instance->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        channel->data.state = CHANNEL_STATE_COMPLETED;
     }
 
     return ret;
 }
+#endif
 
 static int LAYER_CNN_3x3_process(Layer *instance, Net_Engine_Inst *net_engine){
     int ret = 0;
+    const u32 *packed_words = NULL;
 
     Channel_Node* cur_channel = instance->output_channels.channels;
 
@@ -677,6 +957,30 @@ static int LAYER_CNN_3x3_process(Layer *instance, Net_Engine_Inst *net_engine){
 
     // printf("Layer process init %d \r\n", instance->index);
 
+    if(instance->packed != NULL && instance->conv_backend == CONV_BACKEND_SPLIT){
+#ifdef USE_NET_ENGINE
+        // a batch keeps the kernel loaded across frames, so it stays whole on the engine
+        if(instance->plan != NULL && instance->batch.count <= 1 && instance->packed->in_channels <= LAYER_MAX_CONV_CHANNELS &&
+           instance->packed->out_channels <= LAYER_MAX_CONV_CHANNELS){
+            return LAYER_CNN_3x3_split_process(instance, net_engine);
+        }
+#else
+        return LAYER_process_frames(instance, LAYER_CNN_3x3_cpu_process);
+#endif
+    }
+    else if(instance->packed != NULL && instance->conv_backend != CONV_BACKEND_NET_ENGINE){
+        return LAYER_process_frames(instance, LAYER_CNN_3x3_cpu_process);
+    }
+
+#ifdef USE_NET_ENGINE
+    // every kernel of the layer shares the same row length and DMA lengths
+    if(instance->plan != NULL){
+        NET_ENGINE_set_transfer(net_engine, &instance->plan->transfer);
+    }
+    // the input planes were written by the CPU since the last layer
+    NET_ENGINE_cache_reset(net_engine);
+#endif
+
     while (cur_channel != NULL){
         // xil_printf("\tChannel Process : I(%d) T(%d) H(%d) W(%d) OP(%p) TB(%d) MA(%d), MU(%d) \n", 
         //     cur_channel->data.index, 
@@ -697,7 +1001,12 @@ static int LAYER_CNN_3x3_process(Layer *instance, Net_Engine_Inst *net_engine){
     measure_start(TIME_MEASURE_SIGNAL_2);
 #endif
 
-        CHANNEL_CNN_process(&cur_channel->data, net_engine);
+        if(instance->packed != NULL){
+            packed_words = PREPACK_engine_words(instance->packed, cur_channel->data.index);
+        }
+        TRACE_BEGIN("channel", cur_channel->data.index);
+        CHANNEL_CNN_process(&cur_channel->data, net_engine, packed_words, &instance->batch);
+        TRACE_END("channel");
 
 #ifdef PROCESS_TIME_MEASURE
     measure_end(TIME_MEASURE_SIGNAL_2);
@@ -718,8 +1027,6 @@ static int LAYER_CNN_3x3_process(Layer *instance, Net_Engine_Inst *net_engine){
 
 
 int LAYER_process(Layer *instance, void *optional){
-    int ret = 0;
-
     xil_printf("Layer Process : I(%d) T(%d) H(%d) W(%d) MP(%p) MT(%p) MA(%d), MU(%d) \n", 
         instance->index, 
         instance->type, 
@@ -731,12 +1038,18 @@ int LAYER_process(Layer *instance, void *optional){
         instance->memory.used_mem_size
         );
 
+    return LAYER_run(instance, optional);
+}
+
+int LAYER_run(Layer *instance, void *optional){
+    int ret = 0;
+
     instance->state = LAYER_STATE_BUSY;
 
     switch(instance->type){
-        case LAYER_TYPE_CNN_1X1:          ret = LAYER_CNN_1x1_process(instance);                                break;
+        case LAYER_TYPE_CNN_1X1:          ret = LAYER_process_frames(instance, LAYER_CNN_1x1_process);          break;
         case LAYER_TYPE_CNN_3X3:          ret = LAYER_CNN_3x3_process(instance, (Net_Engine_Inst*)optional);    break;
-        case LAYER_TYPE_MAXPOOLING:       ret = LAYER_MAXPOOLING_process(instance);                             break;
+        case LAYER_TYPE_MAXPOOLING:       ret = LAYER_process_frames(instance, LAYER_MAXPOOLING_process);       break;
         case LAYER_TYPE_CNN_2X2:
             xil_printf("Not Implement %d \r\n", instance->index);
             break;
@@ -777,27 +1090,9 @@ int LAYER_update(Layer *input_layer, Layer *prev_layer, int height_, int width_)
         }
     }
 
-    switch(input_layer->type){
-        case LAYER_TYPE_CNN_1X1:
-        case LAYER_TYPE_CNN_2X2:
-            input_height  = height;
-            input_width   = width;
-            output_height = height;
-            output_width  = width;
-            break;
-        case LAYER_TYPE_CNN_3X3:
-            input_height  = height;
-            input_width   = width;
-            output_height = height - 2;
-            output_width  = output_height;
-            break;
-        case LAYER_TYPE_MAXPOOLING:
-            input_height  = height;
-            input_width   = width;
-            output_height = (((height-2) + 2)/2);
-            output_width  = output_height;
-            break;
-    }
+    input_height = height;
+    input_width  = width;
+    LAYER_output_shape(input_layer, input_height, input_width, (u32*)&output_height, (u32*)&output_width);
     
     // printf("input_height(%d), input_width(%d), output_height(%d), output_width(%d) \n", input_height, input_width, output_height, output_width);
 
@@ -823,4 +1118,22 @@ int LAYER_update(Layer *input_layer, Layer *prev_layer, int height_, int width_)
         // jumping to next channel
         output_channel = output_channel->next;
     }  
-}
\ No newline at end of file
+}
+
+// output size of a sliding window layer, (in + 2 * padding - kernal) / stride + 1
+int LAYER_output_shape(const Layer *instance, u32 in_height, u32 in_width, u32 *out_height, u32 *out_width){
+    u32 kernal  = instance->geometry.kernal_size;
+    u32 stride  = instance->geometry.stride;
+    u32 padding = instance->geometry.padding;
+
+    if((in_height + 2 * padding) < kernal || (in_width + 2 * padding) < kernal || stride == 0){
+        *out_height = 0;
+        *out_width  = 0;
+        return -1;
+    }
+
+    *out_height = ((in_height + 2 * padding - kernal) / stride) + 1;
+    *out_width  = ((in_width  + 2 * padding - kernal) / stride) + 1;
+
+    return 0;
+}
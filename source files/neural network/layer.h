@@ -10,6 +10,9 @@
 /**************************** Type Definitions *****************************/
 #define MAX_ROW_SIZE        100
 #define MAX_IMAGE_SIZE      100
+#define LAYER_MAX_CONV_CHANNELS     64      // CPU 3x3 backends keep a plane pointer per channel on the stack
+#define LAYER_SOFTMAX_MAX_CLASSES   8       // output channels a softmax layer may have
+#define LAYER_SOFTMAX_EXP_MODE      KERNEL_EXP_ACCURATE     // softmax exp when no plan says otherwise
 
 /************************** Function Prototypes ****************************/
 
@@ -26,6 +29,23 @@ typedef enum{
     LAYER_TYPE_MAXPOOLING,
 } LAYER_TYPE;
 
+// where a 3x3 layer runs, CPU backends need the layer prepacked
+typedef enum{
+    CONV_BACKEND_NET_ENGINE,        // per kernel path, scalar CPU when USE_NET_ENGINE is not defined
+    CONV_BACKEND_CPU_DIRECT,
+    CONV_BACKEND_CPU_WINOGRAD,
+    CONV_BACKEND_CPU_SPARSE,        // nonzero taps only, for pruned layers
+    CONV_BACKEND_CPU_ENGINE,        // Net Engine summation order, bit exact with CONV_BACKEND_NET_ENGINE
+    CONV_BACKEND_SPLIT,             // Net Engine and CPU_ENGINE side by side, see Layer.split
+    CONV_BACKEND_COUNT,
+} CONV_BACKEND;
+
+// how a CONV_BACKEND_SPLIT layer shares its work out
+typedef enum{
+    CONV_SPLIT_CHANNELS,            // the CPU takes the last output channels
+    CONV_SPLIT_ROWS,                // the CPU takes the bottom output rows of every channel
+} CONV_SPLIT;
+
 
 typedef struct Max_Pooling_Config_Data_{
     u8 index;
@@ -35,15 +55,36 @@ typedef struct Max_Pooling_Config_Data_{
 }Max_Pooling_Config_Data;
 
 typedef struct Layer_ Layer;
+struct Layer_Plan_;
+struct Prepacked_Conv_;
 typedef void *(Layer_Data_Post_Process)(Layer layer);
 typedef void *(Layer_Data_Pre_Process)(Layer layer);
 
 
 typedef struct Layer_{
     u8          index;
+    u8          source_index;
     LAYER_STATE state;
     LAYER_TYPE  type;
     LAYER_ACTIVATION activation;
+    struct {
+        u32 kernal_size;
+        u32 stride;
+        u32 padding;
+    } geometry;
+    const struct Layer_Plan_ *plan;
+    CONV_BACKEND              conv_backend;
+    CONV_BACKEND              default_backend;  // conv_backend under plans without an autotuned entry
+    struct Prepacked_Conv_   *packed;
+    struct {
+        CONV_SPLIT mode;
+        float      cpu_share;       // of the output channels or rows, the engine takes the rest
+        u32        count;           // last run: channels or rows, and how many the CPU took
+        u32        cpu_count;
+        u64        engine_ticks;    // last run: PROFILER_now ticks until each side was done
+        u64        cpu_ticks;
+    } split;
+    Channel_Batch             batch;
     struct {
         u32 *input;
         u32 *output;
@@ -105,8 +146,14 @@ typedef void *(Layer_init_cb)(Layer *layer, Layer prev_layer);
 
 Layer* LAYER_init(LAYER_TYPE type, LAYER_ACTIVATION activation, u32* memory_ptr, u32 memory_len);
 
+// frees a layer built on its own with LAYER_init, its channel lists and prepacked weights
+void LAYER_free(Layer *instance);
+
 int LAYER_process(Layer *instance, void *optional);
 
+// LAYER_process without its UART log line, for timing a layer on its own
+int LAYER_run(Layer *instance, void *optional);
+
 // int LAYER_CNN_load_data(CNN_Layer *instance, CNN_Config_Data data);
 
 // void LAYER_CNN_set_callbacks(CNN_Layer *instance, Layer_Data_Post_Process *post_process, Layer_Data_Pre_Process  *pre_process);
@@ -127,4 +174,6 @@ int LAYER_link(Layer *input_layer, Layer *output_layer);
 
 int LAYER_update(Layer *input_layer, Layer *prev_layer, int height, int width);
 
+int LAYER_output_shape(const Layer *instance, u32 in_height, u32 in_width, u32 *out_height, u32 *out_width);
+
 #endif // NET_ENGINE_LAYER_H
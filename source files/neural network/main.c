@@ -1,5 +1,7 @@
 
 #include <stdio.h>
+#include <math.h>
+#include <string.h>
 #include <xil_printf.h>
 #include <xil_types.h>
 #include "neural_network.h"
@@ -9,7 +11,24 @@
 #include "xscutimer.h"
 #include "utility.h"
 #include "time_measure.h"
+#include "profiler.h"
+#include "trace.h"
+#include "pyramid.h"
+#include "model.h"
+#include "validation.h"
+#include "benchmark.h"
+#include "scheduler.h"
+#include "fusion.h"
+#include "quantize.h"
+#include "half.h"
+#include "sparsity.h"
+#include "split.h"
+#include "backend.h"
+#include "detector.h"
 #include "sleep.h"
+#ifdef NET_ENGINE_COHERENT_BUFFERS
+#include "xil_mmu.h"
+#endif
 
 #ifndef DDR_BASE_ADDR
 #warning CHECK FOR THE VALID DDR ADDRESS IN XPARAMETERS.H, \
@@ -25,7 +44,7 @@ DEFAULT SET TO 0x01000000
 #define NN_INPUT_BLUE_CHANNEL     (NN_INPUT_GREEN_CHANNEL + 0xA000)
 
 #define NN_RECEIVE_MEM_BASE (MEM_BASE_ADDR + 0x00400000)
-#define NN_RECEIVE_MEM_LEN  (0xA000)
+#define NN_RECEIVE_MEM_LEN  (0xA000 * CHANNEL_TEMP_SLOTS)     // one 98x98 plane per temp slot
 #define NN_RECEIVE_MEM_HIGH (NN_RECEIVE_MEM_BASE + NN_RECEIVE_MEM_LEN)
 
 #define FIRST_CONV_LAYER_MEM_BASE (MEM_BASE_ADDR + 0x00500000)
@@ -45,6 +64,35 @@ DEFAULT SET TO 0x01000000
 #define NN_MEM_POOL_3_LEN         NN_MEM_POOL_1_LEN
 #define NN_MEM_POOL_3_HIGH        (NN_MEM_POOL_3_BASE + NN_MEM_POOL_3_LEN)
 
+// model image produced by model/convert_model.py, downloaded to DDR before the
+// application starts (e.g. xsct: dow -data p_net.bin <NN_MODEL_BASE>)
+#define NN_MODEL_BASE             (MEM_BASE_ADDR + 0x00700000)
+#define NN_MODEL_LEN              (0x00100000)
+
+#define NN_GOLDEN_BASE            (MEM_BASE_ADDR + 0x01000000)
+#define NN_GOLDEN_STRIDE          (0x00180000)
+#define NN_GOLDEN_LAYERS          6
+
+// batch validation frames, crops of the test sample NN_BATCH_STEP pixels apart
+#define NN_BATCH_SIZE             30
+#define NN_BATCH_STEP             20
+
+// input planes, temp slots and layer pools, mapped non-cacheable under
+// NET_ENGINE_COHERENT_BUFFERS (with the DMA on the ACP instead, leave them cached)
+#define NN_ARENA_BASE             (NN_INPUT_RED_CHANNEL)
+#define NN_ARENA_HIGH             (NN_MODEL_BASE)
+#define NN_MMU_SECTION            (0x00100000)
+
+// second input slot and the head slots of the scale scheduler
+#define NN_INPUT_SLOT_2_RED       (NN_INPUT_BLUE_CHANNEL  + NN_INPUT_SIZE)
+#define NN_INPUT_SLOT_2_GREEN     (NN_INPUT_SLOT_2_RED    + NN_INPUT_SIZE)
+#define NN_INPUT_SLOT_2_BLUE      (NN_INPUT_SLOT_2_GREEN  + NN_INPUT_SIZE)
+#define NN_HEAD_SLOT_BASE         (MEM_BASE_ADDR + 0x00340000)
+#define NN_HEAD_SLOT_LEN          (0x00060000)
+
+#define NN_BENCH_BASE             (MEM_BASE_ADDR + 0x00800000)
+#define NN_BENCH_LEN              (0x00800000)
+
 #define INPUT_SIZE  100
 #define OUTPUT_SIZE 98
 #define CNN_INPUT_SIZE_2  49
@@ -64,9 +112,209 @@ DEFAULT SET TO 0x01000000
 
 #define PROCESS_TIME_MEASURE
 
+// build the network from the model image at NN_MODEL_BASE instead of the compiled-in weights
+// #define USE_MODEL_FILE
+
+// compare every layer against the data/outpus reference dumps before the trials, on
+// target the dumps are downloaded to NN_GOLDEN_BASE + n * NN_GOLDEN_STRIDE
+// (e.g. xsct: dow -data layer_CNN_1_98X98.bin <NN_GOLDEN_BASE>)
+// #define RUN_VALIDATION
+
+// time every kernel and driver primitive on its own before the trials, rows
+// are printed as "bench,..." (BENCHMARK_FORMAT_JSON for one object per line)
+// #define RUN_BENCHMARK
+
+// run the CPU network depth first through row line buffers instead of layer by
+// layer (every 3x3 layer must be prepacked), only the head planes are written
+// #define USE_FUSED_EXECUTION
+#define NN_FUSION_LINE_LEN        (0x00020000)
+
+// overlap resizing the next scale and decoding the previous one with the
+// Net Engine running the current scale
+// #define USE_SCALE_SCHEDULER
+
+// run the CPU network in int8 (every 3x3 layer must be prepacked), activation
+// scales are calibrated on the pyramid levels of the test sample at start up.
+// The validation also checks them on the mirrored sample, which the calibration
+// never saw, ranges for deployment should still come from a separate set
+// #define USE_INT8_INFERENCE
+#define NN_QUANT_ARENA_LEN        (0x00040000)
+
+// keep weights and the activations between layers in half precision, compute
+// stays fp32 on row bands widened into scratch (every 3x3 layer must be prepacked)
+// #define USE_HALF_STORAGE
+#define NN_HALF_ARENA_LEN         (0x00080000)
+#define NN_HALF_SCRATCH_LEN       (0x00010000)
+
+// drop all zero 3x3 kernels (pruned offline with model/sparsity.py) from the
+// channels and run sparse enough CPU layers on their nonzero taps only
+// #define USE_SPARSE_KERNELS
+
+// share every 3x3 layer between the Net Engine and the CPU, sized at start up
+// from timings on the largest pyramid level so both sides finish together
+// #define USE_SPLIT_EXECUTION
+#define NN_SPLIT_MODE             CONV_SPLIT_CHANNELS
+#define NN_SPLIT_ROUNDS           4
+
+// time every valid 3x3 backend per layer on each pyramid level at start up
+// and keep the fastest in that level's execution plan
+// #define USE_BACKEND_AUTOTUNE
+#define NN_AUTOTUNE_ROUNDS        3
+
 
 Layer *layer_list[10] = {NULL};
 
+#ifdef USE_FUSED_EXECUTION
+static Fusion fusion;
+static u32    fusion_lines[NN_FUSION_LINE_LEN / sizeof(u32)];
+#endif
+
+#ifdef USE_INT8_INFERENCE
+static Quant_Network quant;
+static s8            quant_planes[NN_QUANT_ARENA_LEN];
+
+// the scales are printed so they can be compiled in instead
+static int init_int8(NeuralNetwork *network, Pyramid *pyramid, float *const frame[3], float *const input[3], const u32 *sizes, u32 count){
+    Quant_Calibration calibration;
+
+    QUANT_calibration_init(&calibration);
+    for(u32 level = 0; level < count; level++){
+        PYRAMID_build_level(pyramid, level, frame, input);
+        NEURAL_NETWORK_update(network, sizes[level], sizes[level]);
+        if(QUANT_calibrate(&calibration, network) != 0){
+            return -1;
+        }
+    }
+    QUANT_calibration_print(&calibration);
+
+    return QUANT_init(&quant, network, &calibration, quant_planes, NN_QUANT_ARENA_LEN);
+}
+#endif
+
+#ifdef USE_HALF_STORAGE
+static Half_Network half;
+static u16          half_planes[NN_HALF_ARENA_LEN / sizeof(u16)];
+static float        half_scratch[NN_HALF_SCRATCH_LEN / sizeof(float)];
+#endif
+
+#ifdef USE_SPARSE_KERNELS
+static Sparsity_Report sparsity;
+#endif
+
+#ifdef USE_SPLIT_EXECUTION
+static Split_Profile split_profile;
+#endif
+
+#ifdef USE_BACKEND_AUTOTUNE
+static Backend_Report backend_report;
+#endif
+
+// best boxes kept per pyramid level and per frame, NMS runs as each level is added
+#define NN_TOP_K                  128
+// NMS_MODE_GRID for crowded frames, both keep the same boxes
+#define NN_NMS_MODE               NMS_MODE_SORTED
+static u32      detector_memory[DETECTOR_MEMORY_SIZE(NN_TOP_K) / sizeof(u32)];
+
+#ifdef NET_ENGINE_COHERENT_BUFFERS
+static void map_arena_uncached(void){
+    for(UINTPTR section = NN_ARENA_BASE; section < NN_ARENA_HIGH; section += NN_MMU_SECTION){
+        Xil_SetTlbAttributes(section, NORM_NONCACHE);
+    }
+}
+#endif
+
+#ifdef USE_SCALE_SCHEDULER
+typedef struct Decode_Context_{
+    const float *scales;
+    Detector    *detector;
+} Decode_Context;
+
+static int decode_level(u32 level, const float *const heads[SCHEDULER_HEAD_PLANES], u32 height, u32 width, void *context){
+    Decode_Context *decode = (Decode_Context*)context;
+
+    DETECTOR_add_level(decode->detector, heads, height, width, decode->scales[level]);
+    return 0;
+}
+#endif
+
+#ifdef RUN_VALIDATION
+static void run_validation(NeuralNetwork *network, float *const frame[3], float *const input[3], float threshold){
+    const float *golden[NN_GOLDEN_LAYERS];
+
+    // the references were taken on the full size test sample
+    for(int plane = 0; plane < 3; plane++){
+        memcpy(input[plane], frame[plane], INPUT_SIZE * INPUT_SIZE * sizeof(float));
+    }
+
+#ifdef __linux__
+    if(VALIDATION_load_golden(golden, NN_GOLDEN_LAYERS, "data/outpus") != 0){
+        return;
+    }
+#else
+    for(int layer = 0; layer < NN_GOLDEN_LAYERS; layer++){
+        golden[layer] = (const float*)(NN_GOLDEN_BASE + (layer * NN_GOLDEN_STRIDE));
+    }
+#endif
+
+    if(VALIDATION_run_backends(network, INPUT_SIZE, INPUT_SIZE, golden, NN_GOLDEN_LAYERS) != 0){
+        xil_printf("Validation failed \r\n");
+    }
+#ifdef USE_NET_ENGINE
+    if(VALIDATION_run_exact(network, INPUT_SIZE, INPUT_SIZE) != 0){
+        xil_printf("Engine order validation failed \r\n");
+    }
+#endif
+#ifdef USE_FUSED_EXECUTION
+    if(VALIDATION_run_fused(&fusion, INPUT_SIZE, INPUT_SIZE, golden, NN_GOLDEN_LAYERS) != 0){
+        xil_printf("Fused validation failed \r\n");
+    }
+#endif
+#ifdef USE_INT8_INFERENCE
+    if(VALIDATION_run_quant(&quant, INPUT_SIZE, INPUT_SIZE, golden, NN_GOLDEN_LAYERS, threshold) != 0){
+        xil_printf("Int8 validation failed \r\n");
+    }
+#endif
+#ifdef USE_HALF_STORAGE
+    if(VALIDATION_run_half(&half, INPUT_SIZE, INPUT_SIZE, golden, NN_GOLDEN_LAYERS) != 0){
+        xil_printf("Half validation failed \r\n");
+    }
+#endif
+
+#ifdef USE_INT8_INFERENCE
+    // the mirrored sample has no dumps, the float network is the reference
+    for(int plane = 0; plane < 3; plane++){
+        for(int y = 0; y < INPUT_SIZE; y++){
+            for(int x = 0; x < INPUT_SIZE; x++){
+                input[plane][(y * INPUT_SIZE) + x] = frame[plane][(y * INPUT_SIZE) + (INPUT_SIZE - 1 - x)];
+            }
+        }
+    }
+    if(VALIDATION_run_quant(&quant, INPUT_SIZE, INPUT_SIZE, NULL, 0, threshold) != 0){
+        xil_printf("Int8 mirrored validation failed \r\n");
+    }
+#else
+    UNUSED(threshold);
+#endif
+
+    // last, it overwrites the input planes with the batch frames
+    for(int batch = 0; batch < VALIDATION_BATCH_FRAMES; batch++){
+        for(int plane = 0; plane < 3; plane++){
+            for(int y = 0; y < NN_BATCH_SIZE; y++){
+                memcpy(input[plane] + (((batch * NN_BATCH_SIZE) + y) * NN_BATCH_SIZE),
+                       frame[plane] + (((batch * NN_BATCH_STEP) + y) * INPUT_SIZE) + (batch * NN_BATCH_STEP), NN_BATCH_SIZE * sizeof(float));
+            }
+        }
+    }
+    if(VALIDATION_run_batch(network, NN_BATCH_SIZE, NN_BATCH_SIZE, VALIDATION_BATCH_FRAMES) != 0){
+        xil_printf("Batch validation failed \r\n");
+    }
+
+#ifdef __linux__
+    VALIDATION_free_golden(golden, NN_GOLDEN_LAYERS);
+#endif
+}
+#endif
+
 void Test_NN_Model(NeuralNetwork *model){
     xil_printf("NN Model\r\n");
     xil_printf("Status          %d \r\n", model->status);
@@ -283,44 +531,9 @@ void LAYER_MAXPOOLING_1_init_cb(Layer *layer, Layer prev_layer){
 #define IMAGE_SIZE 45
 
 
-void append_bounding_boxes(BoundingBox_Node **bb_list, BoundingBox_Node *boundingboxs) {
-    BoundingBox_Node *head_list = *bb_list;
-    BoundingBox_Node *head = boundingboxs;
-    int last_index = 0;
-
-    if (head_list == NULL) {
-        *bb_list = head;
-        while (head != NULL) {
-            head->data.index = last_index;
-            last_index++;
-            head = head->next;
-        }
-        xil_printf("Last index %d \n", last_index);
-        return;
-    }
-
-    while (head_list->next != NULL) {
-        last_index++;
-        head_list = head_list->next;
-    }
-
-    last_index++; // To move to the next index after the last node.
-
-    while (head != NULL) {
-        head->data.index = last_index;
-        head_list->next = head;
-        head_list = head_list->next;
-        last_index++;
-        head = head->next;
-    }
-    xil_printf("Last index %d \n", last_index);
-}
-
-
 int main() {
 
     NeuralNetwork *pnet_model = NULL;
-    Layer *prev_layer = NULL;
     Layer *prev_layer_1 = NULL;
     Layer *prev_layer_2 = NULL;
     int ret = 0;
@@ -331,12 +544,39 @@ int main() {
     int num_boxes = 0;
     int i = 0;
     float scales[4] = {0.6, 0.42539999999999994, 0.30160859999999995};
-    int out_width = 0;
+    u32 plan_sizes[3];
+    static Pyramid pyramid;
+    float *frame_planes[PYRAMID_PLANES] = {(float*)&image_channel_red, (float*)&image_channel_green, (float*)&image_channel_blue};
+    float *input_planes[PYRAMID_PLANES] = {(float*)NN_INPUT_RED_CHANNEL, (float*)NN_INPUT_GREEN_CHANNEL, (float*)NN_INPUT_BLUE_CHANNEL};
     measure_init();
+    TRACE_init();
+#ifdef NET_ENGINE_COHERENT_BUFFERS
+    map_arena_uncached();
+#endif
 
     xil_printf("System Task\r\n");
 
     NEURAL_NETWORK_init(&pnet_model, (u32*)NN_RECEIVE_MEM_BASE);
+#ifdef USE_MODEL_FILE
+    Model model;
+    Layer *model_layers[MODEL_MAX_LAYERS];
+    u32 *model_inputs[3] = {(u32*)NN_INPUT_RED_CHANNEL, (u32*)NN_INPUT_GREEN_CHANNEL, (u32*)NN_INPUT_BLUE_CHANNEL};
+    Model_Memory_Pool model_pools[3] = {
+        {(u32*)NN_MEM_POOL_1_BASE, NN_MEM_POOL_1_LEN},
+        {(u32*)NN_MEM_POOL_2_BASE, NN_MEM_POOL_2_LEN},
+        {(u32*)NN_MEM_POOL_3_BASE, NN_MEM_POOL_3_LEN},
+    };
+
+    if(MODEL_load(&model, (void*)NN_MODEL_BASE, NN_MODEL_LEN) != 0 ||
+       MODEL_build(&model, pnet_model, model_inputs, model_pools, 3, model_layers) != 0){
+        xil_printf("Model load failed \r\n");
+        return -1;
+    }
+    prev_layer_1 = model_layers[4];
+    prev_layer_2 = model_layers[5];
+#else
+    Layer *prev_layer = NULL;
+
     prev_layer = NEURAL_NETWORK_add_layer(pnet_model, LAYER_TYPE_CNN_3X3,        (Layer_init_cb*)LAYER_CNN_1_init_cb,        NULL,       (u32*) NN_MEM_POOL_1_BASE, NN_MEM_POOL_1_LEN, LAYER_ACTIVATION_RELU);
     prev_layer = NEURAL_NETWORK_add_layer(pnet_model, LAYER_TYPE_MAXPOOLING,     (Layer_init_cb*)LAYER_MAXPOOLING_1_init_cb, prev_layer, (u32*) NN_MEM_POOL_2_BASE, NN_MEM_POOL_2_LEN, LAYER_ACTIVATION_NOT_REQUIRED);
     prev_layer = NEURAL_NETWORK_add_layer(pnet_model, LAYER_TYPE_CNN_3X3,        (Layer_init_cb*)LAYER_CNN_2_init_cb,        prev_layer, (u32*) NN_MEM_POOL_1_BASE, NN_MEM_POOL_1_LEN, LAYER_ACTIVATION_RELU);
@@ -345,22 +585,135 @@ int main() {
     prev_layer_1 = NEURAL_NETWORK_add_layer(pnet_model, LAYER_TYPE_CNN_1X1,      (Layer_init_cb*)LAYER_CNN_4_init_cb,        prev_layer, (u32*) NN_MEM_POOL_3_BASE, NN_MEM_POOL_3_LEN, LAYER_ACTIVATION_SOFTMAX);
     // branch 2
     prev_layer_2 = NEURAL_NETWORK_add_layer(pnet_model, LAYER_TYPE_CNN_1X1,      (Layer_init_cb*)LAYER_CNN_5_init_cb,        prev_layer, (u32*) NN_MEM_POOL_1_BASE, NN_MEM_POOL_1_LEN, LAYER_ACTIVATION_NOT_REQUIRED);
+#endif
+
+#ifdef USE_SPARSE_KERNELS
+    if(SPARSITY_prune(pnet_model, &sparsity) != 0){
+        xil_printf("Sparsity prune failed \r\n");
+        return -1;
+    }
+    SPARSITY_print(&sparsity);
+#endif
+
+    // build the pyramid tap tables and the execution plans for every level up front
+    PYRAMID_init(&pyramid, INPUT_SIZE, INPUT_SIZE, scales, 3, PYRAMID_MODE_DIRECT);
+    for(int j = 0; j < 3; j++){
+        PYRAMID_level_shape(&pyramid, j, &plan_sizes[j], &plan_sizes[j]);
+    }
+    NEURAL_NETWORK_prepare_plans(pnet_model, plan_sizes, plan_sizes, 3);
+
+#ifdef USE_FUSED_EXECUTION
+    if(FUSION_init(&fusion, pnet_model, fusion_lines, NN_FUSION_LINE_LEN) != 0){
+        xil_printf("Fusion init failed \r\n");
+        return -1;
+    }
+#endif
+
+#ifdef USE_INT8_INFERENCE
+    if(init_int8(pnet_model, &pyramid, frame_planes, input_planes, plan_sizes, 3) != 0){
+        xil_printf("Int8 init failed \r\n");
+        return -1;
+    }
+#endif
+
+#ifdef USE_HALF_STORAGE
+    if(HALF_init(&half, pnet_model, half_planes, NN_HALF_ARENA_LEN, half_scratch, NN_HALF_SCRATCH_LEN) != 0){
+        xil_printf("Half init failed \r\n");
+        return -1;
+    }
+#endif
+
+#ifdef USE_SPLIT_EXECUTION
+    PYRAMID_build_level(&pyramid, 0, frame_planes, input_planes);
+    NEURAL_NETWORK_update(pnet_model, plan_sizes[0], plan_sizes[0]);
+    if(SPLIT_calibrate(pnet_model, NN_SPLIT_MODE, NN_SPLIT_ROUNDS, &split_profile) != 0){
+        xil_printf("Split calibration failed \r\n");
+        return -1;
+    }
+    SPLIT_report(pnet_model, &split_profile);
+#endif
 
-    BoundingBox_Node *boundingboxs      = NULL;
-    BoundingBox_Node *boundingboxs_list = NULL;
+#ifdef RUN_VALIDATION
+    run_validation(pnet_model, frame_planes, input_planes, threshold);
+#endif
+
+#ifdef USE_BACKEND_AUTOTUNE
+    // after the split calibration, so a split layer competes with its calibrated share, and after
+    // the validation, whose NEURAL_NETWORK_set_conv_backend calls clear the tuned entries
+    BACKEND_report_init(&backend_report);
+    for(int j = 0; j < 3; j++){
+        PYRAMID_build_level(&pyramid, j, frame_planes, input_planes);
+        if(BACKEND_autotune(pnet_model, plan_sizes[j], plan_sizes[j], NN_AUTOTUNE_ROUNDS, &backend_report) != 0){
+            xil_printf("Backend autotune failed \r\n");
+            return -1;
+        }
+    }
+    BACKEND_report(&backend_report);
+#endif
+
+#ifdef RUN_BENCHMARK
+    Benchmark_Config bench_config = {2, 10, BENCHMARK_FORMAT_CSV};
+    BENCHMARK_run(&bench_config, &pnet_model->net_engine, (u32*)NN_BENCH_BASE, NN_BENCH_LEN);
+#endif
+
+    static Detector detector;
+    Detector_Config detector_config = {NN_TOP_K, threshold, NMS_THRESHOLD, NMS_THRESHOLD, NN_NMS_MODE};
+
+    if(DETECTOR_init(&detector, &detector_config, detector_memory, sizeof(detector_memory)) != 0){
+        xil_printf("Detector init failed \r\n");
+        return -1;
+    }
+
+#ifdef USE_SCALE_SCHEDULER
+    static Scheduler scheduler;
+    Scheduler_Config scheduler_config;
+    Decode_Context   decode_context = {scales, &detector};
+
+    scheduler_config.network  = pnet_model;
+    scheduler_config.pyramid  = &pyramid;
+    for(int plane = 0; plane < PYRAMID_PLANES; plane++){
+        scheduler_config.input_slots[0][plane] = input_planes[plane];
+    }
+    scheduler_config.input_slots[1][0] = (float*)NN_INPUT_SLOT_2_RED;
+    scheduler_config.input_slots[1][1] = (float*)NN_INPUT_SLOT_2_GREEN;
+    scheduler_config.input_slots[1][2] = (float*)NN_INPUT_SLOT_2_BLUE;
+    scheduler_config.head_slots[0]     = (float*)NN_HEAD_SLOT_BASE;
+    scheduler_config.head_slots[1]     = (float*)(NN_HEAD_SLOT_BASE + NN_HEAD_SLOT_LEN);
+    scheduler_config.head_slot_size    = NN_HEAD_SLOT_LEN;
+    scheduler_config.score_layer       = prev_layer_1->index;
+    scheduler_config.box_layer         = prev_layer_2->index;
+    scheduler_config.decode            = decode_level;
+    scheduler_config.context           = &decode_context;
+
+    if(SCHEDULER_init(&scheduler, &scheduler_config) != 0){
+        xil_printf("Scheduler init failed \r\n");
+        return -1;
+    }
+#endif
 
 
 
     // TickType_t tickCount = xTaskGetTickCount();
     for(int k = 0; k < 10; k++){
         printf("Trail %d\n",k);
+        DETECTOR_reset(&detector);
+#ifdef USE_SCALE_SCHEDULER
+#ifdef PROCESS_TIME_MEASURE
+        measure_start(TIME_MEASURE_SIGNAL_0);
+#endif
+        SCHEDULER_run(&scheduler, frame_planes);
+#ifdef PROCESS_TIME_MEASURE
+        measure_end(TIME_MEASURE_SIGNAL_0);
+#endif
+#else
         for(int j = 0; j < 3; j++){
-            printf("Scale %f\n", scales[j]);
-            image_resize((float*)&image_channel_red,   (float*)NN_INPUT_RED_CHANNEL,   100, 100, scales[j]);
-            image_resize((float*)&image_channel_green, (float*)NN_INPUT_GREEN_CHANNEL, 100, 100, scales[j]);
-            image_resize((float*)&image_channel_blue,  (float*)NN_INPUT_BLUE_CHANNEL,  100, 100, scales[j]);
+            const float *heads[6];
+            u32          head_height;
+            u32          head_width;
+            int          out_width = plan_sizes[j];
 
-            out_width  = round(100 * scales[j]);
+            printf("Scale %f\n", scales[j]);
+            PYRAMID_build_level(&pyramid, j, frame_planes, input_planes);
 
             // Test_NN_Model(pnet_model);
 
@@ -369,27 +722,45 @@ int main() {
 #ifdef PROCESS_TIME_MEASURE
             measure_start(TIME_MEASURE_SIGNAL_0);
 #endif
-            NEURAL_NETWORK_process(pnet_model);
+#if defined(USE_INT8_INFERENCE)
+            ret = QUANT_process(&quant);
+#elif defined(USE_HALF_STORAGE)
+            ret = HALF_process(&half);
+#elif defined(USE_FUSED_EXECUTION)
+            ret = FUSION_process(&fusion);
+#else
+            ret = NEURAL_NETWORK_process(pnet_model);
+#endif
         
 #ifdef PROCESS_TIME_MEASURE
             measure_end(TIME_MEASURE_SIGNAL_0);
 #endif
-            // generate_bounding_boxes(prev_layer_1, prev_layer_2, 45, 45, scales[j], threshold, &boundingboxs, &num_boxes);
-            // printf("generate_bounding_boxes num_boxes %d\n", num_boxes);
-
-            // non_max_suppression(boundingboxs, &num_boxes);
-            // printf("non_max_suppression num_boxes %d\n", num_boxes);
-
-            // append_bounding_boxes(&boundingboxs_list, boundingboxs);
+            // the heads still hold the previous level
+            if(ret != 0){
+                xil_printf("Scale %d failed \r\n", j);
+                continue;
+            }
+            if(BBOX_layer_heads(prev_layer_1, prev_layer_2, heads, &head_height, &head_width) == 0){
+                DETECTOR_add_level(&detector, heads, head_height, head_width, scales[j]);
+            }
 
         }
-        // non_max_suppression(boundingboxs_list, &num_boxes);
+#endif
+        printf("candidates %d, evicted %d\n", detector.candidates, detector.evicted);
+        num_boxes = detector.boxes.count;
         printf("final non_max_suppression num_boxes %d\n", num_boxes);
     }
 
-    //non_max_suppression(boundingboxs_list, &num_boxes);
     printf("final non_max_suppression num_boxes %d\n", num_boxes);
 
+    PROFILER_report();
+#ifdef USE_SCALE_SCHEDULER
+    SCHEDULER_report(&scheduler);
+#endif
+#ifdef USE_TRACE
+    TRACE_dump();
+#endif
+
     xil_printf("completed \n");
 
 
@@ -0,0 +1,322 @@
+#include "model.h"
+#include <stdlib.h>
+#include <string.h>
+#include <xil_printf.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// state for MODEL_layer_init_cb, the init callback only receives the layers
+static struct{
+    const Model              *model;
+    const Model_Layer_Record *record;
+    u32 *const               *input_planes;
+    u32                       height;
+    u32                       width;
+    u32                       index;
+    int                       status;
+} MODEL_context;
+
+static int MODEL_blob_valid(const Model *instance, u32 offset, u32 count){
+    if(count == 0){
+        return 1;
+    }
+    return (offset % MODEL_ALIGN) == 0 && offset <= instance->header->blob_size &&
+           count <= (instance->header->blob_size - offset) / sizeof(float);
+}
+
+static int MODEL_record_valid(const Model *instance, u32 index){
+    const Model_Layer_Record *record = &instance->records[index];
+    const Model_Layer_Record *source;
+    u32 in  = record->in_channels;
+    u32 out = record->out_channels;
+
+    if(record->source > index || record->activation > LAYER_ACTIVATION_NOT_REQUIRED || out == 0 || in == 0 ||
+       record->stride == 0){
+        return 0;
+    }
+    source = &instance->records[record->source];
+    if(record->source == index ? in != instance->header->input_channels : in != source->out_channels){
+        return 0;
+    }
+    if(!MODEL_blob_valid(instance, record->weights_offset, record->weights_count) ||
+       !MODEL_blob_valid(instance, record->bias_offset,    record->bias_count) ||
+       !MODEL_blob_valid(instance, record->alpha_offset,   record->alpha_count)){
+        return 0;
+    }
+
+    switch (record->type){
+    // the conv kernels only run stride 1 without padding
+    case LAYER_TYPE_CNN_3X3:
+        return record->kernal_size == 3 && record->stride == 1 && record->padding == 0 && record->weights_count == out * in * 9 && record->bias_count == out &&
+               (record->alpha_count == 0 || record->alpha_count == out);
+    case LAYER_TYPE_CNN_1X1:
+        return record->kernal_size == 1 && record->stride == 1 && record->padding == 0 && record->weights_count == out * in && record->bias_count == out;
+    case LAYER_TYPE_MAXPOOLING:
+        return record->source != index && record->kernal_size > 0 && out == in;
+    default:
+        return 0;
+    }
+}
+
+int MODEL_load(Model *instance, const void *base, u32 size){
+    const Model_Header *header = (const Model_Header*)base;
+
+    if(instance == NULL || base == NULL || size < sizeof(Model_Header)){
+        return -1;
+    }
+
+    if(header->magic != MODEL_MAGIC || header->version != MODEL_VERSION ||
+       header->header_size != sizeof(Model_Header) || header->record_size != sizeof(Model_Layer_Record)){
+        xil_printf("Model: bad header \r\n");
+        return -1;
+    }
+
+    if(header->layer_count == 0 || header->layer_count > MODEL_MAX_LAYERS ||
+       header->header_size + (header->layer_count * header->record_size) > header->blob_offset ||
+       header->blob_offset > size || header->blob_size > size - header->blob_offset ||
+       (header->blob_offset % MODEL_ALIGN) != 0){
+        xil_printf("Model: truncated or malformed image \r\n");
+        return -1;
+    }
+
+    instance->base    = (const u8*)base;
+    instance->size    = size;
+    instance->header  = header;
+    instance->records = (const Model_Layer_Record*)(instance->base + header->header_size);
+    instance->blob    = instance->base + header->blob_offset;
+    instance->mapped  = 0;
+
+    for(u32 index = 0; index < header->layer_count; index++){
+        if(!MODEL_record_valid(instance, index)){
+            xil_printf("Model: invalid layer %d \r\n", index);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef __linux__
+int MODEL_map(Model *instance, const char *path){
+    struct stat info;
+    void *base;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+        xil_printf("Model: cannot open %s \r\n", path);
+        return -1;
+    }
+
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        return -1;
+    }
+
+    base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED){
+        return -1;
+    }
+
+    if(MODEL_load(instance, base, info.st_size) != 0){
+        munmap(base, info.st_size);
+        return -1;
+    }
+
+    instance->mapped = 1;
+    return 0;
+}
+
+void MODEL_unmap(Model *instance){
+    if(instance->mapped){
+        munmap((void*)instance->base, instance->size);
+        instance->mapped = 0;
+    }
+}
+#endif
+
+const u32* MODEL_blob(const Model *instance, u32 offset){
+    return (const u32*)(instance->blob + offset);
+}
+
+static void MODEL_add_inputs(Layer *layer, Layer prev_layer){
+    const Model_Layer_Record *record = MODEL_context.record;
+    Channel_Node *prev_output_channels = prev_layer.output_channels.channels;
+
+    if(record->source == MODEL_context.index){
+        for(u32 index = 0; index < record->in_channels; index++){
+            LAYER_add_input_channel(layer, MODEL_context.model->header->input_height, MODEL_context.model->header->input_width, MODEL_context.input_planes[index]);
+        }
+        return;
+    }
+
+    while(prev_output_channels != NULL){
+        LAYER_add_input_channel(layer, prev_output_channels->data.height, prev_output_channels->data.width, prev_output_channels->data.output_ptr);
+        prev_output_channels = (Channel_Node *)prev_output_channels->next;
+    }
+    layer->input_channels.count = prev_layer.output_channels.count;
+}
+
+static int MODEL_add_cnn_3x3(Layer *layer){
+    const Model_Layer_Record *record = MODEL_context.record;
+    const u32 *weights = MODEL_blob(MODEL_context.model, record->weights_offset);
+    const u32 *bias    = MODEL_blob(MODEL_context.model, record->bias_offset);
+    u32 count = record->out_channels * record->in_channels;
+    Channel_Kernal_Data *kernals;
+    u32 *alpha;
+    int ret;
+
+    // the kernel nodes keep their own copy, so this table is only needed while the layer is built
+    kernals = (Channel_Kernal_Data*)calloc(count, sizeof(Channel_Kernal_Data));
+    alpha   = (u32*)calloc(record->out_channels, sizeof(u32));
+    if(kernals == NULL || alpha == NULL){
+        free(kernals);
+        free(alpha);
+        return -1;
+    }
+
+    for(u32 index = 0; index < count; index++){
+        memcpy(&kernals[index].Kernal, &weights[index * 9], sizeof(kernals[index].Kernal));
+        kernals[index].index = index;
+        kernals[index].state = CHANNEL_STATE_NOT_STARTED;
+        // the bias rides on the last input kernel of each output channel
+        if((index % record->in_channels) == record->in_channels - 1){
+            kernals[index].Bias = bias[index / record->in_channels];
+        }
+    }
+
+    if(record->alpha_count != 0){
+        memcpy(alpha, MODEL_blob(MODEL_context.model, record->alpha_offset), record->alpha_count * sizeof(u32));
+    }
+
+    ret = LAYER_add_cnn_output_channels(&layer, kernals, alpha, record->out_channels, MODEL_context.height, MODEL_context.width);
+
+    free(kernals);
+    free(alpha);
+    return ret;
+}
+
+static void *MODEL_layer_init_cb(Layer *layer, Layer prev_layer){
+    const Model_Layer_Record *record = MODEL_context.record;
+
+    switch (record->type){
+    case LAYER_TYPE_MAXPOOLING:
+        LAYER_link(&prev_layer, layer);
+        MODEL_context.status = LAYER_add_maxpool_output_channels(&layer, record->kernal_size, record->stride, record->padding,
+                                                                 record->out_channels, MODEL_context.height, MODEL_context.width);
+        break;
+    case LAYER_TYPE_CNN_3X3:
+        MODEL_add_inputs(layer, prev_layer);
+        MODEL_context.status = MODEL_add_cnn_3x3(layer);
+        break;
+    case LAYER_TYPE_CNN_1X1:
+        MODEL_add_inputs(layer, prev_layer);
+        MODEL_context.status = LAYER_add_cnn_1x1_output_channels(&layer, (void*)MODEL_blob(MODEL_context.model, record->weights_offset),
+                                                                 (void*)MODEL_blob(MODEL_context.model, record->bias_offset),
+                                                                 record->weights_count, record->out_channels, MODEL_context.height, MODEL_context.width);
+        break;
+    default:
+        MODEL_context.status = -1;
+        break;
+    }
+
+    return NULL;
+}
+
+// last layer reading each tensor, network outputs stay live to the end
+static void MODEL_last_use(const Model *model, u32 *last_use){
+    u32 count = model->header->layer_count;
+
+    for(u32 index = 0; index < count; index++){
+        last_use[index] = count;
+    }
+    // readers come after their producer, so the final write is the last reader
+    for(u32 index = 0; index < count; index++){
+        if(model->records[index].source != index){
+            last_use[model->records[index].source] = index;
+        }
+    }
+}
+
+int MODEL_build(const Model *model, NeuralNetwork *network, u32 *const *input_planes,
+                const Model_Memory_Pool *pools, u32 pool_count, Layer **layers){
+    const Model_Layer_Record *record;
+    Layer *built[MODEL_MAX_LAYERS];
+    int    pool_owner[MODEL_MAX_LAYERS];
+    u32    last_use[MODEL_MAX_LAYERS];
+    u32    out_height[MODEL_MAX_LAYERS];
+    u32    out_width[MODEL_MAX_LAYERS];
+    u32    height;
+    u32    width;
+    u32    pool;
+
+    if(model == NULL || network == NULL || pools == NULL || pool_count == 0 || pool_count > MODEL_MAX_LAYERS){
+        return -1;
+    }
+
+    MODEL_last_use(model, last_use);
+    for(pool = 0; pool < pool_count; pool++){
+        pool_owner[pool] = -1;
+    }
+
+    MODEL_context.model        = model;
+    MODEL_context.input_planes = input_planes;
+
+    for(u32 index = 0; index < model->header->layer_count; index++){
+        record = &model->records[index];
+
+        if(record->source == index){
+            height = model->header->input_height;
+            width  = model->header->input_width;
+        }
+        else{
+            height = out_height[record->source];
+            width  = out_width[record->source];
+        }
+
+        if(height + (2 * record->padding) < record->kernal_size || width + (2 * record->padding) < record->kernal_size){
+            xil_printf("Model: layer %d input too small \r\n", index);
+            return -1;
+        }
+        out_height[index] = ((height + (2 * record->padding) - record->kernal_size) / record->stride) + 1;
+        out_width[index]  = ((width  + (2 * record->padding) - record->kernal_size) / record->stride) + 1;
+
+        // first pool whose tensor has no readers left
+        for(pool = 0; pool < pool_count; pool++){
+            if(pool_owner[pool] < 0 || last_use[pool_owner[pool]] < index){
+                break;
+            }
+        }
+        if(pool == pool_count){
+            xil_printf("Model: no free memory pool for layer %d \r\n", index);
+            return -1;
+        }
+        pool_owner[pool] = index;
+
+        MODEL_context.record = record;
+        MODEL_context.index  = index;
+        MODEL_context.height = out_height[index];
+        MODEL_context.width  = out_width[index];
+        MODEL_context.status = 0;
+
+        built[index] = NEURAL_NETWORK_add_layer(network, (LAYER_TYPE)record->type, (Layer_init_cb*)MODEL_layer_init_cb,
+                                                (record->source == index) ? NULL : built[record->source],
+                                                pools[pool].base, pools[pool].length, (LAYER_ACTIVATION)record->activation);
+        if(built[index] == NULL || MODEL_context.status < 0){
+            xil_printf("Model: layer %d build failed \r\n", index);
+            return -1;
+        }
+
+        if(layers != NULL){
+            layers[index] = built[index];
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+
+#ifndef NET_ENGINE_MODEL_H
+#define NET_ENGINE_MODEL_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+
+/**************************** Type Definitions *****************************/
+#define MODEL_MAGIC         0x4C444D50      // "PMDL"
+#define MODEL_VERSION       1
+#define MODEL_ALIGN         16              // every weight blob starts on a NEON friendly boundary
+#define MODEL_MAX_LAYERS    PLAN_MAX_LAYERS
+
+// on disk layout, written by model/convert_model.py, all fields little endian
+typedef struct Model_Header_{
+    u32 magic;
+    u32 version;
+    u32 header_size;
+    u32 layer_count;
+    u32 input_channels;
+    u32 input_height;
+    u32 input_width;
+    u32 record_size;
+    u32 blob_offset;
+    u32 blob_size;
+    u32 reserved[6];
+} Model_Header;
+
+typedef struct Model_Layer_Record_{
+    u32 type;                   // LAYER_TYPE
+    u32 activation;             // LAYER_ACTIVATION
+    u32 source;                 // producer layer, or this layer's own index for the network input
+    u32 in_channels;
+    u32 out_channels;
+    u32 kernal_size;
+    u32 stride;
+    u32 padding;
+    u32 weights_offset;         // byte offsets into the blob, counts in floats
+    u32 weights_count;
+    u32 bias_offset;
+    u32 bias_count;
+    u32 alpha_offset;
+    u32 alpha_count;
+    u32 reserved[2];
+} Model_Layer_Record;
+
+typedef struct Model_{
+    const u8                 *base;
+    u32                       size;
+    const Model_Header       *header;
+    const Model_Layer_Record *records;
+    const u8                 *blob;
+    u8                        mapped;
+} Model;
+
+typedef struct Model_Memory_Pool_{
+    u32 *base;
+    u32  length;
+} Model_Memory_Pool;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Validates a model image already in memory (e.g. downloaded to DDR) and
+ * points the Model at it. Nothing is copied, base must stay valid while
+ * the network built from it is in use.
+ */
+int MODEL_load(Model *instance, const void *base, u32 size);
+
+#ifdef __linux__
+int MODEL_map(Model *instance, const char *path);
+
+void MODEL_unmap(Model *instance);
+#endif
+
+const u32* MODEL_blob(const Model *instance, u32 offset);
+
+/**
+ * Adds the model's layers to an initialised network. Layers reading the
+ * network input take input_planes, the others their producer's outputs.
+ * Output buffers are handed out from pools, reusing a pool once every
+ * consumer of the tensor it holds has run. To swap models, build into a
+ * fresh network. layers receives one Layer* per record when not NULL.
+ */
+int MODEL_build(const Model *model, NeuralNetwork *network, u32 *const *input_planes,
+                const Model_Memory_Pool *pools, u32 pool_count, Layer **layers);
+
+#endif // NET_ENGINE_MODEL_H
@@ -2,12 +2,19 @@
 #include "xscugic.h"
 #include "xparameters.h"
 #include "time_measure.h"
+#include "prepack.h"
+#include "trace.h"
+#include "profiler.h"
+#include <stdlib.h>
 
 #define NET_ENGINE_1_AXI_DMA_BASEADDR XPAR_AXI_DMA_0_BASEADDR
 #define NET_ENGINE_1_CONFIG_BASEADDR  XPAR_NET_ENGINE_0_BASEADDR
 
 #define PROCESS_TIME_MEASURE
 
+// 3x3 backend when the Net Engine is not used, CONV_BACKEND_CPU_DIRECT, _WINOGRAD, _SPARSE or _ENGINE
+#define NEURAL_NETWORK_CPU_CONV_BACKEND     CONV_BACKEND_CPU_DIRECT
+
 int NEURAL_NETWORK_setup_net_engine(Net_Engine_Inst *instance){
     NET_STATUS Status;
 
@@ -49,6 +56,9 @@ int NEURAL_NETWORK_init(NeuralNetwork **instance, u32 *receive_memory_ptr){
     (*instance)->completed_count = 0;
     (*instance)->status          = NN_STATE_NOT_STARTED;
     (*instance)->receive_memory_ptr    = receive_memory_ptr;
+    (*instance)->active_plan           = NULL;
+
+    PLAN_cache_init(&(*instance)->plan_cache);
 
     ret = NEURAL_NETWORK_setup_net_engine(&(*instance)->net_engine);
 
@@ -56,7 +66,7 @@ int NEURAL_NETWORK_init(NeuralNetwork **instance, u32 *receive_memory_ptr){
 }
 
 static NN_Layer_Node* create_layer_node(Layer layer){
-    NN_Layer_Node* new = (NN_Layer_Node*)malloc(sizeof(Layer));
+    NN_Layer_Node* new = (NN_Layer_Node*)malloc(sizeof(NN_Layer_Node));
     if(new == NULL){
         xil_printf("Node malloc error \r\n");
         return NULL;
@@ -67,15 +77,15 @@ static NN_Layer_Node* create_layer_node(Layer layer){
     return new;
 }
 
-static void append_layer_node(NN_Layer_Node** head_ref, Layer new_data) {
+static NN_Layer_Node* append_layer_node(NN_Layer_Node** head_ref, Layer new_data) {
     NN_Layer_Node* new = create_layer_node(new_data);
     if (new == NULL) {
-        return;
+        return NULL;
     }
 
     if (*head_ref == NULL) {
         *head_ref = new;
-        return;
+        return new;
     }
 
     NN_Layer_Node* last = *head_ref;
@@ -85,10 +95,13 @@ static void append_layer_node(NN_Layer_Node** head_ref, Layer new_data) {
 
     last->prev = last->next;
     last->next = new;
+    return new;
 }
 
 Layer* NEURAL_NETWORK_add_layer(NeuralNetwork *instance, LAYER_TYPE type, Layer_init_cb init_cb, Layer *prev_layer, u32* memory_ptr, u32 memory_len, LAYER_ACTIVATION activation){
     Layer* new_layer;
+    Layer  no_layer = {0};
+    NN_Layer_Node* node;
 
     if(instance == NULL){
         return NULL;
@@ -99,9 +112,28 @@ Layer* NEURAL_NETWORK_add_layer(NeuralNetwork *instance, LAYER_TYPE type, Layer_
         return NULL;
     }
 
-    init_cb(new_layer, *prev_layer);
+    // the first layer has no producer
+    init_cb(new_layer, (prev_layer == NULL) ? no_layer : *prev_layer);
 
-    new_layer->index = instance->layer_count;
+    if(activation == LAYER_ACTIVATION_SOFTMAX && new_layer->output_channels.count > LAYER_SOFTMAX_MAX_CLASSES){
+        xil_printf("Softmax layer with %d classes, at most %d supported \r\n", new_layer->output_channels.count, LAYER_SOFTMAX_MAX_CLASSES);
+        free(new_layer);
+        return NULL;
+    }
+
+    // weights are rearranged once here instead of on every kernel dispatch
+    if(type == LAYER_TYPE_CNN_3X3){
+        new_layer->packed = PREPACK_conv3x3(new_layer);
+#ifdef USE_NET_ENGINE
+        new_layer->conv_backend = CONV_BACKEND_NET_ENGINE;
+#else
+        new_layer->conv_backend = NEURAL_NETWORK_CPU_CONV_BACKEND;
+#endif
+        new_layer->default_backend = new_layer->conv_backend;
+    }
+
+    new_layer->index        = instance->layer_count;
+    new_layer->source_index = (prev_layer == NULL) ? new_layer->index : prev_layer->index;
     // allocating memory locations for each output channels
     Channel_Node* cur_channel     = new_layer->output_channels.channels;
     new_layer->memory.memory_ptr  = memory_ptr;
@@ -128,13 +160,20 @@ Layer* NEURAL_NETWORK_add_layer(NeuralNetwork *instance, LAYER_TYPE type, Layer_
 
     if(instance->layers == NULL){
         instance->layers = create_layer_node(*new_layer);
+        node = instance->layers;
     }
     else{
-        append_layer_node(&(instance->layers), *new_layer);
+        node = append_layer_node(&(instance->layers), *new_layer);
+    }
+
+    // the caller gets the network's copy, so plans and repacking stay visible through it
+    free(new_layer);
+    if(node == NULL){
+        return NULL;
     }
 
     instance->layer_count++;
-    return new_layer;
+    return &node->layer;
 }
 
 int NEURAL_NETWORK_layer_link(NeuralNetwork *instance){
@@ -153,7 +192,65 @@ int NEURAL_NETWORK_layer_link(NeuralNetwork *instance){
     return 0;
 }
 
+int NEURAL_NETWORK_layer_info(NeuralNetwork *instance, NN_Layer_Info *info, u32 max_layers, u32 max_channels){
+    NN_Layer_Node *cur_layer;
+    NN_Layer_Info *layer;
+    Channel_Node  *output_channel;
+    u32 count = 0;
+
+    for(cur_layer = instance->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next){
+        if(count >= max_layers){
+            return -1;
+        }
+
+        layer               = &info[count];
+        layer->layer        = &cur_layer->layer;
+        layer->source       = (cur_layer->layer.source_index == cur_layer->layer.index) ? -1 : cur_layer->layer.source_index;
+        layer->head         = 1;
+        layer->in_channels  = cur_layer->layer.input_channels.count;
+        layer->out_channels = cur_layer->layer.output_channels.count;
+        layer->kernal_size  = 0;
+        layer->stride       = 0;
+        output_channel      = cur_layer->layer.output_channels.channels;
+
+        if(layer->in_channels > max_channels || layer->out_channels > max_channels || layer->source >= (int)count){
+            return -1;
+        }
+        if(layer->source >= 0){
+            info[layer->source].head = 0;
+        }
+
+        switch(cur_layer->layer.type){
+            case LAYER_TYPE_CNN_3X3:
+                layer->kernal_size = 3;
+                layer->stride      = 1;
+                break;
+            case LAYER_TYPE_CNN_1X1:
+                layer->kernal_size = 1;
+                layer->stride      = 1;
+                break;
+            case LAYER_TYPE_MAXPOOLING:
+                if(output_channel == NULL){
+                    return -1;
+                }
+                layer->kernal_size = output_channel->data.data.mx_data.pool_size;
+                layer->stride      = output_channel->data.data.mx_data.stride;
+                break;
+            default:
+                break;
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
 int NEURAL_NETWORK_process(NeuralNetwork *instance){
+    return NEURAL_NETWORK_process_cb(instance, NULL, NULL);
+}
+
+int NEURAL_NETWORK_process_cb(NeuralNetwork *instance, NN_Layer_Done_cb *layer_done, void *context){
     // allocating memory locations for each output channels
     NN_Layer_Node* cur_layer = instance->layers;
 
@@ -167,12 +264,18 @@ int NEURAL_NETWORK_process(NeuralNetwork *instance){
 #ifdef PROCESS_TIME_MEASURE
     measure_start(TIME_MEASURE_SIGNAL_1);
 #endif
+        TRACE_BEGIN("layer", cur_layer->layer.index);
         LAYER_process(&(cur_layer->layer), &(instance->net_engine));
+        TRACE_END("layer");
         // LAYER_CNN_process(&(cur_layer->layer));
 
 #ifdef PROCESS_TIME_MEASURE
     measure_end(TIME_MEASURE_SIGNAL_1);
 #endif
+        // outputs may share a memory pool with a later layer, so look at them now
+        if(layer_done != NULL && layer_done(&(cur_layer->layer), context) != 0){
+            return -1;
+        }
         // jumping to next laer
         cur_layer = cur_layer->next;
     }
@@ -180,26 +283,266 @@ int NEURAL_NETWORK_process(NeuralNetwork *instance){
     return 0;
 }
 
+int NEURAL_NETWORK_time_layers(NeuralNetwork *instance, u64 *ns, u32 count){
+    NN_Layer_Node* cur_layer = instance->layers;
+    u64 start;
+    u32 index = 0;
+
+    while (cur_layer != NULL){
+        start = PROFILER_now();
+        if(LAYER_run(&(cur_layer->layer), &(instance->net_engine)) != 0){
+            return -1;
+        }
+        if(index < count){
+            ns[index] = PROFILER_ticks_to_ns(PROFILER_now() - start);
+        }
+
+        index++;
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+
+    return 0;
+}
+
+static void NEURAL_NETWORK_set_batch(NeuralNetwork *instance, u32 count, u32 input_stride){
+    NN_Layer_Node*    cur_layer = instance->layers;
+    const Layer_Plan* layer_plan;
+    u32 index = 0;
+
+    while (cur_layer != NULL){
+        layer_plan = &instance->active_plan->layers[index];
+
+        cur_layer->layer.batch.count      = count;
+        cur_layer->layer.batch.out_stride = layer_plan->frame_stride;
+        if(cur_layer->layer.source_index == index){
+            cur_layer->layer.batch.in_stride = input_stride;
+        }
+        else{
+            cur_layer->layer.batch.in_stride = instance->active_plan->layers[cur_layer->layer.source_index].frame_stride;
+        }
+
+        index++;
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+}
+
+int NEURAL_NETWORK_process_batch(NeuralNetwork *instance, u32 count, u32 input_stride){
+    return NEURAL_NETWORK_process_batch_cb(instance, count, input_stride, NULL, NULL);
+}
+
+int NEURAL_NETWORK_process_batch_cb(NeuralNetwork *instance, u32 count, u32 input_stride, NN_Layer_Done_cb *layer_done, void *context){
+    NN_Layer_Node* cur_layer = instance->layers;
+    u32 index = 0;
+    int ret;
+
+    if(instance->active_plan == NULL || count == 0){
+        xil_printf("No plan for the batch \r\n");
+        return -1;
+    }
+
+    while (cur_layer != NULL){
+        if(count * instance->active_plan->layers[index].frame_stride * sizeof(u32) > cur_layer->layer.memory.availale_mem_size){
+            xil_printf("Layer %d pool too small for %d frames \r\n", cur_layer->layer.index, count);
+            return -1;
+        }
+        index++;
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+
+    NEURAL_NETWORK_set_batch(instance, count, input_stride);
+    ret = NEURAL_NETWORK_process_cb(instance, layer_done, context);
+    NEURAL_NETWORK_set_batch(instance, 1, 0);
+
+    return ret;
+}
+
+int NEURAL_NETWORK_set_conv_backend(NeuralNetwork *instance, CONV_BACKEND backend){
+    NN_Layer_Node* cur_layer = instance->layers;
+
+    while (cur_layer != NULL){
+        if(cur_layer->layer.type == LAYER_TYPE_CNN_3X3){
+            // CPU backends run from the prepacked weights only
+            if(backend != CONV_BACKEND_NET_ENGINE && cur_layer->layer.packed == NULL){
+                xil_printf("Layer %d is not prepacked \r\n", cur_layer->layer.index);
+                return -1;
+            }
+            cur_layer->layer.conv_backend    = backend;
+            cur_layer->layer.default_backend = backend;
+        }
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+
+    // an explicit backend holds at every size, autotuned entries would override it on the next update
+    for(u32 plan = 0; plan < instance->plan_cache.count; plan++){
+        for(u32 index = 0; index < instance->plan_cache.plans[plan].layer_count; index++){
+            instance->plan_cache.plans[plan].layers[index].conv_backend = CONV_BACKEND_COUNT;
+        }
+    }
+
+    return 0;
+}
+
+static int NEURAL_NETWORK_build_plan(NeuralNetwork *instance, Execution_Plan *plan, u32 height, u32 width){
+    NN_Layer_Node* cur_layer = instance->layers;
+    Layer_Plan*    source    = NULL;
+    u32 index     = 0;
+    u32 in_height = 0;
+    u32 in_width  = 0;
+
+    while (cur_layer != NULL){
+        if(index >= PLAN_MAX_LAYERS){
+            xil_printf("Plan: too many layers \r\n");
+            return -1;
+        }
+
+        // a layer reads the frame, or the output of the layer it was added after
+        if(cur_layer->layer.source_index == cur_layer->layer.index){
+            in_height = height;
+            in_width  = width;
+        }
+        else{
+            source    = &plan->layers[cur_layer->layer.source_index];
+            in_height = source->out_height;
+            in_width  = source->out_width;
+        }
+
+        if(PLAN_layer_build(&plan->layers[index], &cur_layer->layer, in_height, in_width) != 0){
+            return -1;
+        }
+
+        index++;
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+
+    plan->layer_count = index;
+    return 0;
+}
+
+static void NEURAL_NETWORK_apply_plan(NeuralNetwork *instance, Execution_Plan *plan){
+    NN_Layer_Node*    cur_layer = instance->layers;
+    Layer*            layers[PLAN_MAX_LAYERS];
+    const Layer_Plan* layer_plan;
+    const Layer_Plan* source_plan;
+    Layer*            source;
+    Channel_Node*     chan_node;
+    u32 index = 0;
+
+    while (cur_layer != NULL && index < plan->layer_count){
+        layers[index] = &cur_layer->layer;
+        layer_plan    = &plan->layers[index];
+        source        = layers[cur_layer->layer.source_index];
+        source_plan   = &plan->layers[cur_layer->layer.source_index];
+
+        cur_layer->layer.plan = layer_plan;
+        // without a tuned entry the layer goes back to its own, not the previous plan's choice
+        if(cur_layer->layer.type == LAYER_TYPE_CNN_3X3){
+            cur_layer->layer.conv_backend = (layer_plan->conv_backend != CONV_BACKEND_COUNT) ?
+                                            layer_plan->conv_backend : cur_layer->layer.default_backend;
+        }
+
+        // input planes are the packed output planes of the source layer, the first layer reads the frame buffers
+        chan_node = cur_layer->layer.input_channels.channels;
+        while (chan_node != NULL){
+            CHANNEL_update(&chan_node->data, layer_plan->in_height, layer_plan->in_width);
+            if(source != layers[index]){
+                chan_node->data.input_ptr = source->memory.memory_ptr + (chan_node->data.index * source_plan->channel_stride);
+            }
+            chan_node = (Channel_Node*)chan_node->next;
+        }
+
+        chan_node = cur_layer->layer.output_channels.channels;
+        while (chan_node != NULL){
+            CHANNEL_update(&chan_node->data, layer_plan->out_height, layer_plan->out_width);
+            chan_node->data.output_ptr = cur_layer->layer.memory.memory_ptr + (chan_node->data.index * layer_plan->channel_stride);
+            if(cur_layer->layer.type == LAYER_TYPE_CNN_3X3){
+                chan_node->data.temp_ptr = instance->receive_memory_ptr;
+            }
+            chan_node = (Channel_Node*)chan_node->next;
+        }
+
+        index++;
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+
+    instance->active_plan = plan;
+}
+
+static Execution_Plan* NEURAL_NETWORK_get_plan(NeuralNetwork *instance, u32 height, u32 width){
+    Execution_Plan *plan = NULL;
+
+    plan = PLAN_cache_find(&instance->plan_cache, height, width);
+    if(plan != NULL){
+        return plan;
+    }
+
+    plan = PLAN_cache_reserve(&instance->plan_cache, height, width, instance->active_plan);
+    if(NEURAL_NETWORK_build_plan(instance, plan, height, width) != 0){
+        // leave the slot unmatched so a failed build is never reused
+        plan->height = 0;
+        plan->width  = 0;
+        return NULL;
+    }
+
+    return plan;
+}
+
+int NEURAL_NETWORK_set_input(NeuralNetwork *instance, u32 *const *planes, u32 count){
+    NN_Layer_Node* cur_layer = instance->layers;
+    Channel_Node*  chan_node;
+
+    while (cur_layer != NULL){
+        // only layers reading the network input, the others follow their source
+        if(cur_layer->layer.source_index == cur_layer->layer.index){
+            chan_node = cur_layer->layer.input_channels.channels;
+            while (chan_node != NULL){
+                if(chan_node->data.index >= count){
+                    return -1;
+                }
+                chan_node->data.input_ptr = planes[chan_node->data.index];
+                chan_node = (Channel_Node*)chan_node->next;
+            }
+        }
+        cur_layer = (NN_Layer_Node*)cur_layer->next;
+    }
+
+    return 0;
+}
+
 int NEURAL_NETWORK_update(NeuralNetwork *instance, int height, int width){
-    int height_, width_;
-    NN_Layer_Node* cur_layer  = instance->layers;
-    NN_Layer_Node* prev_layer = instance->layers;
+    Execution_Plan *plan = NULL;
 
     // check whether the layer loaded
-    if(cur_layer == NULL){
+    if(instance->layers == NULL){
         xil_printf("No layer available \r\n");
         return 0;
     }
 
-    while (cur_layer != NULL){
+    if(instance->active_plan != NULL && instance->active_plan->height == (u32)height && instance->active_plan->width == (u32)width){
+        return 0;
+    }
+
+    plan = NEURAL_NETWORK_get_plan(instance, height, width);
+    if(plan == NULL){
+        xil_printf("No execution plan for %dx%d \r\n", height, width);
+        return -1;
+    }
 
-        LAYER_update(&(cur_layer->layer), &(prev_layer->layer), height, width);
+    NEURAL_NETWORK_apply_plan(instance, plan);
 
-        // jumping to next laer
-        prev_layer = cur_layer;
-        cur_layer  = cur_layer->next;
-        
+    return 0;
+}
+
+int NEURAL_NETWORK_prepare_plans(NeuralNetwork *instance, const u32 *heights, const u32 *widths, u32 count){
+    int ret = 0;
+
+    for(u32 index = 0; index < count; index++){
+        if(NEURAL_NETWORK_get_plan(instance, heights[index], widths[index]) == NULL){
+            xil_printf("Plan build failed for %dx%d \r\n", heights[index], widths[index]);
+            ret = -1;
+        }
     }
+
+    return ret;
 }
 
 // int NEURAL_NETWORK_predict(NeuralNetwork *instance){
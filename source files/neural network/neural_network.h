@@ -4,6 +4,7 @@
 #include "xil_types.h"
 #include "layer.h"
 #include "net_engine.h"
+#include "execution_plan.h"
 
 typedef enum{
     NN_STATE_NOT_STARTED,
@@ -12,12 +13,25 @@ typedef enum{
     NN_STATE_ERROR,
 }NN_STATE;
 
+typedef int (NN_Layer_Done_cb)(const Layer *layer, void *context);
+
 typedef struct NN_Layer_Node_{
     struct NN_Layer_Node *next;
     struct NN_Layer_Node *prev;
     Layer                layer;
 } NN_Layer_Node;
 
+// a layer as the CPU executors see it, see NEURAL_NETWORK_layer_info
+typedef struct NN_Layer_Info_{
+    Layer  *layer;
+    int     source;             // layer feeding this one, -1 for the network input
+    u8      head;               // no other layer reads it
+    u32     in_channels;
+    u32     out_channels;
+    u32     kernal_size;        // 0 for layer types without a window
+    u32     stride;
+} NN_Layer_Info;
+
 
 typedef struct NeuralNetwork {
     NN_Layer_Node *layers;
@@ -26,16 +40,71 @@ typedef struct NeuralNetwork {
     u32 *receive_memory_ptr;        
     NN_STATE status;
     Net_Engine_Inst net_engine;
+    Plan_Cache      plan_cache;
+    Execution_Plan *active_plan;
 } NeuralNetwork;
 
 int NEURAL_NETWORK_init(NeuralNetwork **instance, u32 *receive_memory_ptr);
 
+// returns the layer as held by the network, valid for the network's lifetime
 Layer* NEURAL_NETWORK_add_layer(NeuralNetwork *instance, LAYER_TYPE type, Layer_init_cb init_cb, Layer *prev_layer, u32* memory_ptr, u32 memory_len, LAYER_ACTIVATION activation);
 
 int NEURAL_NETWORK_layer_link(NeuralNetwork *instance);
 
+/**
+ * Fills info with the network's layers in order and returns how many there
+ * are, -1 for more than max_layers layers, more than max_channels channels
+ * on a layer or a pooling layer without outputs.
+ */
+int NEURAL_NETWORK_layer_info(NeuralNetwork *instance, NN_Layer_Info *info, u32 max_layers, u32 max_channels);
+
+/**
+ * Points the layers reading the network input at planes (one per input
+ * channel), e.g. to alternate between double buffered resized levels.
+ */
+int NEURAL_NETWORK_set_input(NeuralNetwork *instance, u32 *const *planes, u32 count);
+
 int NEURAL_NETWORK_update(NeuralNetwork *instance, int height, int width);
 
+int NEURAL_NETWORK_prepare_plans(NeuralNetwork *instance, const u32 *heights, const u32 *widths, u32 count);
+
 int NEURAL_NETWORK_process(NeuralNetwork *instance);
 
+/**
+ * NEURAL_NETWORK_process calling layer_done after every layer, while that
+ * layer's outputs are still in their memory pool. A non zero return stops
+ * the pass.
+ */
+int NEURAL_NETWORK_process_cb(NeuralNetwork *instance, NN_Layer_Done_cb *layer_done, void *context);
+
+/**
+ * One pass like NEURAL_NETWORK_process that stores the time of layer i in
+ * ns[i] (up to count layers). The layers run without their log line, which
+ * would otherwise dominate the small ones.
+ */
+int NEURAL_NETWORK_time_layers(NeuralNetwork *instance, u64 *ns, u32 count);
+
+/**
+ * Runs count frames of the active plan's size in one pass. Frame b of the
+ * network input starts input_stride u32 words after frame 0, every layer
+ * keeps frame b of its outputs plan frame_stride * b words into its pool,
+ * so the pools have to hold count frames. The Net Engine loads each kernel
+ * once for the whole batch, CPU layers run frame by frame.
+ */
+int NEURAL_NETWORK_process_batch(NeuralNetwork *instance, u32 count, u32 input_stride);
+
+/**
+ * NEURAL_NETWORK_process_batch calling layer_done after every layer, with
+ * all count frames of that layer in its pool (frame b batch.out_stride * b
+ * words into each channel).
+ */
+int NEURAL_NETWORK_process_batch_cb(NeuralNetwork *instance, u32 count, u32 input_stride, NN_Layer_Done_cb *layer_done, void *context);
+
+/**
+ * Moves every 3x3 layer to backend at every size: it becomes the layers'
+ * default_backend and the entries BACKEND_autotune wrote into the cached
+ * plans are cleared.
+ */
+int NEURAL_NETWORK_set_conv_backend(NeuralNetwork *instance, CONV_BACKEND backend);
+
 #endif // NEURAL_NETWORK_H
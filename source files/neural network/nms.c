@@ -0,0 +1,185 @@
+#include "nms.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NMS_NONE    0xFFFFFFFFu
+
+int NMS_init(Nms *instance, void *memory, u32 memory_len){
+    u32 capacity = memory_len / NMS_BYTES_PER_BOX;
+    u8 *cursor   = (u8*)memory;
+
+    if(memory == NULL || capacity == 0){
+        return -1;
+    }
+
+    instance->capacity = capacity;
+    instance->keys     = (Nms_Key*)cursor;  cursor += capacity * sizeof(Nms_Key);
+    instance->x1       = (float*)cursor;    cursor += capacity * sizeof(float);
+    instance->y1       = (float*)cursor;    cursor += capacity * sizeof(float);
+    instance->x2       = (float*)cursor;    cursor += capacity * sizeof(float);
+    instance->y2       = (float*)cursor;    cursor += capacity * sizeof(float);
+    instance->area     = (float*)cursor;    cursor += capacity * sizeof(float);
+    instance->kept     = (u32*)cursor;      cursor += capacity * sizeof(u32);
+    instance->next     = (u32*)cursor;      cursor += capacity * sizeof(u32);
+    instance->scratch  = (u32*)cursor;
+
+    return 0;
+}
+
+// descending score, ties in buffer order so the result does not depend on qsort
+static int NMS_compare(const void *a, const void *b){
+    const Nms_Key *key_a = (const Nms_Key*)a;
+    const Nms_Key *key_b = (const Nms_Key*)b;
+
+    if(key_a->score != key_b->score){
+        return (key_a->score > key_b->score) ? -1 : 1;
+    }
+    return (key_a->index < key_b->index) ? -1 : (key_a->index > key_b->index);
+}
+
+typedef struct{
+    float origin_x;
+    float origin_y;
+    float inv_side;
+} Nms_Grid;
+
+// cells at least as wide as the largest box, so overlapping boxes sit in neighbouring cells
+static void NMS_grid_init(Nms *instance, const BoundingBox_Buffer *boxes, Nms_Grid *grid){
+    float min_x = boxes->q1_x[0];
+    float min_y = boxes->q1_y[0];
+    float max_x = min_x;
+    float max_y = min_y;
+    float side  = 0.0f;
+
+    for(u32 box = 0; box < boxes->count; box++){
+        min_x = (boxes->q1_x[box] < min_x) ? boxes->q1_x[box] : min_x;
+        min_y = (boxes->q1_y[box] < min_y) ? boxes->q1_y[box] : min_y;
+        max_x = (boxes->q1_x[box] > max_x) ? boxes->q1_x[box] : max_x;
+        max_y = (boxes->q1_y[box] > max_y) ? boxes->q1_y[box] : max_y;
+        side  = (boxes->q2_x[box] - boxes->q1_x[box] > side) ? boxes->q2_x[box] - boxes->q1_x[box] : side;
+        side  = (boxes->q2_y[box] - boxes->q1_y[box] > side) ? boxes->q2_y[box] - boxes->q1_y[box] : side;
+    }
+
+    // and wide enough that the corners span at most the grid
+    if((max_x - min_x) / (NMS_GRID_SIDE - 1) > side){
+        side = (max_x - min_x) / (NMS_GRID_SIDE - 1);
+    }
+    if((max_y - min_y) / (NMS_GRID_SIDE - 1) > side){
+        side = (max_y - min_y) / (NMS_GRID_SIDE - 1);
+    }
+
+    grid->origin_x = min_x;
+    grid->origin_y = min_y;
+    grid->inv_side = (side > 0.0f) ? 1.0f / side : 1.0f;
+
+    for(u32 cell = 0; cell < NMS_GRID_SIDE * NMS_GRID_SIDE; cell++){
+        instance->cells[cell] = NMS_NONE;
+    }
+}
+
+static u32 NMS_grid_cell(const Nms_Grid *grid, float origin, float value){
+    s32 cell = (s32)((value - origin) * grid->inv_side);
+
+    if(cell < 0){
+        return 0;
+    }
+    return ((u32)cell < NMS_GRID_SIDE) ? (u32)cell : NMS_GRID_SIDE - 1;
+}
+
+// non zero when a kept box in the 3x3 cells around (cell_x, cell_y) overlaps the candidate too much
+static int NMS_grid_overlaps(const Nms *instance, u32 cell_x, u32 cell_y, float x1, float y1, float x2, float y2, float threshold){
+    u32 first_y = (cell_y > 0) ? cell_y - 1 : 0;
+    u32 first_x = (cell_x > 0) ? cell_x - 1 : 0;
+    u32 last_y  = (cell_y + 1 < NMS_GRID_SIDE) ? cell_y + 1 : cell_y;
+    u32 last_x  = (cell_x + 1 < NMS_GRID_SIDE) ? cell_x + 1 : cell_x;
+
+    for(u32 y = first_y; y <= last_y; y++){
+        for(u32 x = first_x; x <= last_x; x++){
+            for(u32 kept = instance->cells[(y * NMS_GRID_SIDE) + x]; kept != NMS_NONE; kept = instance->next[kept]){
+                if(KERNEL_iou_first_over(x1, y1, x2, y2, &instance->x1[kept], &instance->y1[kept], &instance->x2[kept],
+                                         &instance->y2[kept], &instance->area[kept], 1, threshold) == 0){
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// keeps the fields of the kept boxes, in kept order
+static void NMS_compact(Nms *instance, BoundingBox_Buffer *boxes, u32 count){
+    u32 *fields[BBOX_FIELDS] = {
+        boxes->cell,          (u32*)boxes->score, (u32*)boxes->nscore, (u32*)boxes->q1_x,
+        (u32*)boxes->q1_y,    (u32*)boxes->q2_x,  (u32*)boxes->q2_y,   (u32*)boxes->dx1,
+        (u32*)boxes->dy1,     (u32*)boxes->dx2,   (u32*)boxes->dy2,
+    };
+
+    for(u32 field = 0; field < BBOX_FIELDS; field++){
+        for(u32 box = 0; box < count; box++){
+            instance->scratch[box] = fields[field][instance->kept[box]];
+        }
+        memcpy(fields[field], instance->scratch, count * sizeof(u32));
+    }
+}
+
+u32 NMS_run(Nms *instance, BoundingBox_Buffer *boxes, float threshold, NMS_MODE mode){
+    Nms_Grid grid;
+    u32 count = 0;
+    u32 cell_x = 0;
+    u32 cell_y = 0;
+    u32 box;
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+
+    if(boxes->count == 0 || boxes->count > instance->capacity){
+        return boxes->count;
+    }
+
+    for(box = 0; box < boxes->count; box++){
+        instance->keys[box].score = boxes->score[box];
+        instance->keys[box].index = box;
+    }
+    qsort(instance->keys, boxes->count, sizeof(Nms_Key), NMS_compare);
+
+    if(mode == NMS_MODE_GRID){
+        NMS_grid_init(instance, boxes, &grid);
+    }
+
+    for(u32 rank = 0; rank < boxes->count; rank++){
+        box = instance->keys[rank].index;
+        x1  = boxes->q1_x[box];
+        y1  = boxes->q1_y[box];
+        x2  = boxes->q2_x[box];
+        y2  = boxes->q2_y[box];
+
+        if(mode == NMS_MODE_GRID){
+            cell_x = NMS_grid_cell(&grid, grid.origin_x, x1);
+            cell_y = NMS_grid_cell(&grid, grid.origin_y, y1);
+            if(NMS_grid_overlaps(instance, cell_x, cell_y, x1, y1, x2, y2, threshold)){
+                continue;
+            }
+            instance->next[count] = instance->cells[(cell_y * NMS_GRID_SIDE) + cell_x];
+            instance->cells[(cell_y * NMS_GRID_SIDE) + cell_x] = count;
+        }
+        else if(KERNEL_iou_first_over(x1, y1, x2, y2, instance->x1, instance->y1, instance->x2, instance->y2,
+                                      instance->area, count, threshold) != count){
+            continue;
+        }
+
+        instance->x1[count]   = x1;
+        instance->y1[count]   = y1;
+        instance->x2[count]   = x2;
+        instance->y2[count]   = y2;
+        instance->area[count] = (x2 - x1) * (y2 - y1);
+        instance->kept[count] = box;
+        count++;
+    }
+
+    NMS_compact(instance, boxes, count);
+    boxes->count = count;
+
+    return count;
+}
@@ -0,0 +1,56 @@
+
+#ifndef NET_ENGINE_NMS_H
+#define NET_ENGINE_NMS_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "utility.h"
+
+/**************************** Type Definitions *****************************/
+#define NMS_GRID_SIDE       16      // cells per side of the NMS_MODE_GRID bucket grid
+#define NMS_BYTES_PER_BOX   40
+
+typedef enum{
+    NMS_MODE_SORTED,        // every candidate against every kept box, 4 at a time
+    NMS_MODE_GRID,          // only against kept boxes in the neighbouring grid cells, for crowded frames
+} NMS_MODE;
+
+typedef struct{
+    float score;
+    u32   index;
+} Nms_Key;
+
+// scratch for suppressing up to capacity boxes, no allocation per call
+typedef struct Nms_{
+    u32      capacity;
+    Nms_Key *keys;          // candidates by descending score
+    float   *x1;            // kept boxes, contiguous in score order
+    float   *y1;
+    float   *x2;
+    float   *y2;
+    float   *area;
+    u32     *kept;          // buffer index of each kept box
+    u32     *next;          // NMS_MODE_GRID: next kept box in the same cell
+    u32     *scratch;       // field compaction
+    u32      cells[NMS_GRID_SIDE * NMS_GRID_SIDE];
+} Nms;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * memory_len bytes hold the scratch for memory_len / NMS_BYTES_PER_BOX
+ * boxes.
+ */
+int NMS_init(Nms *instance, void *memory, u32 memory_len);
+
+/**
+ * Greedy non maximum suppression: candidates are sorted by score once,
+ * each one is kept unless its IoU with a box kept before it is above
+ * threshold. The survivors replace the buffer's contents in descending
+ * score order. Returns the number kept, or the unchanged count when the
+ * buffer holds more boxes than the scratch. Both modes keep the same boxes.
+ */
+u32 NMS_run(Nms *instance, BoundingBox_Buffer *boxes, float threshold, NMS_MODE mode);
+
+#endif // NET_ENGINE_NMS_H
@@ -0,0 +1,181 @@
+#include "prepack.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <xil_printf.h>
+
+static float PREPACK_float(u32 word){
+    float value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+// U = G g G^T with G = [1 0 0; 1/2 1/2 1/2; 1/2 -1/2 1/2; 0 0 1]
+static void PREPACK_winograd_kernel(const float *g, float *u){
+    float t[4][3];
+
+    for(u32 n = 0; n < 3; n++){
+        t[0][n] = g[n];
+        t[1][n] = 0.5f * (g[n] + g[3 + n] + g[6 + n]);
+        t[2][n] = 0.5f * (g[n] - g[3 + n] + g[6 + n]);
+        t[3][n] = g[6 + n];
+    }
+    for(u32 m = 0; m < 4; m++){
+        u[(m * 4) + 0] = t[m][0];
+        u[(m * 4) + 1] = 0.5f * (t[m][0] + t[m][1] + t[m][2]);
+        u[(m * 4) + 2] = 0.5f * (t[m][0] - t[m][1] + t[m][2]);
+        u[(m * 4) + 3] = t[m][2];
+    }
+}
+
+static void PREPACK_kernel(Prepacked_Conv *instance, u32 out, u32 in, u32 slot, const Channel_Kernal_Data *kernal){
+    const u32 *taps = &kernal->Kernal.Kernal_1;
+    u32   *words = instance->engine + (((out * instance->in_channels) + slot) * PREPACK_ENGINE_WORDS);
+    float *panel = instance->panels + ((((out / KERNEL_CONV_LANES) * instance->in_channels) + in) * 9 * KERNEL_CONV_LANES);
+    float  g[9];
+
+    instance->engine_inputs[(out * instance->in_channels) + slot] = (u16)in;
+    words[0] = kernal->Bias;
+    for(u32 tap = 0; tap < 9; tap++){
+        words[1 + tap] = taps[tap];
+        g[tap] = PREPACK_float(taps[tap]);
+        panel[(tap * KERNEL_CONV_LANES) + (out % KERNEL_CONV_LANES)] = g[tap];
+    }
+
+    PREPACK_winograd_kernel(g, instance->winograd + (((out * instance->in_channels) + in) * KERNEL_WINOGRAD_TILE));
+    instance->bias[out] += PREPACK_float(kernal->Bias);
+}
+
+static float PREPACK_panel_weight(const Prepacked_Conv *instance, u32 out, u32 in, u32 tap){
+    return instance->panels[((((out / KERNEL_CONV_LANES) * instance->in_channels) + in) * 9 * KERNEL_CONV_LANES) +
+                            (tap * KERNEL_CONV_LANES) + (out % KERNEL_CONV_LANES)];
+}
+
+// nonzero taps per output channel, pruned kernels and zero taps are left out
+static int PREPACK_sparse(Prepacked_Conv *instance){
+    u32 count = 0;
+
+    for(u32 index = 0; index < instance->out_channels * instance->in_channels * 9; index++){
+        if(PREPACK_panel_weight(instance, index / (instance->in_channels * 9), (index / 9) % instance->in_channels, index % 9) != 0.0f){
+            count++;
+        }
+    }
+
+    instance->sparse_start  = (u32*)  malloc((instance->out_channels + 1) * sizeof(u32));
+    instance->sparse_tap    = (u16*)  malloc((count + 1) * sizeof(u16));
+    instance->sparse_weight = (float*)malloc((count + 1) * sizeof(float));
+    if(instance->sparse_start == NULL || instance->sparse_tap == NULL || instance->sparse_weight == NULL){
+        return -1;
+    }
+
+    count = 0;
+    for(u32 out = 0; out < instance->out_channels; out++){
+        instance->sparse_start[out] = count;
+        for(u32 in = 0; in < instance->in_channels; in++){
+            for(u32 tap = 0; tap < 9; tap++){
+                float weight = PREPACK_panel_weight(instance, out, in, tap);
+                if(weight != 0.0f){
+                    instance->sparse_tap[count]    = (u16)((in * 9) + tap);
+                    instance->sparse_weight[count] = weight;
+                    count++;
+                }
+            }
+        }
+    }
+    instance->sparse_start[instance->out_channels] = count;
+    instance->sparse_count = count;
+
+    return 0;
+}
+
+Prepacked_Conv* PREPACK_conv3x3(const Layer *layer){
+    Prepacked_Conv *instance;
+    Channel_Node   *channel;
+    Channel_Kernal_Data_Node *kernal;
+    u32 in_channels  = layer->input_channels.count;
+    u32 out_channels = layer->output_channels.count;
+    u32 blocks = (out_channels + KERNEL_CONV_LANES - 1) / KERNEL_CONV_LANES;
+    u32 out;
+
+    if(layer->type != LAYER_TYPE_CNN_3X3 || in_channels == 0 || out_channels == 0){
+        return NULL;
+    }
+
+    instance = (Prepacked_Conv*)calloc(1, sizeof(Prepacked_Conv));
+    if(instance == NULL){
+        return NULL;
+    }
+
+    instance->in_channels  = in_channels;
+    instance->out_channels = out_channels;
+    instance->engine   = (u32*)  calloc(out_channels * in_channels * PREPACK_ENGINE_WORDS, sizeof(u32));
+    instance->engine_inputs = (u16*)malloc(out_channels * in_channels * sizeof(u16));
+    instance->panels   = (float*)calloc(blocks * in_channels * 9 * KERNEL_CONV_LANES, sizeof(float));
+    instance->winograd = (float*)calloc(out_channels * in_channels * KERNEL_WINOGRAD_TILE, sizeof(float));
+    instance->bias     = (float*)calloc(out_channels, sizeof(float));
+    instance->scratch  = (float*)malloc(KERNEL_winograd_scratch_size(in_channels, PREPACK_MAX_WIDTH) * sizeof(float));
+    if(layer->activation == LAYER_ACTIVATION_RELU){
+        instance->alpha = (float*)malloc(out_channels * sizeof(float));
+    }
+
+    if(instance->engine == NULL || instance->engine_inputs == NULL || instance->panels == NULL || instance->winograd == NULL || instance->bias == NULL ||
+       instance->scratch == NULL || (layer->activation == LAYER_ACTIVATION_RELU && instance->alpha == NULL)){
+        xil_printf("Prepack malloc failed \r\n");
+        PREPACK_free(instance);
+        return NULL;
+    }
+
+    for(u32 slot = 0; slot < out_channels * in_channels; slot++){
+        instance->engine_inputs[slot] = (u16)in_channels;
+    }
+
+    // a kernel node's input channel is the channel it references, see LAYER_add_cnn_output_channels
+    channel = layer->output_channels.channels;
+    for(out = 0; channel != NULL && out < out_channels; out++, channel = (Channel_Node*)channel->next){
+        u32 slot = 0;
+
+        for(kernal = channel->data.cnn_data.kernal_node; kernal != NULL; kernal = (Channel_Kernal_Data_Node*)kernal->next){
+            u32 in = ((const Channel*)kernal->data.reference)->index;
+
+            if(slot == in_channels || in >= in_channels){
+                xil_printf("Prepack: channel %d has a kernel for input %d of %d \r\n", out, in, in_channels);
+                PREPACK_free(instance);
+                return NULL;
+            }
+            PREPACK_kernel(instance, out, in, slot++, &kernal->data);
+        }
+
+        if(instance->alpha != NULL){
+            instance->alpha[out] = channel->data.data.relu_data.alpha;
+        }
+    }
+
+    if(PREPACK_sparse(instance) != 0){
+        xil_printf("Prepack malloc failed \r\n");
+        PREPACK_free(instance);
+        return NULL;
+    }
+
+    return instance;
+}
+
+const u32* PREPACK_engine_words(const Prepacked_Conv *instance, u32 out_channel){
+    return instance->engine + (out_channel * instance->in_channels * PREPACK_ENGINE_WORDS);
+}
+
+void PREPACK_free(Prepacked_Conv *instance){
+    if(instance == NULL){
+        return;
+    }
+    free(instance->engine);
+    free(instance->engine_inputs);
+    free(instance->panels);
+    free(instance->winograd);
+    free(instance->bias);
+    free(instance->alpha);
+    free(instance->scratch);
+    free(instance->sparse_start);
+    free(instance->sparse_tap);
+    free(instance->sparse_weight);
+    free(instance);
+}
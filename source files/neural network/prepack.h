@@ -0,0 +1,45 @@
+
+#ifndef NET_ENGINE_PREPACK_H
+#define NET_ENGINE_PREPACK_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "layer.h"
+
+/**************************** Type Definitions *****************************/
+#define PREPACK_ENGINE_WORDS    NET_ENGINE_CNN_CONFIG_WORDS     // Bias, Kernal_1..Kernal_9 in register order
+#define PREPACK_MAX_WIDTH       MAX_IMAGE_SIZE
+
+// a 3x3 layer's weights rearranged once at load time for every backend
+typedef struct Prepacked_Conv_{
+    u32    in_channels;
+    u32    out_channels;
+    u32   *engine;              // [out][in][PREPACK_ENGINE_WORDS] raw register words
+    u16   *engine_inputs;       // [out][in] input channel of each engine word slot, in_channels when unused
+    float *panels;              // [out / KERNEL_CONV_LANES][in][9][KERNEL_CONV_LANES], padded with zeros
+    float *winograd;            // [out][in][KERNEL_WINOGRAD_TILE], U = G g G^T
+    float *bias;                // [out], per input biases folded together
+    float *alpha;               // [out] PReLU slopes, NULL without activation
+    float *scratch;             // winograd input tiles for one row of tiles
+    u32   *sparse_start;        // [out + 1] first nonzero tap of each output channel
+    u16   *sparse_tap;          // (in * 9) + tap of every nonzero tap, in input channel order
+    float *sparse_weight;       // the taps' weights
+    u32    sparse_count;        // nonzero taps of the layer
+} Prepacked_Conv;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Packs the kernels of a built 3x3 layer. The layer's own kernel nodes are
+ * left untouched, so a layer without a pack still runs the per kernel path.
+ * A channel may leave out (pruned) input channels, they pack as zeros and
+ * the engine words of its kernels follow the order of its kernel nodes.
+ */
+Prepacked_Conv* PREPACK_conv3x3(const Layer *layer);
+
+const u32* PREPACK_engine_words(const Prepacked_Conv *instance, u32 out_channel);
+
+void PREPACK_free(Prepacked_Conv *instance);
+
+#endif // NET_ENGINE_PREPACK_H
@@ -0,0 +1,197 @@
+#include "profiler.h"
+#include "time_measure.h"
+#include <string.h>
+#include <xil_printf.h>
+
+#ifdef __linux__
+#include <time.h>
+#else
+#include "xtime_l.h"
+#include "xparameters.h"
+#endif
+
+static Profiler_Scope PROFILER_scopes[PROFILER_MAX_SCOPES];
+static u32            PROFILER_scope_count;
+static u32            PROFILER_sorted[PROFILER_RING_SIZE];
+
+// registered by PROFILER_init in TIME_MEASURE_SIGNAL_* order
+static const char *const PROFILER_signal_names[] = {
+    "network",                  // TIME_MEASURE_SIGNAL_0
+    "layer",                    // TIME_MEASURE_SIGNAL_1
+    "channel",                  // TIME_MEASURE_SIGNAL_2
+    "kernel",                   // TIME_MEASURE_SIGNAL_3
+    "row isr / post",           // TIME_MEASURE_SIGNAL_4
+};
+
+#if defined(PROFILER_USE_PMU) && !defined(__linux__)
+static void PROFILER_pmu_enable(void){
+    u32 value;
+
+    // PMCR: enable counters, reset the cycle counter, no divider
+    __asm__ volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(value));
+    value |= 0x5;
+    value &= ~0x8;
+    __asm__ volatile("mcr p15, 0, %0, c9, c12, 0" :: "r"(value));
+    // PMCNTENSET: cycle counter
+    __asm__ volatile("mcr p15, 0, %0, c9, c12, 1" :: "r"(0x80000000));
+}
+#endif
+
+u64 PROFILER_now(void){
+#ifdef __linux__
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((u64)now.tv_sec * 1000000000ULL) + now.tv_nsec;
+#elif defined(PROFILER_USE_PMU)
+    u32 cycles;
+
+    __asm__ volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles));
+    return cycles;
+#else
+    XTime now;
+
+    XTime_GetTime(&now);
+    return now;
+#endif
+}
+
+u64 PROFILER_ticks_to_ns(u64 ticks){
+#ifdef __linux__
+    return ticks;
+#elif defined(PROFILER_USE_PMU)
+    return (ticks * 1000ULL) / (XPAR_CPU_CORTEXA9_0_CPU_CLK_FREQ_HZ / 1000000);
+#else
+    return (ticks * 1000ULL) / (COUNTS_PER_SECOND / 1000000);
+#endif
+}
+
+void PROFILER_reset(void){
+    for(u32 index = 0; index < PROFILER_scope_count; index++){
+        PROFILER_scopes[index].total = 0;
+        PROFILER_scopes[index].min   = 0xFFFFFFFF;
+        PROFILER_scopes[index].max   = 0;
+        PROFILER_scopes[index].count = 0;
+        PROFILER_scopes[index].head  = 0;
+    }
+}
+
+void PROFILER_init(void){
+#if defined(PROFILER_USE_PMU) && !defined(__linux__)
+    PROFILER_pmu_enable();
+#endif
+
+    PROFILER_scope_count = 0;
+    for(u32 index = 0; index < sizeof(PROFILER_signal_names) / sizeof(PROFILER_signal_names[0]); index++){
+        PROFILER_register(PROFILER_signal_names[index]);
+    }
+}
+
+int PROFILER_register(const char *name){
+    Profiler_Scope *scope;
+
+    for(u32 index = 0; index < PROFILER_scope_count; index++){
+        if(strncmp(PROFILER_scopes[index].name, name, PROFILER_NAME_LEN - 1) == 0){
+            return index;
+        }
+    }
+
+    if(PROFILER_scope_count == PROFILER_MAX_SCOPES){
+        xil_printf("Profiler: no free scope for %s \r\n", name);
+        return -1;
+    }
+
+    scope = &PROFILER_scopes[PROFILER_scope_count];
+    memset(scope, 0, sizeof(Profiler_Scope));
+    strncpy(scope->name, name, PROFILER_NAME_LEN - 1);
+    scope->min = 0xFFFFFFFF;
+
+    return PROFILER_scope_count++;
+}
+
+void PROFILER_begin(u32 scope){
+    if(scope < PROFILER_scope_count){
+        PROFILER_scopes[scope].start = PROFILER_now();
+    }
+}
+
+void PROFILER_end(u32 scope){
+    Profiler_Scope *instance;
+    u32 elapsed;
+
+    if(scope >= PROFILER_scope_count){
+        return;
+    }
+
+    instance = &PROFILER_scopes[scope];
+    // kept in ticks, converted only when the statistics are read
+    elapsed  = (u32)(PROFILER_now() - instance->start);
+
+    instance->total += elapsed;
+    instance->count++;
+    if(elapsed < instance->min){
+        instance->min = elapsed;
+    }
+    if(elapsed > instance->max){
+        instance->max = elapsed;
+    }
+
+    instance->ring[instance->head] = elapsed;
+    instance->head = (instance->head + 1) % PROFILER_RING_SIZE;
+}
+
+static u32 PROFILER_percentile(const Profiler_Scope *instance, u32 percent){
+    u32 count = (instance->count < PROFILER_RING_SIZE) ? instance->count : PROFILER_RING_SIZE;
+    u32 value;
+    int j;
+
+    memcpy(PROFILER_sorted, instance->ring, count * sizeof(u32));
+
+    // insertion sort, at most PROFILER_RING_SIZE samples
+    for(u32 i = 1; i < count; i++){
+        value = PROFILER_sorted[i];
+        for(j = i - 1; j >= 0 && PROFILER_sorted[j] > value; j--){
+            PROFILER_sorted[j + 1] = PROFILER_sorted[j];
+        }
+        PROFILER_sorted[j + 1] = value;
+    }
+
+    return PROFILER_sorted[((count - 1) * percent) / 100];
+}
+
+int PROFILER_get_stats(u32 scope, Profiler_Stats *stats){
+    const Profiler_Scope *instance;
+
+    if(scope >= PROFILER_scope_count || stats == NULL){
+        return -1;
+    }
+
+    instance = &PROFILER_scopes[scope];
+    memset(stats, 0, sizeof(Profiler_Stats));
+    if(instance->count == 0){
+        return 0;
+    }
+
+    stats->count    = instance->count;
+    stats->min_ns   = PROFILER_ticks_to_ns(instance->min);
+    stats->max_ns   = PROFILER_ticks_to_ns(instance->max);
+    stats->total_ns = PROFILER_ticks_to_ns(instance->total);
+    stats->mean_ns  = stats->total_ns / instance->count;
+    stats->p99_ns   = PROFILER_ticks_to_ns(PROFILER_percentile(instance, 99));
+
+    return 0;
+}
+
+void PROFILER_report(void){
+    Profiler_Stats stats;
+
+    xil_printf("Profile (us): scope, count, min, mean, p99, max \r\n");
+    for(u32 index = 0; index < PROFILER_scope_count; index++){
+        PROFILER_get_stats(index, &stats);
+        if(stats.count == 0){
+            continue;
+        }
+        xil_printf("\t%s, %d, %d, %d, %d, %d \r\n", PROFILER_scopes[index].name, stats.count,
+                   stats.min_ns / 1000, stats.mean_ns / 1000, stats.p99_ns / 1000, stats.max_ns / 1000);
+    }
+}
@@ -0,0 +1,67 @@
+
+#ifndef NET_ENGINE_PROFILER_H
+#define NET_ENGINE_PROFILER_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+
+/**************************** Type Definitions *****************************/
+#define PROFILER_MAX_SCOPES     16
+#define PROFILER_RING_SIZE      128     // most recent samples kept per scope for percentiles
+#define PROFILER_NAME_LEN       24
+
+// read the Cortex-A9 PMU cycle counter instead of the global timer on target
+// #define PROFILER_USE_PMU
+
+typedef struct Profiler_Stats_{
+    u32 count;                  // samples since the last reset
+    u32 min_ns;
+    u32 max_ns;
+    u32 mean_ns;
+    u32 p99_ns;                 // over the last PROFILER_RING_SIZE samples
+    u64 total_ns;
+} Profiler_Stats;
+
+typedef struct Profiler_Scope_{
+    char name[PROFILER_NAME_LEN];
+    u64  start;
+    u64  total;
+    u32  min;
+    u32  max;
+    u32  count;
+    u32  head;
+    u32  ring[PROFILER_RING_SIZE];
+} Profiler_Scope;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Starts the time base and registers one scope per TIME_MEASURE_SIGNAL_*,
+ * so scope id (signal - 1) collects whatever measure_start/measure_end
+ * already bracket.
+ */
+void PROFILER_init(void);
+
+/**
+ * Returns the id of the scope called name, registering it on first use,
+ * or -1 when all PROFILER_MAX_SCOPES are taken.
+ */
+int PROFILER_register(const char *name);
+
+u64 PROFILER_now(void);
+
+u64 PROFILER_ticks_to_ns(u64 ticks);
+
+// one interval in flight per scope, begin/end are cheap enough for ISRs
+void PROFILER_begin(u32 scope);
+
+void PROFILER_end(u32 scope);
+
+int PROFILER_get_stats(u32 scope, Profiler_Stats *stats);
+
+void PROFILER_reset(void);
+
+void PROFILER_report(void);
+
+#endif // NET_ENGINE_PROFILER_H
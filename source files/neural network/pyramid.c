@@ -0,0 +1,182 @@
+#include "pyramid.h"
+#include "kernels.h"
+#include <math.h>
+#include <xil_printf.h>
+
+static void PYRAMID_build_taps(Pyramid_Tap *taps, u32 src_size, u32 size){
+    int   index;
+    float position;
+
+    for(u32 i = 0; i < size; i++){
+        // same positions as image_resize, but the weight is taken after the
+        // clamp so the last row / column lands on the edge sample
+        position = (size > 1) ? (float)(i * (src_size - 1)) / (size - 1) : 0.0f;
+        index    = (int)position;
+        if(index >= (int)src_size - 1){
+            index = src_size - 2;
+        }
+        taps[i].index  = index;
+        taps[i].weight = position - index;
+    }
+}
+
+int PYRAMID_init(Pyramid *instance, u32 height, u32 width, const float *scales, u32 count, PYRAMID_MODE mode){
+    Pyramid_Level *level;
+    u32 src_height = height;
+    u32 src_width  = width;
+
+    if(count > PYRAMID_MAX_LEVELS || height > PYRAMID_MAX_SIZE || width > PYRAMID_MAX_SIZE){
+        xil_printf("Pyramid: too many levels or frame too large \r\n");
+        return -1;
+    }
+
+    instance->height      = height;
+    instance->width       = width;
+    instance->level_count = count;
+    instance->last_level  = -1;
+    instance->mode        = mode;
+
+    for(u32 index = 0; index < count; index++){
+        level = &instance->levels[index];
+
+        level->height     = roundf(height * scales[index]);
+        level->width      = roundf(width  * scales[index]);
+        level->src_height = src_height;
+        level->src_width  = src_width;
+
+        if(level->height == 0 || level->width == 0 || src_height < 2 || src_width < 2 ||
+           level->height > PYRAMID_MAX_SIZE || level->width > PYRAMID_MAX_SIZE){
+            xil_printf("Pyramid: invalid level %d \r\n", index);
+            return -1;
+        }
+
+        // in place resampling only works while every level shrinks
+        if(mode == PYRAMID_MODE_CHAINED && index > 0 && (level->height > src_height || level->width > src_width)){
+            xil_printf("Pyramid: chained level %d is larger than its source \r\n", index);
+            return -1;
+        }
+
+        PYRAMID_build_taps(level->x_taps, src_width,  level->width);
+        PYRAMID_build_taps(level->y_taps, src_height, level->height);
+
+        if(mode == PYRAMID_MODE_CHAINED){
+            src_height = level->height;
+            src_width  = level->width;
+        }
+    }
+
+    return 0;
+}
+
+int PYRAMID_level_shape(const Pyramid *instance, u32 level, u32 *height, u32 *width){
+    if(level >= instance->level_count){
+        return -1;
+    }
+
+    *height = instance->levels[level].height;
+    *width  = instance->levels[level].width;
+    return 0;
+}
+
+// horizontal pass of one source row of every plane into cache slot (row & 1)
+static void PYRAMID_filter_row(Pyramid *instance, const Pyramid_Level *level, float *const *source, u32 row){
+    u32   slot = row & 1;
+    const float *src[PYRAMID_PLANES];
+    float *dst[PYRAMID_PLANES];
+    const Pyramid_Tap *tap;
+
+    if(instance->rows.tag[slot] == (int)row){
+        return;
+    }
+
+    for(u32 plane = 0; plane < PYRAMID_PLANES; plane++){
+        src[plane] = source[plane] + (row * level->src_width);
+        dst[plane] = instance->rows.data[plane][slot];
+    }
+
+    for(u32 x = 0; x < level->width; x++){
+        tap = &level->x_taps[x];
+        for(u32 plane = 0; plane < PYRAMID_PLANES; plane++){
+            dst[plane][x] = src[plane][tap->index] * (1 - tap->weight) + src[plane][tap->index + 1] * tap->weight;
+        }
+    }
+
+    instance->rows.tag[slot] = row;
+}
+
+static void PYRAMID_blend_rows(const float *top, const float *bottom, float *output, u32 width, float weight){
+    u32 x = 0;
+
+#ifdef KERNEL_USE_NEON
+    float32x4_t top_weight    = vdupq_n_f32(1 - weight);
+    float32x4_t bottom_weight = vdupq_n_f32(weight);
+    float32x4_t value;
+
+    for(; x + 4 <= width; x += 4){
+        value = vmulq_f32(vld1q_f32(top + x), top_weight);
+        value = vmlaq_f32(value, vld1q_f32(bottom + x), bottom_weight);
+        vst1q_f32(output + x, value);
+    }
+#endif
+
+    for(; x < width; x++){
+        output[x] = top[x] * (1 - weight) + bottom[x] * weight;
+    }
+}
+
+int PYRAMID_build_rows(Pyramid *instance, u32 level_index, float *const frame[PYRAMID_PLANES], float *const output[PYRAMID_PLANES],
+                       u32 first_row, u32 row_count){
+    const Pyramid_Level *level;
+    const Pyramid_Tap   *tap;
+    float *const        *source = frame;
+    u32 top_slot;
+    u32 last_row;
+
+    if(level_index >= instance->level_count){
+        return -1;
+    }
+
+    if(instance->mode == PYRAMID_MODE_CHAINED && level_index > 0){
+        if(instance->last_level != (int)level_index - 1){
+            xil_printf("Pyramid: level %d built out of order \r\n", level_index);
+            return -1;
+        }
+        source = output;
+    }
+
+    level = &instance->levels[level_index];
+    if(first_row >= level->height){
+        return -1;
+    }
+    last_row = (row_count < level->height - first_row) ? first_row + row_count : level->height;
+
+    // the row cache carries over between calls for the same level
+    if(first_row == 0){
+        instance->rows.tag[0] = -1;
+        instance->rows.tag[1] = -1;
+    }
+
+    // source rows are cached before output row y is written and later rows
+    // only read source rows >= y, so shrinking in place never reads a
+    // row that has already been overwritten
+    for(u32 y = first_row; y < last_row; y++){
+        tap = &level->y_taps[y];
+        PYRAMID_filter_row(instance, level, source, tap->index);
+        PYRAMID_filter_row(instance, level, source, tap->index + 1);
+
+        top_slot = tap->index & 1;
+        for(u32 plane = 0; plane < PYRAMID_PLANES; plane++){
+            PYRAMID_blend_rows(instance->rows.data[plane][top_slot], instance->rows.data[plane][top_slot ^ 1],
+                               output[plane] + (y * level->width), level->width, tap->weight);
+        }
+    }
+
+    if(last_row == level->height){
+        instance->last_level = level_index;
+    }
+    return 0;
+}
+
+int PYRAMID_build_level(Pyramid *instance, u32 level_index, float *const frame[PYRAMID_PLANES], float *const output[PYRAMID_PLANES]){
+    return PYRAMID_build_rows(instance, level_index, frame, output, 0, PYRAMID_MAX_SIZE);
+}
@@ -0,0 +1,75 @@
+
+#ifndef NET_ENGINE_PYRAMID_H
+#define NET_ENGINE_PYRAMID_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+
+/**************************** Type Definitions *****************************/
+#define PYRAMID_MAX_LEVELS  8
+#define PYRAMID_MAX_SIZE    640     // widest / tallest frame the tap tables cover
+#define PYRAMID_PLANES      3       // red, green, blue
+
+typedef enum{
+    PYRAMID_MODE_DIRECT,            // every level is resampled from the full frame
+    PYRAMID_MODE_CHAINED,           // every level is resampled from the level before it, in place
+} PYRAMID_MODE;
+
+// bilinear tap: sample = src[index] * (1 - weight) + src[index + 1] * weight
+typedef struct Pyramid_Tap_{
+    u16   index;
+    float weight;
+} Pyramid_Tap;
+
+typedef struct Pyramid_Level_{
+    u32 src_height;
+    u32 src_width;
+    u32 height;
+    u32 width;
+    Pyramid_Tap x_taps[PYRAMID_MAX_SIZE];
+    Pyramid_Tap y_taps[PYRAMID_MAX_SIZE];
+} Pyramid_Level;
+
+typedef struct Pyramid_{
+    u32 height;
+    u32 width;
+    u32 level_count;
+    int last_level;
+    PYRAMID_MODE mode;
+    Pyramid_Level levels[PYRAMID_MAX_LEVELS];
+    struct{
+        int   tag[2];
+        float data[PYRAMID_PLANES][2][PYRAMID_MAX_SIZE];
+    } rows;
+} Pyramid;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Precomputes the level sizes and the horizontal / vertical tap tables for
+ * each scale. Sizes and sample positions match image_resize (corner aligned,
+ * size = round(dim * scale)). Chained mode needs strictly shrinking scales.
+ */
+int PYRAMID_init(Pyramid *instance, u32 height, u32 width, const float *scales, u32 count, PYRAMID_MODE mode);
+
+int PYRAMID_level_shape(const Pyramid *instance, u32 level, u32 *height, u32 *width);
+
+/**
+ * Resamples all planes of one level in a single pass: each source row is
+ * filtered horizontally once into a two-row cache, then output rows are
+ * blended vertically. In chained mode, levels above 0 read the previous
+ * level from output and overwrite it in place, so levels must be built in
+ * order and output must still hold the previous level.
+ */
+int PYRAMID_build_level(Pyramid *instance, u32 level, float *const frame[PYRAMID_PLANES], float *const output[PYRAMID_PLANES]);
+
+/**
+ * Builds output rows [first_row, first_row + row_count) of a level, so a
+ * level can be resampled in slices. Slices of one level have to come in
+ * order starting at row 0, without another level built in between.
+ */
+int PYRAMID_build_rows(Pyramid *instance, u32 level, float *const frame[PYRAMID_PLANES], float *const output[PYRAMID_PLANES],
+                       u32 first_row, u32 row_count);
+
+#endif // NET_ENGINE_PYRAMID_H
@@ -0,0 +1,387 @@
+#include "quantize.h"
+#include "kernels.h"
+#include "prepack.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xil_printf.h>
+
+static float QUANT_weight_scale(float max_value){
+    return (max_value > 0.0f) ? max_value / QUANT_WEIGHT_LEVELS : 1.0f;
+}
+
+static s8 QUANT_weight(float value, float scale){
+    float q = roundf(value / scale);
+    return (s8)((q > QUANT_WEIGHT_LEVELS) ? QUANT_WEIGHT_LEVELS : (q < -QUANT_WEIGHT_LEVELS) ? -QUANT_WEIGHT_LEVELS : q);
+}
+
+// the range always holds 0, so zero is exact and the zero point fits s8
+static void QUANT_activation(float min_value, float max_value, float *scale, s32 *zero_point){
+    min_value = (min_value < 0.0f) ? min_value : 0.0f;
+    max_value = (max_value > 0.0f) ? max_value : 0.0f;
+
+    *scale      = (max_value > min_value) ? (max_value - min_value) / QUANT_LEVELS : 1.0f;
+    *zero_point = QUANT_MIN - (s32)roundf(min_value / *scale);
+    if(*zero_point > QUANT_MAX){
+        *zero_point = QUANT_MAX;
+    }
+}
+
+static void QUANT_plane_range(const float *plane, u32 count, float *min_value, float *max_value){
+    for(u32 i = 0; i < count; i++){
+        if(plane[i] < *min_value){
+            *min_value = plane[i];
+        }
+        if(plane[i] > *max_value){
+            *max_value = plane[i];
+        }
+    }
+}
+
+void QUANT_calibration_init(Quant_Calibration *instance){
+    instance->layer_count = 0;
+    instance->samples     = 0;
+    instance->input_min   = 0.0f;
+    instance->input_max   = 0.0f;
+    for(u32 index = 0; index < QUANT_MAX_LAYERS; index++){
+        instance->layer_min[index] = 0.0f;
+        instance->layer_max[index] = 0.0f;
+    }
+}
+
+static int QUANT_calibrate_layer(const Layer *layer, void *context){
+    Quant_Calibration *instance = (Quant_Calibration*)context;
+    Channel_Node *channel;
+
+    if(layer->index >= QUANT_MAX_LAYERS){
+        return -1;
+    }
+
+    for(channel = layer->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        QUANT_plane_range((const float*)channel->data.output_ptr, channel->data.height * channel->data.width,
+                          &instance->layer_min[layer->index], &instance->layer_max[layer->index]);
+    }
+    if(layer->index >= instance->layer_count){
+        instance->layer_count = layer->index + 1;
+    }
+
+    return 0;
+}
+
+int QUANT_calibrate(Quant_Calibration *instance, NeuralNetwork *network){
+    const Layer  *first;
+    Channel_Node *channel;
+
+    if(network->layers == NULL || network->layers->layer.plan == NULL){
+        return -1;
+    }
+    first = &network->layers->layer;
+
+    for(channel = first->input_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        QUANT_plane_range((const float*)channel->data.input_ptr, first->plan->in_height * first->plan->in_width,
+                          &instance->input_min, &instance->input_max);
+    }
+
+    if(NEURAL_NETWORK_process_cb(network, QUANT_calibrate_layer, instance) != 0){
+        return -1;
+    }
+
+    instance->samples++;
+    return 0;
+}
+
+void QUANT_calibration_print(const Quant_Calibration *instance){
+    printf("static const Quant_Calibration calibration = {%lu, %lu, %.9gf, %.9gf, {", (unsigned long)instance->layer_count,
+           (unsigned long)instance->samples, instance->input_min, instance->input_max);
+    for(u32 index = 0; index < instance->layer_count; index++){
+        printf("%s%.9gf", (index != 0) ? ", " : "", instance->layer_min[index]);
+    }
+    printf("}, {");
+    for(u32 index = 0; index < instance->layer_count; index++){
+        printf("%s%.9gf", (index != 0) ? ", " : "", instance->layer_max[index]);
+    }
+    printf("}};\n");
+}
+
+// per output channel scales from the prepacked panels, [out / lanes][in][9][lanes]
+static int QUANT_conv3x3(Quant_Layer *instance, float in_scale, s32 in_zero_point){
+    const Prepacked_Conv *packed = instance->layer->packed;
+    const float *panel;
+    float max_value;
+    float weight_scale;
+    s32   weight_sum;
+
+    instance->weights = (s8*)   malloc(instance->out_channels * instance->in_channels * 9);
+    instance->bias    = (s32*)  malloc(instance->out_channels * sizeof(s32));
+    instance->requant = (float*)malloc(instance->out_channels * sizeof(float));
+    if(instance->weights == NULL || instance->bias == NULL || instance->requant == NULL){
+        return -1;
+    }
+
+    for(u32 out = 0; out < instance->out_channels; out++){
+        panel     = packed->panels + ((out / KERNEL_CONV_LANES) * instance->in_channels * 9 * KERNEL_CONV_LANES) + (out % KERNEL_CONV_LANES);
+        max_value = 0.0f;
+        for(u32 tap = 0; tap < instance->in_channels * 9; tap++){
+            max_value = (fabsf(panel[tap * KERNEL_CONV_LANES]) > max_value) ? fabsf(panel[tap * KERNEL_CONV_LANES]) : max_value;
+        }
+
+        weight_scale = QUANT_weight_scale(max_value);
+        weight_sum   = 0;
+        for(u32 tap = 0; tap < instance->in_channels * 9; tap++){
+            instance->weights[(out * instance->in_channels * 9) + tap] = QUANT_weight(panel[tap * KERNEL_CONV_LANES], weight_scale);
+            weight_sum += instance->weights[(out * instance->in_channels * 9) + tap];
+        }
+        // sum w * (q - z) = sum w * q - z * sum w
+        instance->bias[out]    = (s32)roundf(packed->bias[out] / (in_scale * weight_scale)) - (in_zero_point * weight_sum);
+        instance->requant[out] = (in_scale * weight_scale) / instance->scale;
+    }
+
+    instance->alpha = packed->alpha;
+    return 0;
+}
+
+static int QUANT_conv1x1(Quant_Layer *instance, float in_scale, s32 in_zero_point){
+    Channel_Node *channel = instance->layer->output_channels.channels;
+    CNN_1x1_Data *data;
+    float max_value;
+    float weight_scale;
+    s32   weight_sum;
+
+    instance->weights   = (s8*)   malloc(instance->out_channels * instance->in_channels);
+    instance->bias      = (s32*)  malloc(instance->out_channels * sizeof(s32));
+    instance->requant   = (float*)malloc(instance->out_channels * sizeof(float));
+    instance->head_bias = (float*)malloc(instance->out_channels * sizeof(float));
+    if(instance->weights == NULL || instance->bias == NULL || instance->requant == NULL || instance->head_bias == NULL){
+        return -1;
+    }
+
+    for(u32 out = 0; channel != NULL && out < instance->out_channels; out++, channel = (Channel_Node*)channel->next){
+        data      = channel->data.cnn_1x1_data.data;
+        max_value = 0.0f;
+        for(u32 in = 0; in < instance->in_channels; in++){
+            max_value = (fabsf(*(float*)&data->kernal_data[in]) > max_value) ? fabsf(*(float*)&data->kernal_data[in]) : max_value;
+        }
+
+        weight_scale = QUANT_weight_scale(max_value);
+        weight_sum   = 0;
+        for(u32 in = 0; in < instance->in_channels; in++){
+            instance->weights[(out * instance->in_channels) + in] = QUANT_weight(*(float*)&data->kernal_data[in], weight_scale);
+            weight_sum += instance->weights[(out * instance->in_channels) + in];
+        }
+        instance->bias[out]      = -(in_zero_point * weight_sum);
+        instance->requant[out]   = in_scale * weight_scale;
+        instance->head_bias[out] = data->bias;
+    }
+
+    return 0;
+}
+
+int QUANT_init(Quant_Network *instance, NeuralNetwork *network, const Quant_Calibration *calibration, s8 *memory, u32 memory_len){
+    NN_Layer_Info info[QUANT_MAX_LAYERS];
+    Quant_Layer  *layer;
+    float in_scale;
+    s32   in_zero_point;
+    u32 index;
+    int count;
+    int ret = 0;
+
+    instance->network     = network;
+    instance->memory      = memory;
+    instance->memory_len  = memory_len;
+    instance->used        = 0;
+    instance->input       = NULL;
+    instance->layer_count = 0;
+    QUANT_activation(calibration->input_min, calibration->input_max, &instance->input_scale, &instance->input_zero_point);
+
+    count = NEURAL_NETWORK_layer_info(network, info, QUANT_MAX_LAYERS, QUANT_MAX_CHANNELS);
+    if(count < 0){
+        return -1;
+    }
+    if((u32)count > calibration->layer_count){
+        xil_printf("Quant: layer %d is not calibrated \r\n", calibration->layer_count);
+        return -1;
+    }
+
+    for(index = 0; index < (u32)count; index++){
+        layer               = &instance->layers[index];
+        layer->layer        = info[index].layer;
+        layer->source       = info[index].source;
+        layer->head         = info[index].head;
+        layer->in_channels  = info[index].in_channels;
+        layer->out_channels = info[index].out_channels;
+        layer->weights      = NULL;
+        layer->bias         = NULL;
+        layer->requant      = NULL;
+        layer->head_bias    = NULL;
+        layer->alpha        = NULL;
+        layer->output       = NULL;
+
+        QUANT_activation(calibration->layer_min[index], calibration->layer_max[index], &layer->scale, &layer->zero_point);
+    }
+    instance->layer_count = count;
+
+    for(index = 0; index < instance->layer_count && ret == 0; index++){
+        layer    = &instance->layers[index];
+        in_scale      = (layer->source >= 0) ? instance->layers[layer->source].scale      : instance->input_scale;
+        in_zero_point = (layer->source >= 0) ? instance->layers[layer->source].zero_point : instance->input_zero_point;
+
+        switch(layer->layer->type){
+            case LAYER_TYPE_CNN_3X3:
+                if(layer->layer->packed == NULL || layer->head){
+                    xil_printf("Quant: 3x3 layer %d has to be prepacked and read by another layer \r\n", index);
+                    ret = -1;
+                    break;
+                }
+                ret = QUANT_conv3x3(layer, in_scale, in_zero_point);
+                break;
+            case LAYER_TYPE_CNN_1X1:
+                if(!layer->head){
+                    xil_printf("Quant: 1x1 layer %d is read by another layer \r\n", index);
+                    ret = -1;
+                    break;
+                }
+                layer->scale      = in_scale;
+                layer->zero_point = in_zero_point;
+                ret = QUANT_conv1x1(layer, in_scale, in_zero_point);
+                break;
+            case LAYER_TYPE_MAXPOOLING:
+                // max of int8 values is exact, so the input scale carries through
+                if(layer->source < 0 || layer->head){
+                    ret = -1;
+                    break;
+                }
+                layer->scale      = in_scale;
+                layer->zero_point = in_zero_point;
+                break;
+            default:
+                xil_printf("Quant: layer %d type %d not supported \r\n", index, layer->layer->type);
+                ret = -1;
+                break;
+        }
+    }
+
+    if(ret != 0){
+        QUANT_free(instance);
+    }
+    return ret;
+}
+
+// int8 planes for the active plan's shapes
+static int QUANT_layout(Quant_Network *instance){
+    const Layer_Plan *first = instance->layers[0].layer->plan;
+    Quant_Layer *layer;
+    u32 offset;
+
+    if(first == NULL){
+        return -1;
+    }
+
+    instance->input = instance->memory;
+    offset = instance->layers[0].in_channels * first->in_height * first->in_width;
+
+    for(u32 index = 0; index < instance->layer_count; index++){
+        layer = &instance->layers[index];
+        if(layer->layer->plan == NULL){
+            xil_printf("Quant: no plan for layer %d \r\n", index);
+            return -1;
+        }
+        if(!layer->head){
+            layer->output = instance->memory + offset;
+            offset       += layer->out_channels * layer->layer->plan->out_height * layer->layer->plan->out_width;
+        }
+    }
+
+    instance->used = offset;
+    if(instance->used > instance->memory_len){
+        xil_printf("Quant: int8 planes need %d bytes, have %d \r\n", instance->used, instance->memory_len);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void QUANT_layer(Quant_Network *instance, const Quant_Layer *layer){
+    const Layer_Plan *plan = layer->layer->plan;
+    const s8   *inputs[QUANT_MAX_CHANNELS];
+    s8         *outputs[QUANT_MAX_CHANNELS];
+    float      *heads[QUANT_MAX_CHANNELS];
+    const s8   *source;
+    Channel_Node *channel;
+    u32 in_plane  = plan->in_height  * plan->in_width;
+    u32 out_plane = plan->out_height * plan->out_width;
+    u32 index     = 0;
+
+    source = (layer->source >= 0) ? instance->layers[layer->source].output : instance->input;
+    for(u32 in = 0; in < layer->in_channels; in++){
+        inputs[in] = source + (in * in_plane);
+    }
+    for(u32 out = 0; out < layer->out_channels && layer->output != NULL; out++){
+        outputs[out] = layer->output + (out * out_plane);
+    }
+
+    switch(layer->layer->type){
+        case LAYER_TYPE_CNN_3X3:
+            KERNEL_conv3x3_s8(inputs, layer->in_channels, plan->in_width, outputs, layer->out_channels,
+                              plan->out_height, plan->out_width, layer->weights, layer->bias, layer->requant, layer->alpha, layer->zero_point);
+            break;
+        case LAYER_TYPE_MAXPOOLING:
+            channel = layer->layer->output_channels.channels;
+            for(u32 out = 0; out < layer->out_channels; out++){
+                KERNEL_maxpool_s8(inputs[out], plan->in_height, plan->in_width, outputs[out], plan->out_height, plan->out_width,
+                                  channel->data.data.mx_data.pool_size, channel->data.data.mx_data.stride);
+            }
+            break;
+        case LAYER_TYPE_CNN_1X1:
+            for(channel = layer->layer->output_channels.channels; channel != NULL && index < layer->out_channels; channel = (Channel_Node*)channel->next){
+                heads[index++] = (float*)channel->data.output_ptr;
+            }
+            KERNEL_conv1x1_s8(inputs, layer->in_channels, out_plane, heads, layer->out_channels,
+                              layer->weights, layer->bias, layer->requant, layer->head_bias);
+            if(layer->layer->activation == LAYER_ACTIVATION_SOFTMAX){
+                KERNEL_softmax(heads, layer->out_channels, out_plane, plan->exp_mode);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int QUANT_process(Quant_Network *instance){
+    const Layer  *first = instance->layers[0].layer;
+    Channel_Node *channel;
+    u32 plane;
+    u32 index = 0;
+
+    if(instance->layer_count == 0 || QUANT_layout(instance) != 0){
+        return -1;
+    }
+
+    TRACE_BEGIN("int8", instance->layer_count);
+    plane = first->plan->in_height * first->plan->in_width;
+    for(channel = first->input_channels.channels; channel != NULL && index < instance->layers[0].in_channels; channel = (Channel_Node*)channel->next){
+        KERNEL_quantize_s8((const float*)channel->data.input_ptr, instance->input + (index * plane), plane,
+                           1.0f / instance->input_scale, instance->input_zero_point);
+        index++;
+    }
+
+    for(index = 0; index < instance->layer_count; index++){
+        QUANT_layer(instance, &instance->layers[index]);
+    }
+    TRACE_END("int8");
+
+    return 0;
+}
+
+void QUANT_free(Quant_Network *instance){
+    for(u32 index = 0; index < instance->layer_count && index < QUANT_MAX_LAYERS; index++){
+        free(instance->layers[index].weights);
+        free(instance->layers[index].bias);
+        free(instance->layers[index].requant);
+        free(instance->layers[index].head_bias);
+        instance->layers[index].weights   = NULL;
+        instance->layers[index].bias      = NULL;
+        instance->layers[index].requant   = NULL;
+        instance->layers[index].head_bias = NULL;
+    }
+}
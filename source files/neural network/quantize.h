@@ -0,0 +1,90 @@
+
+#ifndef NET_ENGINE_QUANTIZE_H
+#define NET_ENGINE_QUANTIZE_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+
+/**************************** Type Definitions *****************************/
+#define QUANT_MAX_LAYERS        PLAN_MAX_LAYERS
+#define QUANT_MAX_CHANNELS      64
+#define QUANT_WEIGHT_LEVELS     127.0f      // weights are symmetric per output channel, scale = max |w| / 127
+#define QUANT_LEVELS            255.0f      // activations span [min, max] with a zero point
+#define QUANT_MIN               (-128)
+#define QUANT_MAX               127
+
+// activation range seen per layer output, gathered from sample images
+typedef struct Quant_Calibration_{
+    u32   layer_count;
+    u32   samples;
+    float input_min;
+    float input_max;
+    float layer_min[QUANT_MAX_LAYERS];
+    float layer_max[QUANT_MAX_LAYERS];
+} Quant_Calibration;
+
+typedef struct Quant_Layer_{
+    Layer  *layer;
+    int     source;             // layer feeding this one, -1 for the network input
+    u8      head;               // no other layer reads it, written as float into the layer's pool
+    u32     in_channels;
+    u32     out_channels;
+    float   scale;              // per tensor output scale, x = scale * (q - zero_point); heads keep their input's
+    s32     zero_point;
+    s8     *weights;            // 3x3: [out][in][9], 1x1: [out][in], per output channel scales
+    s32    *bias;               // [out] in accumulator units, input zero point folded in
+    float  *requant;            // 3x3: [out] in_scale * weight_scale / scale, 1x1: [out] in_scale * weight_scale
+    float  *head_bias;          // 1x1: [out] float bias added after dequantizing
+    const float *alpha;         // 3x3: PReLU slopes of the prepacked layer, NULL without activation
+    s8     *output;             // int8 planes of the active plan, NULL for heads
+} Quant_Layer;
+
+typedef struct Quant_Network_{
+    NeuralNetwork *network;
+    s8            *memory;
+    u32            memory_len;      // bytes
+    u32            used;            // bytes of int8 planes for the active plan
+    float          input_scale;
+    s32            input_zero_point;
+    s8            *input;           // quantized input planes
+    u32            layer_count;
+    Quant_Layer    layers[QUANT_MAX_LAYERS];
+} Quant_Network;
+
+/************************** Function Prototypes ****************************/
+
+void QUANT_calibration_init(Quant_Calibration *instance);
+
+/**
+ * Runs the float network once on whatever the input planes hold (at the
+ * active plan) and widens the per layer maxima. Call it for every sample
+ * image and pyramid level that should be covered.
+ */
+int QUANT_calibrate(Quant_Calibration *instance, NeuralNetwork *network);
+
+/**
+ * Prints the calibration as a C initializer, so the scales found on the
+ * host or once on target can be compiled in.
+ */
+void QUANT_calibration_print(const Quant_Calibration *instance);
+
+/**
+ * Quantizes a built network's weights, per output channel and symmetric;
+ * activations get a per tensor scale and zero point from the calibration.
+ * Every 3x3 layer has to be prepacked and only layers nothing else reads
+ * may be 1x1. Activations between layers are int8 planes carved from memory.
+ */
+int QUANT_init(Quant_Network *instance, NeuralNetwork *network, const Quant_Calibration *calibration, s8 *memory, u32 memory_len);
+
+/**
+ * Runs the network's active plan in int8. The float input planes are
+ * quantized first, the heads are dequantized into their layers' pools (with
+ * softmax when the layer has it), no other layer output is written.
+ */
+int QUANT_process(Quant_Network *instance);
+
+void QUANT_free(Quant_Network *instance);
+
+#endif // NET_ENGINE_QUANTIZE_H
@@ -0,0 +1,254 @@
+#include "scheduler.h"
+#include "profiler.h"
+#include "trace.h"
+#include <string.h>
+#include <xil_printf.h>
+
+static const char *SCHEDULER_stage_names[SCHEDULER_STAGE_COUNT] = {"sched resize", "sched conv", "sched decode"};
+
+static u32 SCHEDULER_depth(const Scheduler_Queue *queue){
+    return queue->tail - queue->head;
+}
+
+static u32 SCHEDULER_front(const Scheduler_Queue *queue){
+    return queue->items[queue->head % SCHEDULER_MAX_LEVELS];
+}
+
+static void SCHEDULER_pop(Scheduler_Queue *queue){
+    queue->head++;
+}
+
+static void SCHEDULER_push(Scheduler_Queue *queue, u32 level){
+    queue->items[queue->tail % SCHEDULER_MAX_LEVELS] = level;
+    queue->tail++;
+    if(SCHEDULER_depth(queue) > queue->max_depth){
+        queue->max_depth = SCHEDULER_depth(queue);
+    }
+}
+
+static void SCHEDULER_stage_begin(Scheduler *instance, SCHEDULER_STAGE stage){
+    if(instance->scopes[stage] >= 0){
+        PROFILER_begin(instance->scopes[stage]);
+    }
+}
+
+static void SCHEDULER_stage_end(Scheduler *instance, SCHEDULER_STAGE stage){
+    if(instance->scopes[stage] >= 0){
+        PROFILER_end(instance->scopes[stage]);
+    }
+}
+
+int SCHEDULER_init(Scheduler *instance, const Scheduler_Config *config){
+    const Execution_Plan *plan;
+    const Layer_Plan     *score;
+    const Layer_Plan     *box;
+    u32 height;
+    u32 width;
+
+    if(config->network == NULL || config->pyramid == NULL || config->decode == NULL){
+        return -1;
+    }
+
+    // the next level is resized while the network still reads the previous one
+    if(config->pyramid->mode != PYRAMID_MODE_DIRECT || config->pyramid->level_count > SCHEDULER_MAX_LEVELS){
+        xil_printf("Scheduler: pyramid has to be direct with at most %d levels \r\n", SCHEDULER_MAX_LEVELS);
+        return -1;
+    }
+
+    for(u32 level = 0; level < config->pyramid->level_count; level++){
+        PYRAMID_level_shape(config->pyramid, level, &height, &width);
+        plan = PLAN_cache_find(&config->network->plan_cache, height, width);
+        if(plan == NULL || config->score_layer >= plan->layer_count || config->box_layer >= plan->layer_count){
+            xil_printf("Scheduler: no plan for level %d \r\n", level);
+            return -1;
+        }
+
+        score = &plan->layers[config->score_layer];
+        box   = &plan->layers[config->box_layer];
+        if(score->frame_stride != SCHEDULER_SCORE_PLANES * score->channel_stride ||
+           box->frame_stride != (SCHEDULER_HEAD_PLANES - SCHEDULER_SCORE_PLANES) * score->channel_stride ||
+           (score->frame_stride + box->frame_stride) * sizeof(u32) > config->head_slot_size){
+            xil_printf("Scheduler: heads of level %d do not fit a head slot \r\n", level);
+            return -1;
+        }
+    }
+
+    instance->config = *config;
+    for(u32 stage = 0; stage < SCHEDULER_STAGE_COUNT; stage++){
+        instance->queues[stage].head      = 0;
+        instance->queues[stage].tail      = 0;
+        instance->queues[stage].max_depth = 0;
+        instance->scopes[stage]           = PROFILER_register(SCHEDULER_stage_names[stage]);
+    }
+
+    return 0;
+}
+
+// resizes the next SCHEDULER_RESIZE_ROWS rows, returns 0 when there was nothing to do
+static int SCHEDULER_resize_step(Scheduler *instance){
+    Scheduler_Queue *queue = &instance->queues[SCHEDULER_STAGE_RESIZE];
+    u32 height;
+    u32 width;
+
+    if(instance->resize_level < 0){
+        if(SCHEDULER_depth(queue) == 0){
+            return 0;
+        }
+        // its input slot is still read by the network
+        if(SCHEDULER_front(queue) >= instance->released + SCHEDULER_INPUT_SLOTS){
+            return 0;
+        }
+        instance->resize_level = SCHEDULER_front(queue);
+        instance->resize_row   = 0;
+    }
+
+    PYRAMID_level_shape(instance->config.pyramid, instance->resize_level, &height, &width);
+
+    SCHEDULER_stage_begin(instance, SCHEDULER_STAGE_RESIZE);
+    PYRAMID_build_rows(instance->config.pyramid, instance->resize_level, instance->frame,
+                       instance->config.input_slots[instance->resize_level % SCHEDULER_INPUT_SLOTS],
+                       instance->resize_row, SCHEDULER_RESIZE_ROWS);
+    SCHEDULER_stage_end(instance, SCHEDULER_STAGE_RESIZE);
+
+    instance->resize_row += SCHEDULER_RESIZE_ROWS;
+    if(instance->resize_row >= height){
+        SCHEDULER_pop(queue);
+        SCHEDULER_push(&instance->queues[SCHEDULER_STAGE_CONV], instance->resize_level);
+        instance->resize_level = -1;
+    }
+
+    return 1;
+}
+
+// decodes the oldest head slot, returns 0 when there was nothing to do
+static int SCHEDULER_decode_step(Scheduler *instance){
+    Scheduler_Queue *queue = &instance->queues[SCHEDULER_STAGE_DECODE];
+    const float *heads[SCHEDULER_HEAD_PLANES];
+    u32 level;
+    u32 slot;
+    u32 plane_size;
+
+    if(SCHEDULER_depth(queue) == 0){
+        return 0;
+    }
+
+    level      = SCHEDULER_front(queue);
+    slot       = level % SCHEDULER_HEAD_SLOTS;
+    plane_size = instance->head_height[slot] * instance->head_width[slot];
+    for(u32 plane = 0; plane < SCHEDULER_HEAD_PLANES; plane++){
+        heads[plane] = instance->config.head_slots[slot] + (plane * plane_size);
+    }
+
+    SCHEDULER_stage_begin(instance, SCHEDULER_STAGE_DECODE);
+    if(instance->config.decode(level, heads, instance->head_height[slot], instance->head_width[slot], instance->config.context) != 0){
+        instance->status = -1;
+    }
+    SCHEDULER_stage_end(instance, SCHEDULER_STAGE_DECODE);
+
+    SCHEDULER_pop(queue);
+    return 1;
+}
+
+// engine wait hook, the next level's input comes first since the conv stage gates the frame
+static void SCHEDULER_idle(void *context){
+    Scheduler *instance = (Scheduler*)context;
+
+    if(SCHEDULER_resize_step(instance) == 0){
+        SCHEDULER_decode_step(instance);
+    }
+}
+
+// the head pools are reused by the next level, so copy the heads out while they are live
+static int SCHEDULER_layer_done(const Layer *layer, void *context){
+    Scheduler *instance = (Scheduler*)context;
+    u32 slot = instance->conv_level % SCHEDULER_HEAD_SLOTS;
+    const Layer_Plan *plan = layer->plan;
+    float *head = instance->config.head_slots[slot];
+
+    if(layer->index == instance->config.box_layer){
+        head += SCHEDULER_SCORE_PLANES * plan->channel_stride;
+    }
+    else if(layer->index != instance->config.score_layer){
+        return 0;
+    }
+
+    memcpy(head, layer->memory.memory_ptr, plan->frame_stride * sizeof(u32));
+    instance->head_height[slot] = plan->out_height;
+    instance->head_width[slot]  = plan->out_width;
+
+    return 0;
+}
+
+int SCHEDULER_run(Scheduler *instance, float *const frame[PYRAMID_PLANES]){
+    NeuralNetwork   *network = instance->config.network;
+    Scheduler_Queue *conv    = &instance->queues[SCHEDULER_STAGE_CONV];
+    u32 level_count = instance->config.pyramid->level_count;
+    u32 height;
+    u32 width;
+    int ret = 0;
+
+    instance->frame        = frame;
+    instance->released     = 0;
+    instance->resize_level = -1;
+    instance->status       = 0;
+    for(u32 stage = 0; stage < SCHEDULER_STAGE_COUNT; stage++){
+        instance->queues[stage].head = 0;
+        instance->queues[stage].tail = 0;
+    }
+    for(u32 level = 0; level < level_count; level++){
+        SCHEDULER_push(&instance->queues[SCHEDULER_STAGE_RESIZE], level);
+    }
+
+    NET_ENGINE_set_idle(&network->net_engine, SCHEDULER_idle, instance);
+
+    for(u32 done = 0; done < level_count && ret == 0; done++){
+        // whatever the last conv did not hide is finished here, all of level 0
+        while(SCHEDULER_depth(conv) == 0){
+            if(SCHEDULER_resize_step(instance) == 0){
+                ret = -1;
+                break;
+            }
+        }
+        if(ret != 0){
+            break;
+        }
+
+        // both head slots are still waiting, free the oldest
+        if(SCHEDULER_depth(&instance->queues[SCHEDULER_STAGE_DECODE]) == SCHEDULER_HEAD_SLOTS){
+            SCHEDULER_decode_step(instance);
+        }
+
+        instance->conv_level = SCHEDULER_front(conv);
+        PYRAMID_level_shape(instance->config.pyramid, instance->conv_level, &height, &width);
+
+        TRACE_BEGIN("scale", instance->conv_level);
+        SCHEDULER_stage_begin(instance, SCHEDULER_STAGE_CONV);
+        NEURAL_NETWORK_set_input(network, (u32 *const *)instance->config.input_slots[instance->conv_level % SCHEDULER_INPUT_SLOTS], PYRAMID_PLANES);
+        NEURAL_NETWORK_update(network, height, width);
+        ret = NEURAL_NETWORK_process_cb(network, SCHEDULER_layer_done, instance);
+        SCHEDULER_stage_end(instance, SCHEDULER_STAGE_CONV);
+        TRACE_END("scale");
+
+        SCHEDULER_pop(conv);
+        instance->released++;
+        SCHEDULER_push(&instance->queues[SCHEDULER_STAGE_DECODE], instance->conv_level);
+    }
+
+    NET_ENGINE_set_idle(&network->net_engine, NULL, NULL);
+
+    while(SCHEDULER_decode_step(instance)){
+    }
+
+    return (ret != 0) ? ret : instance->status;
+}
+
+u32 SCHEDULER_queue_depth(const Scheduler *instance, SCHEDULER_STAGE stage){
+    return SCHEDULER_depth(&instance->queues[stage]);
+}
+
+void SCHEDULER_report(const Scheduler *instance){
+    xil_printf("Scheduler max queue depth: resize %d, conv %d, decode %d \r\n",
+        instance->queues[SCHEDULER_STAGE_RESIZE].max_depth,
+        instance->queues[SCHEDULER_STAGE_CONV].max_depth,
+        instance->queues[SCHEDULER_STAGE_DECODE].max_depth);
+}
@@ -0,0 +1,88 @@
+
+#ifndef NET_ENGINE_SCHEDULER_H
+#define NET_ENGINE_SCHEDULER_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+#include "pyramid.h"
+
+/**************************** Type Definitions *****************************/
+#define SCHEDULER_MAX_LEVELS    PYRAMID_MAX_LEVELS
+#define SCHEDULER_INPUT_SLOTS   2       // resized levels in flight: one in conv, one being resized
+#define SCHEDULER_HEAD_SLOTS    2       // head outputs waiting for the decode stage
+#define SCHEDULER_HEAD_PLANES   6       // class scores followed by the 4 box offsets
+#define SCHEDULER_SCORE_PLANES  2
+#define SCHEDULER_RESIZE_ROWS   4       // pyramid rows resized per idle call
+
+typedef enum{
+    SCHEDULER_STAGE_RESIZE,         // levels waiting to be resized
+    SCHEDULER_STAGE_CONV,           // resized levels waiting for the network
+    SCHEDULER_STAGE_DECODE,         // head outputs waiting for box decode
+    SCHEDULER_STAGE_COUNT,
+} SCHEDULER_STAGE;
+
+// single producer / single consumer ring of level indices
+typedef struct Scheduler_Queue_{
+    volatile u32 head;
+    volatile u32 tail;
+    u32          max_depth;
+    u32          items[SCHEDULER_MAX_LEVELS];
+} Scheduler_Queue;
+
+/**
+ * Decode stage of one level. heads holds SCHEDULER_HEAD_PLANES planes of
+ * height x width, they stay valid until the callback returns.
+ */
+typedef int (Scheduler_Decode_cb)(u32 level, const float *const heads[SCHEDULER_HEAD_PLANES], u32 height, u32 width, void *context);
+
+typedef struct Scheduler_Config_{
+    NeuralNetwork       *network;
+    Pyramid             *pyramid;               // PYRAMID_MODE_DIRECT, plans prepared for every level
+    float               *input_slots[SCHEDULER_INPUT_SLOTS][PYRAMID_PLANES];
+    float               *head_slots[SCHEDULER_HEAD_SLOTS];
+    u32                  head_slot_size;        // bytes per head slot
+    u8                   score_layer;           // layer indices of the two heads
+    u8                   box_layer;
+    Scheduler_Decode_cb *decode;
+    void                *context;
+} Scheduler_Config;
+
+typedef struct Scheduler_{
+    Scheduler_Config config;
+    float *const    *frame;
+    Scheduler_Queue  queues[SCHEDULER_STAGE_COUNT];
+    u32              released;              // levels whose input slot is free again
+    u32              conv_level;
+    int              resize_level;          // level being resized in slices, -1 when none
+    u32              resize_row;
+    u32              head_height[SCHEDULER_HEAD_SLOTS];
+    u32              head_width[SCHEDULER_HEAD_SLOTS];
+    int              status;
+    int              scopes[SCHEDULER_STAGE_COUNT];
+} Scheduler;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Checks that every level's heads fit a head slot. Input slots must hold
+ * PYRAMID_PLANES planes of the largest level each.
+ */
+int SCHEDULER_init(Scheduler *instance, const Scheduler_Config *config);
+
+/**
+ * Runs every pyramid level of frame through resize, the network and decode.
+ * While the Net Engine streams a level, the CPU resizes the next level into
+ * the other input slot and decodes the heads of the previous one, so a
+ * frame takes about the sum of the conv stages instead of every stage.
+ * Without the engine the stages simply run back to back.
+ */
+int SCHEDULER_run(Scheduler *instance, float *const frame[PYRAMID_PLANES]);
+
+u32 SCHEDULER_queue_depth(const Scheduler *instance, SCHEDULER_STAGE stage);
+
+// deepest each stage queue got since init
+void SCHEDULER_report(const Scheduler *instance);
+
+#endif // NET_ENGINE_SCHEDULER_H
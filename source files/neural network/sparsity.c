@@ -0,0 +1,165 @@
+#include "sparsity.h"
+#include "prepack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xil_printf.h>
+
+static float SPARSITY_float(u32 word){
+    float value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+static u32 SPARSITY_word(float value){
+    u32 word;
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+static u32 SPARSITY_zero_taps(const Channel_Kernal_Data *kernal){
+    const u32 *taps = &kernal->Kernal.Kernal_1;
+    u32 zeros = 0;
+
+    for(u32 tap = 0; tap < 9; tap++){
+        if(SPARSITY_float(taps[tap]) == 0.0f){
+            zeros++;
+        }
+    }
+    return zeros;
+}
+
+static void SPARSITY_count(const Layer *layer, Sparsity_Layer *stats){
+    Channel_Node *channel;
+    Channel_Kernal_Data_Node *kernal;
+    const CNN_1x1_Data *data;
+    u32 zeros;
+
+    memset(stats, 0, sizeof(Sparsity_Layer));
+    stats->type = layer->type;
+
+    for(channel = layer->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        if(layer->type == LAYER_TYPE_CNN_3X3){
+            for(kernal = channel->data.cnn_data.kernal_node; kernal != NULL; kernal = (Channel_Kernal_Data_Node*)kernal->next){
+                zeros = SPARSITY_zero_taps(&kernal->data);
+                stats->kernels++;
+                stats->weights      += 9;
+                stats->zero_weights += zeros;
+                stats->zero_kernels += (zeros == 9) ? 1 : 0;
+            }
+        }
+        else if(layer->type == LAYER_TYPE_CNN_1X1){
+            data = channel->data.cnn_1x1_data.data;
+            for(u32 in = 0; data != NULL && in < layer->input_channels.count; in++){
+                stats->weights++;
+                stats->zero_weights += (SPARSITY_float(data->kernal_data[in]) == 0.0f) ? 1 : 0;
+            }
+        }
+    }
+}
+
+// drops the all zero kernels of one output channel, returns how many
+static u32 SPARSITY_prune_channel(Channel *channel){
+    Channel_Kernal_Data_Node **link = &channel->cnn_data.kernal_node;
+    Channel_Kernal_Data_Node  *kernal;
+    Channel_Kernal_Data_Node  *kept = NULL;
+    float bias   = 0.0f;
+    u32   pruned = 0;
+    u32   index  = 0;
+
+    while(*link != NULL){
+        kernal = *link;
+        // the last kernel stays even when zero, it carries the channel's bias
+        if(SPARSITY_zero_taps(&kernal->data) == 9 && (kept != NULL || kernal->next != NULL)){
+            bias += SPARSITY_float(kernal->data.Bias);
+            *link = (Channel_Kernal_Data_Node*)kernal->next;
+            free(kernal);
+            pruned++;
+            continue;
+        }
+
+        kernal->data.index = index++;
+        if(kept == NULL){
+            kept = kernal;
+        }
+        link = (Channel_Kernal_Data_Node**)&kernal->next;
+    }
+
+    if(kept != NULL && pruned != 0){
+        kept->data.Bias = SPARSITY_word(SPARSITY_float(kept->data.Bias) + bias);
+    }
+    channel->kernal_data_count = index;
+
+    return pruned;
+}
+
+int SPARSITY_analyze(NeuralNetwork *network, Sparsity_Report *report){
+    NN_Layer_Node *cur_layer;
+
+    report->layer_count = 0;
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next){
+        if(report->layer_count >= SPARSITY_MAX_LAYERS){
+            return -1;
+        }
+        SPARSITY_count(&cur_layer->layer, &report->layers[report->layer_count++]);
+    }
+
+    return 0;
+}
+
+int SPARSITY_prune(NeuralNetwork *network, Sparsity_Report *report){
+    NN_Layer_Node  *cur_layer;
+    Layer          *layer;
+    Channel_Node   *channel;
+    Sparsity_Layer *stats;
+    Prepacked_Conv *packed;
+
+    if(SPARSITY_analyze(network, report) != 0){
+        return -1;
+    }
+
+    stats = report->layers;
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next, stats++){
+        layer = &cur_layer->layer;
+        if(layer->type != LAYER_TYPE_CNN_3X3){
+            continue;
+        }
+
+        for(channel = layer->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+            stats->pruned += SPARSITY_prune_channel(&channel->data);
+        }
+
+        // the engine words follow the kernel lists, so a changed layer is packed again
+        if(stats->pruned != 0 && layer->packed != NULL){
+            packed = PREPACK_conv3x3(layer);
+            if(packed == NULL){
+                xil_printf("Sparsity: repacking layer %d failed \r\n", layer->index);
+                return -1;
+            }
+            PREPACK_free(layer->packed);
+            layer->packed = packed;
+        }
+
+        if(layer->packed != NULL && layer->conv_backend == CONV_BACKEND_CPU_DIRECT &&
+           layer->packed->sparse_count <= SPARSITY_MAX_DENSITY * stats->weights){
+            layer->conv_backend    = CONV_BACKEND_CPU_SPARSE;
+            layer->default_backend = CONV_BACKEND_CPU_SPARSE;
+        }
+    }
+
+    return 0;
+}
+
+void SPARSITY_print(const Sparsity_Report *report){
+    const Sparsity_Layer *stats;
+
+    printf("Sparsity: layer, type, weights, zero weights, kernels, zero kernels, pruned \n");
+    for(u32 index = 0; index < report->layer_count; index++){
+        stats = &report->layers[index];
+        if(stats->weights == 0){
+            continue;
+        }
+        printf("\t%d, %d, %d, %d (%.1f%%), %d, %d, %d \n", index + 1, stats->type, stats->weights, stats->zero_weights,
+               (100.0f * stats->zero_weights) / stats->weights, stats->kernels, stats->zero_kernels, stats->pruned);
+    }
+}
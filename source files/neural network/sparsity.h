@@ -0,0 +1,47 @@
+
+#ifndef NET_ENGINE_SPARSITY_H
+#define NET_ENGINE_SPARSITY_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+
+/**************************** Type Definitions *****************************/
+#define SPARSITY_MAX_LAYERS     PLAN_MAX_LAYERS
+#define SPARSITY_MAX_DENSITY    0.5f        // CPU 3x3 layers with at most this share of nonzero taps run CONV_BACKEND_CPU_SPARSE
+
+// zero weights of one layer, 3x3 counts taps and kernels, 1x1 single weights
+typedef struct Sparsity_Layer_{
+    LAYER_TYPE type;
+    u32        weights;
+    u32        zero_weights;
+    u32        kernels;
+    u32        zero_kernels;
+    u32        pruned;              // kernel nodes removed from the channels
+} Sparsity_Layer;
+
+typedef struct Sparsity_Report_{
+    u32            layer_count;
+    Sparsity_Layer layers[SPARSITY_MAX_LAYERS];
+} Sparsity_Report;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Counts the zero weights of a built network without changing it.
+ */
+int SPARSITY_analyze(NeuralNetwork *network, Sparsity_Report *report);
+
+/**
+ * Removes the 3x3 kernel nodes whose nine taps are all zero from their
+ * output channels (their bias moves to a kept kernel of the channel, one
+ * kernel always stays), repacks the layers it changed and moves CPU layers
+ * at or below SPARSITY_MAX_DENSITY to CONV_BACKEND_CPU_SPARSE. Weights are
+ * pruned offline (model/sparsity.py), this only drops what is exactly zero.
+ */
+int SPARSITY_prune(NeuralNetwork *network, Sparsity_Report *report);
+
+void SPARSITY_print(const Sparsity_Report *report);
+
+#endif // NET_ENGINE_SPARSITY_H
@@ -0,0 +1,105 @@
+#include "split.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <xil_printf.h>
+
+#ifdef USE_NET_ENGINE
+static int SPLIT_time(NeuralNetwork *network, CONV_BACKEND backend, u64 *ns){
+    if(NEURAL_NETWORK_set_conv_backend(network, backend) != 0){
+        return -1;
+    }
+    return NEURAL_NETWORK_time_layers(network, ns, SPLIT_MAX_LAYERS);
+}
+
+// share where both sides' rates, as measured in the last run, finish together
+static float SPLIT_balance(const Layer *layer, u64 engine_full, u64 cpu_full){
+    float share     = (layer->split.count != 0) ? (float)layer->split.cpu_count / layer->split.count : 0.0f;
+    float engine_ns = (float)PROFILER_ticks_to_ns(layer->split.engine_ticks);
+    float cpu_ns    = (float)PROFILER_ticks_to_ns(layer->split.cpu_ticks);
+    float engine_rate;
+    float cpu_rate;
+
+    engine_rate = (share < 1.0f && engine_ns > 0.0f) ? (1.0f - share) / engine_ns : 1.0f / engine_full;
+    cpu_rate    = (share > 0.0f && cpu_ns > 0.0f)    ? share / cpu_ns             : 1.0f / cpu_full;
+
+    return cpu_rate / (engine_rate + cpu_rate);
+}
+#endif
+
+int SPLIT_calibrate(NeuralNetwork *network, CONV_SPLIT mode, u32 rounds, Split_Profile *profile){
+    NN_Layer_Node *cur_layer;
+    Layer *layer;
+    u32 index;
+
+    profile->layer_count = 0;
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next){
+        if(profile->layer_count == SPLIT_MAX_LAYERS){
+            return -1;
+        }
+        profile->engine_ns[profile->layer_count] = 0;
+        profile->cpu_ns[profile->layer_count]    = 0;
+        profile->layer_count++;
+    }
+
+#ifdef USE_NET_ENGINE
+    if(SPLIT_time(network, CONV_BACKEND_NET_ENGINE, profile->engine_ns) != 0 ||
+       SPLIT_time(network, CONV_BACKEND_CPU_ENGINE, profile->cpu_ns) != 0){
+        return -1;
+    }
+#endif
+
+    index = 0;
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+        layer = &cur_layer->layer;
+        layer->split.mode = mode;
+#ifdef USE_NET_ENGINE
+        if(profile->engine_ns[index] != 0 && profile->cpu_ns[index] != 0){
+            layer->split.cpu_share = (float)profile->engine_ns[index] / (float)(profile->engine_ns[index] + profile->cpu_ns[index]);
+        }
+#else
+        layer->split.cpu_share = 1.0f;
+#endif
+    }
+
+    if(NEURAL_NETWORK_set_conv_backend(network, CONV_BACKEND_SPLIT) != 0){
+        return -1;
+    }
+
+#ifdef USE_NET_ENGINE
+    for(u32 round = 0; round < rounds; round++){
+        if(NEURAL_NETWORK_process(network) != 0){
+            return -1;
+        }
+
+        index = 0;
+        for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+            layer = &cur_layer->layer;
+            if(layer->type == LAYER_TYPE_CNN_3X3 && profile->engine_ns[index] != 0 && profile->cpu_ns[index] != 0){
+                layer->split.cpu_share = SPLIT_balance(layer, profile->engine_ns[index], profile->cpu_ns[index]);
+            }
+        }
+    }
+#else
+    (void)rounds;
+#endif
+
+    return 0;
+}
+
+void SPLIT_report(NeuralNetwork *network, const Split_Profile *profile){
+    NN_Layer_Node *cur_layer;
+    const Layer *layer;
+    u32 index = 0;
+
+    printf("Split: layer, mode, cpu share, cpu count, engine alone us, cpu alone us, engine side us, cpu side us \n");
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next, index++){
+        layer = &cur_layer->layer;
+        if(layer->type != LAYER_TYPE_CNN_3X3 || index >= profile->layer_count){
+            continue;
+        }
+        printf("\t%d, %s, %.3f, %d of %d, %d, %d, %d, %d \n", index + 1, (layer->split.mode == CONV_SPLIT_ROWS) ? "rows" : "channels",
+               layer->split.cpu_share, layer->split.cpu_count, layer->split.count,
+               (u32)(profile->engine_ns[index] / 1000), (u32)(profile->cpu_ns[index] / 1000),
+               (u32)(PROFILER_ticks_to_ns(layer->split.engine_ticks) / 1000), (u32)(PROFILER_ticks_to_ns(layer->split.cpu_ticks) / 1000));
+    }
+}
@@ -0,0 +1,35 @@
+
+#ifndef NET_ENGINE_SPLIT_H
+#define NET_ENGINE_SPLIT_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+
+/**************************** Type Definitions *****************************/
+#define SPLIT_MAX_LAYERS        PLAN_MAX_LAYERS
+
+// whole layer timings of each side, the first guess at the split
+typedef struct Split_Profile_{
+    u32 layer_count;
+    u64 engine_ns[SPLIT_MAX_LAYERS];
+    u64 cpu_ns[SPLIT_MAX_LAYERS];
+} Split_Profile;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Moves every 3x3 layer to CONV_BACKEND_SPLIT in mode and sizes each
+ * layer's CPU share so the engine and the CPU finish it together. The
+ * network runs the active plan on whatever the input planes hold: once all
+ * on the engine and once all on CONV_BACKEND_CPU_ENGINE for a first guess,
+ * then rounds split runs that each move the share to where the measured
+ * rates of both sides meet. Without USE_NET_ENGINE the CPU takes everything.
+ */
+int SPLIT_calibrate(NeuralNetwork *network, CONV_SPLIT mode, u32 rounds, Split_Profile *profile);
+
+// per 3x3 layer share and both sides' times of the last run
+void SPLIT_report(NeuralNetwork *network, const Split_Profile *profile);
+
+#endif // NET_ENGINE_SPLIT_H
@@ -0,0 +1,89 @@
+#include "tiling.h"
+
+#if defined(__arm__) && !defined(__linux__)
+#include "xil_io.h"
+#include "xparameters_ps.h"
+#define TILING_DETECT_CACHES
+#define TILING_L2CC_AUX_CTRL_OFFSET 0x104
+#endif
+
+static Tiling_Caches TILING_sizes = {TILING_L1_BYTES, TILING_L2_BYTES, 0};
+static u8            TILING_ready = 0;
+
+#ifdef TILING_DETECT_CACHES
+// CCSIDR of the L1 data cache: line size, ways and sets
+static u32 TILING_l1_detect(void){
+    u32 ccsidr;
+    u32 line;
+    u32 ways;
+    u32 sets;
+
+    __asm__ volatile("mcr p15, 2, %0, c0, c0, 0" :: "r"(0));
+    __asm__ volatile("isb");
+    __asm__ volatile("mrc p15, 1, %0, c0, c0, 0" : "=r"(ccsidr));
+
+    line = 1 << ((ccsidr & 0x7) + 4);
+    ways = ((ccsidr >> 3)  & 0x3FF)  + 1;
+    sets = ((ccsidr >> 13) & 0x7FFF) + 1;
+    return line * ways * sets;
+}
+
+// PL310 way size (16 KB << (n - 1)) times 8 or 16 ways
+static u32 TILING_l2_detect(void){
+    u32 aux      = Xil_In32(XPS_L2CC_BASEADDR + TILING_L2CC_AUX_CTRL_OFFSET);
+    u32 way_size = (aux >> 17) & 0x7;
+    u32 ways     = (aux & (1 << 16)) ? 16 : 8;
+
+    if(way_size == 0){
+        return TILING_L2_BYTES;
+    }
+    return ways * ((16 * 1024) << (way_size - 1));
+}
+#endif
+
+const Tiling_Caches* TILING_caches(void){
+    if(!TILING_ready){
+#ifdef TILING_DETECT_CACHES
+        TILING_sizes.l1_bytes = TILING_l1_detect();
+        TILING_sizes.l2_bytes = TILING_l2_detect();
+        TILING_sizes.detected = 1;
+#endif
+        TILING_ready = 1;
+    }
+    return &TILING_sizes;
+}
+
+void TILING_set_caches(u32 l1_bytes, u32 l2_bytes){
+    TILING_sizes.l1_bytes = l1_bytes;
+    TILING_sizes.l2_bytes = l2_bytes;
+    TILING_sizes.detected = 0;
+    TILING_ready          = 1;
+}
+
+static u32 TILING_rows_in(u32 budget, u32 in_row_bytes, u32 out_row_bytes){
+    u32 halo = 2 * in_row_bytes;
+
+    if(budget <= halo || in_row_bytes + out_row_bytes == 0){
+        return 0;
+    }
+    return (budget - halo) / (in_row_bytes + out_row_bytes);
+}
+
+u32 TILING_conv_rows(u32 in_row_bytes, u32 out_row_bytes, u32 out_height, u32 align){
+    const Tiling_Caches *caches = TILING_caches();
+    u32 rows;
+
+    rows = TILING_rows_in(caches->l1_bytes / TILING_L1_SHARE, in_row_bytes, out_row_bytes);
+    if(rows < TILING_MIN_ROWS){
+        rows = TILING_rows_in(caches->l2_bytes / TILING_L2_SHARE, in_row_bytes, out_row_bytes);
+    }
+
+    if(align > 1){
+        rows -= rows % align;
+    }
+    if(rows < TILING_MIN_ROWS){
+        rows = (align > TILING_MIN_ROWS) ? align : TILING_MIN_ROWS;
+    }
+
+    return (rows < out_height) ? rows : out_height;
+}
@@ -0,0 +1,42 @@
+
+#ifndef NET_ENGINE_TILING_H
+#define NET_ENGINE_TILING_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+
+/**************************** Type Definitions *****************************/
+#define TILING_L1_BYTES     (32 * 1024)     // Cortex-A9 L1 data cache, used when it cannot be read back
+#define TILING_L2_BYTES     (512 * 1024)    // Zynq-7000 PL310
+#define TILING_L1_SHARE     2               // a band gets 1 / TILING_L1_SHARE of L1, weights and stack keep the rest
+#define TILING_L2_SHARE     4               // L2 is shared with the other core and the DMA buffers
+#define TILING_MIN_ROWS     4               // below this the halo rows cost more than the cache saves
+
+typedef struct Tiling_Caches_{
+    u32 l1_bytes;
+    u32 l2_bytes;
+    u8  detected;
+} Tiling_Caches;
+
+/************************** Function Prototypes ****************************/
+
+/**
+ * Cache sizes the bands are sized for. On target they are read from the
+ * CP15 cache size registers and the PL310 auxiliary control register on
+ * first use, elsewhere the TILING_L*_BYTES defaults apply.
+ */
+const Tiling_Caches* TILING_caches(void);
+
+// configured sizes, overriding detection
+void TILING_set_caches(u32 l1_bytes, u32 l2_bytes);
+
+/**
+ * Output rows per band of a valid 3x3 convolution. A band keeps in_row_bytes
+ * per input row (band + 2 halo rows) and out_row_bytes per output row live;
+ * the band is sized to the L1 budget, or the L2 budget when fewer than
+ * TILING_MIN_ROWS fit. The result is a multiple of align, at most out_height.
+ */
+u32 TILING_conv_rows(u32 in_row_bytes, u32 out_row_bytes, u32 out_height, u32 align);
+
+#endif // NET_ENGINE_TILING_H
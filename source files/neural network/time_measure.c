@@ -1,4 +1,5 @@
 #include "time_measure.h"
+#include "profiler.h"
 #include "xparameters.h"
 #include "xgpio_l.h"
 
@@ -9,12 +10,21 @@
 #define  MEASURE_SIGNAL_ADDR   XPAR_AXI_GPIO_0_BASEADDR
 #define  MEASURE_SIGNAL_CHAN   1
 
+// also time every signal in software, see PROFILER_report
+#ifndef MEASURE_PROFILE
+#define  MEASURE_PROFILE
+#endif
+
 
 void measure_init(){
     XGpio_WriteReg((MEASURE_SIGNAL_ADDR),
         ((MEASURE_SIGNAL_CHAN - 1) * XGPIO_CHAN_OFFSET) +
         XGPIO_TRI_OFFSET, 0);
 
+#ifdef MEASURE_PROFILE
+    PROFILER_init();
+#endif
+
 }
 
 
@@ -27,10 +37,19 @@ void measure_start(u32 signal){
     XGpio_WriteReg((MEASURE_SIGNAL_ADDR),
             ((MEASURE_SIGNAL_CHAN - 1) * XGPIO_CHAN_OFFSET) +
             XGPIO_DATA_OFFSET, Data | (1 << (signal-1)));
+
+#ifdef MEASURE_PROFILE
+    PROFILER_begin(signal - 1);
+#endif
 }
 
 void measure_end(u32 signal){
     u32 Data;
+
+#ifdef MEASURE_PROFILE
+    PROFILER_end(signal - 1);
+#endif
+
     Data = XGpio_ReadReg(MEASURE_SIGNAL_ADDR,
             ((MEASURE_SIGNAL_CHAN - 1) * XGPIO_CHAN_OFFSET) +
                 XGPIO_DATA_OFFSET);
@@ -0,0 +1,85 @@
+#include "trace.h"
+#include "profiler.h"
+#include <xil_printf.h>
+
+#ifdef __linux__
+#include <stdio.h>
+#endif
+
+static Trace_Event TRACE_events[TRACE_MAX_EVENTS];
+static u32         TRACE_count;
+static u32         TRACE_dropped;
+
+void TRACE_init(void){
+    TRACE_count   = 0;
+    TRACE_dropped = 0;
+}
+
+void TRACE_record(const char *name, u8 phase, u16 arg, TRACE_TRACK track){
+    Trace_Event *event;
+    u32 index;
+
+    // the ISRs record too, so claim the slot with a compare and swap (ldrex / strex on the A9)
+    index = __atomic_load_n(&TRACE_count, __ATOMIC_RELAXED);
+    do{
+        if(index == TRACE_MAX_EVENTS){
+            __atomic_fetch_add(&TRACE_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }while(!__atomic_compare_exchange_n(&TRACE_count, &index, index + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    event = &TRACE_events[index];
+    event->timestamp = PROFILER_now();
+    event->name      = name;
+    event->phase     = phase;
+    event->arg       = arg;
+    event->track     = track;
+}
+
+#ifdef __linux__
+#define TRACE_print(...)    fprintf(file, __VA_ARGS__)
+#else
+#define TRACE_print(...)    xil_printf(__VA_ARGS__)
+#endif
+
+int TRACE_dump(void){
+    const Trace_Event *event;
+    u64 origin;
+    u64 ns;
+
+#ifdef __linux__
+    FILE *file = fopen(TRACE_FILE, "w");
+    if(file == NULL){
+        xil_printf("Trace: cannot open %s \r\n", TRACE_FILE);
+        return -1;
+    }
+#endif
+
+    origin = (TRACE_count > 0) ? TRACE_events[0].timestamp : 0;
+
+    TRACE_print("{\"traceEvents\":[\n");
+    for(u32 index = 0; index < TRACE_count; index++){
+        event = &TRACE_events[index];
+        // microseconds with ns resolution, relative to the first event
+        ns = PROFILER_ticks_to_ns(event->timestamp - origin);
+
+        TRACE_print("{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%d.%03d,\"pid\":0,\"tid\":%d",
+                    event->name, event->phase, (u32)(ns / 1000), (u32)(ns % 1000), event->track);
+        if(event->phase == 'i'){
+            TRACE_print(",\"s\":\"t\"");
+        }
+        if(event->phase != 'E'){
+            TRACE_print(",\"args\":{\"index\":%d}", event->arg);
+        }
+        TRACE_print("}%s\n", (index + 1 < TRACE_count) ? "," : "");
+    }
+    TRACE_print("],\"otherData\":{\"dropped\":%d}}\n", TRACE_dropped);
+
+#ifdef __linux__
+    fclose(file);
+    xil_printf("Trace: %d events written to %s \r\n", TRACE_count, TRACE_FILE);
+#endif
+
+    TRACE_init();
+    return 0;
+}
@@ -0,0 +1,64 @@
+
+#ifndef NET_ENGINE_TRACE_H
+#define NET_ENGINE_TRACE_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+
+/**************************** Type Definitions *****************************/
+
+// record begin / end events for a Chrome trace (chrome://tracing, ui.perfetto.dev)
+// #define USE_TRACE
+
+#define TRACE_MAX_EVENTS    16384
+#define TRACE_FILE          "pnet_trace.json"
+
+// one timeline row per context, begin / end pairs only nest within a track
+typedef enum{
+    TRACE_TRACK_CPU,
+    TRACE_TRACK_ISR,
+} TRACE_TRACK;
+
+typedef struct Trace_Event_{
+    const char *name;           // string literal, only the pointer is stored
+    u64         timestamp;
+    u16         arg;
+    u8          phase;          // 'B', 'E' or 'i'
+    u8          track;
+} Trace_Event;
+
+#ifdef USE_TRACE
+#define TRACE_BEGIN(name, arg)          TRACE_record((name), 'B', (arg), TRACE_TRACK_CPU)
+#define TRACE_END(name)                 TRACE_record((name), 'E', 0, TRACE_TRACK_CPU)
+#define TRACE_BEGIN_ISR(name, arg)      TRACE_record((name), 'B', (arg), TRACE_TRACK_ISR)
+#define TRACE_END_ISR(name)             TRACE_record((name), 'E', 0, TRACE_TRACK_ISR)
+#define TRACE_INSTANT(name, arg)        TRACE_record((name), 'i', (arg), TRACE_TRACK_CPU)
+#define TRACE_INSTANT_ISR(name, arg)    TRACE_record((name), 'i', (arg), TRACE_TRACK_ISR)
+#else
+#define TRACE_BEGIN(name, arg)
+#define TRACE_END(name)
+#define TRACE_BEGIN_ISR(name, arg)
+#define TRACE_END_ISR(name)
+#define TRACE_INSTANT(name, arg)
+#define TRACE_INSTANT_ISR(name, arg)
+#endif
+
+/************************** Function Prototypes ****************************/
+
+void TRACE_init(void);
+
+/**
+ * Appends one event to the preallocated buffer. Once the buffer is full
+ * further events are counted as dropped, so a trace always starts at
+ * TRACE_init and never wraps. Safe to call from the ISRs.
+ */
+void TRACE_record(const char *name, u8 phase, u16 arg, TRACE_TRACK track);
+
+/**
+ * Writes the buffer as Chrome trace JSON, to TRACE_FILE on Linux or over
+ * the UART (xil_printf) on target, then clears it.
+ */
+int TRACE_dump(void);
+
+#endif // NET_ENGINE_TRACE_H
@@ -1,4 +1,5 @@
 #include "utility.h"
+#include "kernels.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,259 +7,130 @@
 
 #define STRIDE   1
 #define CELLSIZE 20
-#define NMS_THRESHOLD 0.5
 
 
-// add channel size
-BoundingBox* BBOX_create(u8 index, float q1_x, float q1_y, float q2_x, float q2_y, float score, float nscore, float dx1, float dy1, float dx2, float dy2){
-    BoundingBox *instance = NULL;
+int BBOX_buffer_init(BoundingBox_Buffer *instance, void *memory, u32 memory_len){
+    float *fields   = (float*)memory;
+    u32    capacity = memory_len / (BBOX_FIELDS * sizeof(float));
 
-    instance = (BoundingBox *)malloc(sizeof(BoundingBox));
-    if (instance == NULL) {
-        printf("BoundingBox malloc failed\n");
-        return NULL;
+    if(memory == NULL || capacity == 0){
+        return -1;
     }
-    
-    instance->index = index;
-    instance->q1_x = q1_x;
-    instance->q1_y = q1_y;
-    instance->q2_x = q2_x;
-    instance->q2_y = q2_y;
-    instance->score = score;
-    instance->nscore = nscore;
-    instance->dx1 = dx1;
-    instance->dy1 = dy1;
-    instance->dx2 = dx2;
-    instance->dy2 = dy2;
-
-    return instance;
-}
 
-static BoundingBox_Node* create_bbox_node(BoundingBox data){
-    BoundingBox_Node* new = (BoundingBox_Node*)malloc(sizeof(BoundingBox_Node));
-    if(new == NULL){
-        xil_printf("Node malloc error \r\n");
-        return NULL;
-    }
-    new->data = data;
-    new->next = NULL;
+    instance->capacity = capacity;
+    instance->cell     = (u32*)fields;
+    instance->score    = fields + (1  * capacity);
+    instance->nscore   = fields + (2  * capacity);
+    instance->q1_x     = fields + (3  * capacity);
+    instance->q1_y     = fields + (4  * capacity);
+    instance->q2_x     = fields + (5  * capacity);
+    instance->q2_y     = fields + (6  * capacity);
+    instance->dx1      = fields + (7  * capacity);
+    instance->dy1      = fields + (8  * capacity);
+    instance->dx2      = fields + (9  * capacity);
+    instance->dy2      = fields + (10 * capacity);
+    BBOX_buffer_reset(instance);
 
-    return new;
+    return 0;
 }
 
-static void append_bbox(BoundingBox_Node** head_ref, BoundingBox new_data) {
-    BoundingBox_Node* new = create_bbox_node(new_data);
-    if (new == NULL) {
-        return;
-    }
-
-    if (*head_ref == NULL) {
-        *head_ref = new;
-        return;
-    }
-
-    BoundingBox_Node* last = (BoundingBox_Node*)*head_ref;
-    while (last->next != NULL) {
-        last = (BoundingBox_Node*)last->next;
-    }
+void BBOX_buffer_reset(BoundingBox_Buffer *instance){
+    instance->count   = 0;
+    instance->dropped = 0;
+}
 
-    last->next = new;
+void BBOX_buffer_slice(const BoundingBox_Buffer *instance, u32 first, BoundingBox_Buffer *slice){
+    first = (first < instance->count) ? first : instance->count;
+
+    slice->count    = instance->count - first;
+    slice->capacity = instance->capacity - first;
+    slice->dropped  = 0;
+    slice->cell     = instance->cell   + first;
+    slice->score    = instance->score  + first;
+    slice->nscore   = instance->nscore + first;
+    slice->q1_x     = instance->q1_x   + first;
+    slice->q1_y     = instance->q1_y   + first;
+    slice->q2_x     = instance->q2_x   + first;
+    slice->q2_y     = instance->q2_y   + first;
+    slice->dx1      = instance->dx1    + first;
+    slice->dy1      = instance->dy1    + first;
+    slice->dx2      = instance->dx2    + first;
+    slice->dy2      = instance->dy2    + first;
 }
 
-void removeAtIndex(BoundingBox_Node** head, int index) {
-    printf("removeAtIndex start \n");
-    if (*head == NULL) {
-        printf("List is empty\n");
-        return;
-    }
+u32 BBOX_gather(BoundingBox_Buffer *boxes, const float *const heads[6], const u32 *cells, u32 count, u32 width, float scale){
+    u32 first = boxes->count;
+    u32 cell;
+
+    if(count > boxes->capacity - first){
+        boxes->dropped += count - (boxes->capacity - first);
+        count = boxes->capacity - first;
+    }
+
+    // gathers stay scalar, the decode below runs on the cell coordinates
+    for(u32 box = first, i = 0; i < count; box++, i++){
+        cell = cells[i];
+        boxes->cell[box]   = cell;
+        boxes->nscore[box] = heads[0][cell];
+        boxes->score[box]  = heads[1][cell];
+        boxes->dx1[box]    = heads[2][cell];
+        boxes->dy1[box]    = heads[3][cell];
+        boxes->dx2[box]    = heads[4][cell];
+        boxes->dy2[box]    = heads[5][cell];
+        boxes->q1_x[box]   = (float)(cell % width);
+        boxes->q1_y[box]   = (float)(cell / width);
+    }
+    KERNEL_bbox_decode(&boxes->q1_x[first], &boxes->q1_y[first], &boxes->q2_x[first], &boxes->q2_y[first], count,
+                       STRIDE, CELLSIZE, scale);
+
+    boxes->count += count;
+    return count;
+}
 
-    BoundingBox_Node* temp = *head;
+u32 BBOX_extract(BoundingBox_Buffer *boxes, const float *const heads[6], u32 height, u32 width, float scale, float threshold){
+    u32 first = boxes->count;
+    u32 found;
 
-    // Special case: removing the head node
-    if (index == 0) {
-        *head = temp->next;
-        if(temp){
-            printf("removeAtIndex free 0\n");
-            free(temp);
+    found = KERNEL_threshold_compact(heads[1], height * width, threshold, &boxes->cell[first], boxes->capacity - first);
+    if(found == boxes->capacity - first){
+        // a full buffer may have cut the scan short, count what is left
+        for(u32 i = (found != 0) ? boxes->cell[first + found - 1] + 1 : 0; i < height * width; i++){
+            boxes->dropped += (heads[1][i] >= threshold) ? 1 : 0;
         }
-        return;
     }
 
-    // Traverse to the node before the one we want to remove
-    BoundingBox_Node* prev = NULL;
-    int count = 0;
-    while (temp != NULL && temp->data.index != index) {
-        prev = temp;
-        temp = temp->next;
-        count++;
-    }
-
-    // If index is out of bounds
-    if (temp == NULL) {
-        printf("Index out of bounds\n");
-        return;
-    }
-
-    // Remove the node
-    prev->next = temp->next;
-    if(temp){
-        printf("removeAtIndex free 1\n");
-        free(temp);
-    }
-    printf("removeAtIndex end \n");
+    // the cells are gathered where the scan wrote them
+    return BBOX_gather(boxes, heads, &boxes->cell[first], found, width, scale);
 }
 
-// Function to generate bounding boxes from CNN outputs
-void generate_bounding_boxes(Layer * layer_imap, Layer *reg, int width, int height, float scale, float threshold, BoundingBox_Node **boundingbox, int *num_boxes) {
-    Channel_Node *chan_node_1 = (Channel_Node *)reg->output_channels.channels;
-    Channel_Node *chan_node_2 = (Channel_Node *)chan_node_1->next;
-    Channel_Node *chan_node_3 = (Channel_Node *)chan_node_2->next;
-    Channel_Node *chan_node_4 = (Channel_Node *)chan_node_3->next;
-
-    Channel_Node *no_face_score = (Channel_Node *)layer_imap->output_channels.channels;
-    Channel_Node *face_score    = (Channel_Node *)no_face_score->next;
-
-    BoundingBox *bbox_ins = NULL;
-
-    width = chan_node_1->data.width;
-    height = chan_node_1->data.height;
-
-    printf("width(%d) height(%d) \n", width, height);
-
-    float *transposed_nimap = (float *)no_face_score->data.output_ptr;
-    float *transposed_imap = (float *)face_score->data.output_ptr;
-    float *transposed_dx1 = (float *)chan_node_1->data.output_ptr;
-    float *transposed_dy1 = (float *)chan_node_2->data.output_ptr;
-    float *transposed_dx2 = (float *)chan_node_3->data.output_ptr;
-    float *transposed_dy2 = (float *)chan_node_4->data.output_ptr;
+int BBOX_layer_heads(const Layer *layer_imap, const Layer *reg, const float *heads[6], u32 *height, u32 *width){
+    const Channel_Node *channel;
+    u32 plane = 0;
 
-    int *temp_boxes = (int *)malloc(width * height * sizeof(int));
-    int box_count = 0;
-    
-    for (int i = 0; i < width * height; ++i) {
-        if (transposed_imap[i] >= threshold ) {
-            temp_boxes[box_count++] = i;
-        }
+    for(channel = layer_imap->output_channels.channels; channel != NULL && plane < 2; channel = (const Channel_Node*)channel->next){
+        heads[plane++] = (const float*)channel->data.output_ptr;
     }
-    
-    // printf("Detected Box Count %d \n", box_count);
-    if (box_count == 0) {
-        *num_boxes = 0;
+    for(channel = reg->output_channels.channels; channel != NULL && plane < 6; channel = (const Channel_Node*)channel->next){
+        heads[plane++] = (const float*)channel->data.output_ptr;
     }
-
-    (*boundingbox)       = NULL;
-    // (*boundingbox)->next = NULL;
-    
-    // *boundingbox = (float *)malloc(box_count * sizeof(BoundingBox));
-    *num_boxes = box_count;
-
-    int idx = 0, x = 0, y = 0;
-    float score = 0.0f, nscore = 0.0f;
-    float dx1 = 0.0f, dy1 = 0.0f, dx2 = 0.0f, dy2 = 0.0f;
-    float q1_x = 0.0f, q1_y = 0.0f, q2_x = 0.0f, q2_y = 0.0f;
-
-    for (int i = 0; i < box_count; ++i) {
-        idx = temp_boxes[i];
-        y = idx / width;
-        x = idx % width;
-
-        score = transposed_imap[idx];
-        nscore = transposed_nimap[idx];
-        dx1 = transposed_dx1[idx];
-        dy1 = transposed_dy1[idx];
-        dx2 = transposed_dx2[idx];
-        dy2 = transposed_dy2[idx];
-
-        q1_x = roundf((STRIDE * x + 1) / scale);
-        q1_y = roundf((STRIDE * y + 1) / scale);
-        q2_x = roundf((STRIDE * x + CELLSIZE) / scale);
-        q2_y = roundf((STRIDE * y + CELLSIZE) / scale);
-
-        bbox_ins = BBOX_create(
-            i,
-            q1_x, q1_y,
-            q2_x, q2_y,
-            score, nscore,
-            dx1, dy1,
-            dx2, dy2
-        );
-
-        append_bbox(boundingbox, *bbox_ins);
-
-        printf("I(%d) X(%d) Y(%d) score(%f) nscore(%f) q1_x(%f) q1_y(%f) q2_x(%f) q2_y(%f) dx1(%f) dy1(%f) dx2(%f) dy2(%f)\n",
-            i, x, y, score, nscore, q1_x + dx1, q1_y + dy1, q2_x + dx2, q2_y + dy2, dx1, dy1, dx2, dy2
-        );
-
+    if(plane != 6){
+        return -1;
     }
 
-    free(temp_boxes);
+    *height = reg->output_channels.channels->data.height;
+    *width  = reg->output_channels.channels->data.width;
+    return 0;
 }
 
+u32 generate_bounding_boxes(const Layer *layer_imap, const Layer *reg, float scale, float threshold, BoundingBox_Buffer *boxes){
+    const float *heads[6];
+    u32 height;
+    u32 width;
 
-float calculate_iou(BoundingBox box1, BoundingBox box2) {
-
-    float x1 = fmax(box1.q1_x, box2.q1_x);
-    float y1 = fmax(box1.q1_y, box2.q1_y);
-    float x2 = fmin(box1.q2_x, box2.q2_x);
-    float y2 = fmin(box1.q2_y, box2.q2_y);
-
-    float inter_area = fmax(0, x2 - x1) * fmax(0, y2 - y1);
-    float box1_area = (box1.q2_x - box1.q1_x) * (box1.q2_y - box1.q1_y);
-    float box2_area = (box2.q2_x - box2.q1_x) * (box2.q2_y - box2.q1_y);
-
-    if ((inter_area == 0 || ((box1_area + box2_area - inter_area) == 0))){
-        return 0.0f;
+    if(BBOX_layer_heads(layer_imap, reg, heads, &height, &width) != 0){
+        return 0;
     }
-
-    printf("inter area %f : (%f, %f) - (%f, %f) \n", (inter_area / (box1_area + box2_area - inter_area)), 
-        box1.q1_x, box1.q1_y, box2.q1_x, box2.q1_y);
-    return inter_area / (box1_area + box2_area - inter_area);
-}
-
-void non_max_suppression(BoundingBox_Node* boxes, int *num_boxes) {
-    BoundingBox_Node* upper = boxes;
-    BoundingBox_Node* inner = boxes;
-
-    // check whether the channel loaded
-    if(upper == NULL || inner == NULL){
-        xil_printf("No output channel available \r\n");
-        return;
-    }
-
-    float iou = 0.0f;
-
-    while (upper != NULL){
-        while(inner != NULL){
-            if(!(upper->data.index == inner->data.index)){
-                printf("non_max_suppression 0 \n");
-                iou = calculate_iou(upper->data, inner->data);
-                printf("non_max_suppression 1 iou(%f) thres(%f)\n", iou, NMS_THRESHOLD);
-                if ( iou > (float)NMS_THRESHOLD) {
-                    printf("Start removed nms index upper(%d) inner(%d) \n", upper->data.index, inner->data.index);
-                    removeAtIndex(&upper, upper->data.index);
-                    printf("End removed nms index upper(%d) inner(%d) \n", upper->data.index, inner->data.index);
-                }
-            }
-
-            inner = inner->next;
-        }
-        // xil_printf(" before nms index %d \n", upper->data.index);
-        upper = upper->next;
-    }
-
-    upper = boxes;
-    int count = 0;
-    int prev_index = 0;
-
-    while (upper != NULL){
-        prev_index = upper->data.index;
-        upper->data.index = count;
-        count++;
-        upper = upper->next;
-    }
-
-    *num_boxes = count;
-
+    return BBOX_extract(boxes, heads, height, width, scale, threshold);
 }
 
 void rerec(BoundingBox* boxes) {
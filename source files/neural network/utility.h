@@ -18,15 +18,56 @@ typedef struct {
     float nscore;
 } BoundingBox;
 
-typedef struct BoundingBox_Node_{
-    struct BoundingBox_Node  *next;
-    BoundingBox              data;
-} BoundingBox_Node;
+#define BBOX_FIELDS     11      // float arrays of a BoundingBox_Buffer, the cell indices included
 
-void generate_bounding_boxes(Layer * layer_imap, Layer *reg, int width, int height, float scale, float threshold, BoundingBox_Node **boundingbox, int *num_boxes);
+// candidate boxes as one array per field, filled without allocating
+typedef struct BoundingBox_Buffer_{
+    u32    count;
+    u32    capacity;
+    u32    dropped;         // candidates that did not fit since the last reset
+    u32   *cell;            // y * width + x in the level's score plane
+    float *score;
+    float *nscore;
+    float *q1_x;
+    float *q1_y;
+    float *q2_x;
+    float *q2_y;
+    float *dx1;
+    float *dy1;
+    float *dx2;
+    float *dy2;
+} BoundingBox_Buffer;
 
-void image_resize(float* input, float* output, u32 height, u32 width, float scale_factor);
+/**
+ * Carves the arrays out of memory, memory_len bytes give room for
+ * memory_len / (BBOX_FIELDS * 4) boxes.
+ */
+int BBOX_buffer_init(BoundingBox_Buffer *instance, void *memory, u32 memory_len);
+
+void BBOX_buffer_reset(BoundingBox_Buffer *instance);
+
+/**
+ * Appends every cell of a height x width level whose face score reaches
+ * threshold. heads holds the no face and face scores followed by dx1, dy1,
+ * dx2 and dy2, as SCHEDULER_HEAD_PLANES. Returns the boxes added.
+ */
+u32 BBOX_extract(BoundingBox_Buffer *boxes, const float *const heads[6], u32 height, u32 width, float scale, float threshold);
+
+/**
+ * Appends the boxes of the count given cells of a width wide level, in the
+ * order given, and returns how many fit.
+ */
+u32 BBOX_gather(BoundingBox_Buffer *boxes, const float *const heads[6], const u32 *cells, u32 count, u32 width, float scale);
 
-void non_max_suppression(BoundingBox_Node* boxes, int *num_boxes);
+// the boxes from first on as a buffer of their own, sharing the arrays
+void BBOX_buffer_slice(const BoundingBox_Buffer *instance, u32 first, BoundingBox_Buffer *slice);
+
+// the head planes of the score (2 channels) and box (4 channels) layers and their size
+int BBOX_layer_heads(const Layer *layer_imap, const Layer *reg, const float *heads[6], u32 *height, u32 *width);
+
+// BBOX_extract on the output planes of the score and box layers
+u32 generate_bounding_boxes(const Layer *layer_imap, const Layer *reg, float scale, float threshold, BoundingBox_Buffer *boxes);
+
+void image_resize(float* input, float* output, u32 height, u32 width, float scale_factor);
 
 #endif // !UTILITY_H
\ No newline at end of file
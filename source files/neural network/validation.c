@@ -0,0 +1,583 @@
+#include "validation.h"
+#include "backend.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xil_printf.h>
+
+// the dumps are padded to a common size, only the leading CHW tensor is read
+static const struct{
+    const char *file;
+    u32         elements;
+} VALIDATION_golden_files[] = {
+    {"Layer 1/layer_CNN_1_98X98.bin",     98 * 98 * 10},
+    {"Layer 2/layer_Maxpool_49X49.bin",   49 * 49 * 10},
+    {"Layer 3/layer_CNN_2_47X47.bin",     47 * 47 * 16},
+    {"Layer 4/layer_CNN_3_45X45.bin",     45 * 45 * 32},
+    {"Layer 5/layer_CNN_4_45X45.bin",     45 * 45 * 2},
+    {"Layer 6/layer_CNN_5_45X45.bin",     45 * 45 * 4},
+};
+
+typedef struct{
+    const float *const *golden;
+    u32                 count;
+    Validation_Result  *results;
+    u32                 layer;
+} Validation_Context;
+
+#ifdef __linux__
+int VALIDATION_load_golden(const float **golden, u32 count, const char *root){
+    char   path[256];
+    FILE  *file;
+    float *data;
+    long   size;
+    size_t bytes;
+
+    if(count > sizeof(VALIDATION_golden_files) / sizeof(VALIDATION_golden_files[0])){
+        return -1;
+    }
+
+    for(u32 index = 0; index < count; index++){
+        golden[index] = NULL;
+    }
+
+    for(u32 index = 0; index < count; index++){
+        snprintf(path, sizeof(path), "%s/%s", root, VALIDATION_golden_files[index].file);
+        file = fopen(path, "rb");
+        if(file == NULL){
+            xil_printf("Validation: cannot open %s \r\n", path);
+            VALIDATION_free_golden(golden, count);
+            return -1;
+        }
+
+        bytes = VALIDATION_golden_files[index].elements * sizeof(float);
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if(size < 0 || (size_t)size < bytes){
+            xil_printf("Validation: %s holds %d bytes, expected %d \r\n", path, (int)size, (int)bytes);
+            fclose(file);
+            VALIDATION_free_golden(golden, count);
+            return -1;
+        }
+
+        data = (float*)malloc(bytes);
+        if(data == NULL || fread(data, 1, bytes, file) != bytes){
+            free(data);
+            fclose(file);
+            VALIDATION_free_golden(golden, count);
+            return -1;
+        }
+        fclose(file);
+        golden[index] = data;
+    }
+
+    return 0;
+}
+
+void VALIDATION_free_golden(const float **golden, u32 count){
+    for(u32 index = 0; index < count; index++){
+        free((void*)golden[index]);
+        golden[index] = NULL;
+    }
+}
+#endif
+
+// distance in representable floats, sign-magnitude mapped onto a monotonic integer line
+static u32 VALIDATION_ulp(float a, float b){
+    s32 x;
+    s32 y;
+
+    memcpy(&x, &a, sizeof(x));
+    memcpy(&y, &b, sizeof(y));
+    if(x < 0){
+        x = (s32)0x80000000 - x;
+    }
+    if(y < 0){
+        y = (s32)0x80000000 - y;
+    }
+
+    return (x > y) ? (u32)(x - y) : (u32)(y - x);
+}
+
+static void VALIDATION_compare(const Layer *layer, const float *golden, Validation_Result *result){
+    Channel_Node *channel = layer->output_channels.channels;
+    const float  *output;
+    float reference;
+    float error;
+    u32   ulp;
+    double error_sum = 0.0;
+
+    memset(result, 0, sizeof(Validation_Result));
+
+    while(channel != NULL){
+        output = (const float*)channel->data.output_ptr;
+
+        for(u32 y = 0; y + VALIDATION_MARGIN < channel->data.height; y++){
+            for(u32 x = 0; x + VALIDATION_MARGIN < channel->data.width; x++){
+                reference = golden[(y * channel->data.width) + x];
+                error     = fabsf(output[(y * channel->data.width) + x] - reference);
+                ulp       = VALIDATION_ulp(output[(y * channel->data.width) + x], reference);
+
+                result->compared++;
+                error_sum += error;
+                if(!(error <= VALIDATION_ABS_TOL + (VALIDATION_REL_TOL * fabsf(reference)))){
+                    result->mismatches++;
+                }
+                if(error > result->max_abs || error != error){
+                    result->max_abs = error;
+                }
+                if(ulp > result->max_ulp){
+                    result->max_ulp = ulp;
+                }
+                if(fabsf(reference) > result->max_reference){
+                    result->max_reference = fabsf(reference);
+                }
+            }
+        }
+
+        // the reference dumps hold one dense plane after the other
+        golden  += channel->data.height * channel->data.width;
+        channel  = (Channel_Node*)channel->next;
+    }
+
+    if(result->compared != 0){
+        result->mean_abs = (float)(error_sum / result->compared);
+    }
+}
+
+static int VALIDATION_layer_done(const Layer *layer, void *context){
+    Validation_Context *instance = (Validation_Context*)context;
+
+    if(instance->layer < instance->count){
+        VALIDATION_compare(layer, instance->golden[instance->layer], &instance->results[instance->layer]);
+    }
+    instance->layer++;
+
+    return 0;
+}
+
+int VALIDATION_run(NeuralNetwork *network, u32 height, u32 width, const float *const *golden, u32 count, Validation_Result *results){
+    Validation_Context context = {golden, count, results, 0};
+    int failed = 0;
+
+    if(count > VALIDATION_MAX_LAYERS || NEURAL_NETWORK_update(network, height, width) != 0){
+        return -1;
+    }
+
+    if(NEURAL_NETWORK_process_cb(network, VALIDATION_layer_done, &context) != 0){
+        return -1;
+    }
+
+    for(u32 index = 0; index < count; index++){
+        if(results[index].mismatches != 0){
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+int VALIDATION_run_backends(NeuralNetwork *network, u32 height, u32 width, const float *const *golden, u32 count){
+    Validation_Result results[VALIDATION_MAX_LAYERS];
+    CONV_BACKEND backend_after = CONV_BACKEND_NET_ENGINE;
+    const Conv_Backend_Entry *entry;
+    NN_Layer_Node *cur_layer;
+    int failed = 0;
+    int ret;
+
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next){
+        if(cur_layer->layer.type == LAYER_TYPE_CNN_3X3){
+            backend_after = cur_layer->layer.conv_backend;
+            break;
+        }
+    }
+
+    printf("Validation: backend, layer, compared, mismatches, max abs, max ulp, max |ref| \n");
+
+    for(u32 backend = 0; backend < CONV_BACKEND_COUNT; backend++){
+        // a split layer is checked bit exact against the engine, see VALIDATION_run_exact
+        if(backend == CONV_BACKEND_SPLIT){
+            continue;
+        }
+        entry = BACKEND_get((CONV_BACKEND)backend);
+        if(NEURAL_NETWORK_set_conv_backend(network, entry->backend) != 0){
+            printf("\t%s, skipped \n", entry->name);
+            continue;
+        }
+
+        ret = VALIDATION_run(network, height, width, golden, count, results);
+        if(ret < 0){
+            printf("\t%s, run failed \n", entry->name);
+            failed++;
+            continue;
+        }
+
+        for(u32 layer = 0; layer < count; layer++){
+            printf("\t%s, %d, %d, %d, %g, %d, %g %s\n", entry->name, layer + 1,
+                   results[layer].compared, results[layer].mismatches, results[layer].max_abs,
+                   results[layer].max_ulp, results[layer].max_reference, (results[layer].mismatches != 0) ? "FAIL" : "");
+        }
+        failed += ret;
+    }
+
+    NEURAL_NETWORK_set_conv_backend(network, backend_after);
+    return failed;
+}
+
+typedef struct{
+    u32 layer;
+    u32 hashes[VALIDATION_MAX_LAYERS];
+} Validation_Hash_Context;
+
+typedef struct{
+    u32                      count;
+    Validation_Hash_Context *frames;
+} Validation_Batch_Context;
+
+// FNV-1a over the output words inside VALIDATION_MARGIN, offset words into every channel
+static u32 VALIDATION_hash_layer(const Layer *layer, u32 offset){
+    Channel_Node *channel;
+    const u32    *output;
+    u32 hash = 2166136261u;
+
+    for(channel = layer->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+        output = channel->data.output_ptr + offset;
+        for(u32 y = 0; y + VALIDATION_MARGIN < channel->data.height; y++){
+            for(u32 x = 0; x + VALIDATION_MARGIN < channel->data.width; x++){
+                hash = (hash ^ output[(y * channel->data.width) + x]) * 16777619u;
+            }
+        }
+    }
+
+    return hash;
+}
+
+static void VALIDATION_hash_store(Validation_Hash_Context *instance, u32 hash){
+    if(instance->layer < VALIDATION_MAX_LAYERS){
+        instance->hashes[instance->layer] = hash;
+    }
+    instance->layer++;
+}
+
+static int VALIDATION_hash_done(const Layer *layer, void *context){
+    VALIDATION_hash_store((Validation_Hash_Context*)context, VALIDATION_hash_layer(layer, 0));
+    return 0;
+}
+
+static int VALIDATION_batch_done(const Layer *layer, void *context){
+    Validation_Batch_Context *instance = (Validation_Batch_Context*)context;
+
+    for(u32 frame = 0; frame < instance->count; frame++){
+        VALIDATION_hash_store(&instance->frames[frame], VALIDATION_hash_layer(layer, frame * layer->batch.out_stride));
+    }
+    return 0;
+}
+
+static int VALIDATION_hash_run(NeuralNetwork *network, CONV_BACKEND backend, Validation_Hash_Context *context){
+    context->layer = 0;
+    if(NEURAL_NETWORK_set_conv_backend(network, backend) != 0){
+        return -1;
+    }
+    return NEURAL_NETWORK_process_cb(network, VALIDATION_hash_done, context);
+}
+
+int VALIDATION_run_exact(NeuralNetwork *network, u32 height, u32 width){
+    static const CONV_BACKEND emulations[] = {CONV_BACKEND_CPU_ENGINE, CONV_BACKEND_SPLIT};
+    const Conv_Backend_Entry *entry;
+    Validation_Hash_Context reference;
+    Validation_Hash_Context emulated;
+    CONV_BACKEND backend_after = CONV_BACKEND_NET_ENGINE;
+    NN_Layer_Node *cur_layer;
+    int failed = 0;
+
+    for(cur_layer = network->layers; cur_layer != NULL; cur_layer = (NN_Layer_Node*)cur_layer->next){
+        if(cur_layer->layer.type == LAYER_TYPE_CNN_3X3){
+            backend_after = cur_layer->layer.conv_backend;
+            break;
+        }
+    }
+
+    if(NEURAL_NETWORK_update(network, height, width) != 0 ||
+       VALIDATION_hash_run(network, CONV_BACKEND_NET_ENGINE, &reference) != 0){
+        NEURAL_NETWORK_set_conv_backend(network, backend_after);
+        return -1;
+    }
+
+    printf("Validation: backend against net engine, layer, bit exact \n");
+    for(u32 index = 0; index < sizeof(emulations) / sizeof(emulations[0]); index++){
+        entry = BACKEND_get(emulations[index]);
+        if(VALIDATION_hash_run(network, entry->backend, &emulated) != 0){
+            printf("\t%s, run failed \n", entry->name);
+            failed++;
+            continue;
+        }
+
+        for(u32 layer = 0; layer < reference.layer && layer < VALIDATION_MAX_LAYERS; layer++){
+            printf("\t%s, %d, %s \n", entry->name, layer + 1, (reference.hashes[layer] == emulated.hashes[layer]) ? "yes" : "no FAIL");
+            if(reference.hashes[layer] != emulated.hashes[layer]){
+                failed++;
+            }
+        }
+    }
+
+    NEURAL_NETWORK_set_conv_backend(network, backend_after);
+    return failed;
+}
+
+int VALIDATION_run_batch(NeuralNetwork *network, u32 height, u32 width, u32 count){
+    Validation_Hash_Context batched[VALIDATION_BATCH_FRAMES];
+    Validation_Hash_Context single;
+    Validation_Batch_Context context = {count, batched};
+    Channel_Node *input;
+    u32 stride = height * width;
+    int failed = 0;
+
+    if(count > VALIDATION_BATCH_FRAMES || network->layers == NULL || NEURAL_NETWORK_update(network, height, width) != 0){
+        return -1;
+    }
+
+    memset(batched, 0, sizeof(batched));
+    if(NEURAL_NETWORK_process_batch_cb(network, count, stride, VALIDATION_batch_done, &context) != 0){
+        printf("\tbatch, run failed \n");
+        return -1;
+    }
+
+    printf("Validation: batch against single frame, frame, layer, bit exact \n");
+    for(u32 frame = 0; frame < count; frame++){
+        // a single frame run reads frame 0, frames after it are still in place
+        if(frame > 0){
+            for(input = network->layers->layer.input_channels.channels; input != NULL; input = (Channel_Node*)input->next){
+                memcpy(input->data.input_ptr, input->data.input_ptr + (frame * stride), stride * sizeof(float));
+            }
+        }
+
+        single.layer = 0;
+        if(NEURAL_NETWORK_process_cb(network, VALIDATION_hash_done, &single) != 0){
+            printf("\tsingle, run failed \n");
+            return -1;
+        }
+
+        for(u32 layer = 0; layer < single.layer && layer < VALIDATION_MAX_LAYERS; layer++){
+            printf("\tbatch, %d, %d, %s \n", frame, layer + 1, (batched[frame].hashes[layer] == single.hashes[layer]) ? "yes" : "no FAIL");
+            if(batched[frame].hashes[layer] != single.hashes[layer]){
+                failed++;
+            }
+        }
+    }
+
+    return failed;
+}
+
+int VALIDATION_run_fused(Fusion *fusion, u32 height, u32 width, const float *const *golden, u32 count){
+    Validation_Result result;
+    const Fusion_Stage *stage;
+    int failed = 0;
+
+    if(NEURAL_NETWORK_update(fusion->network, height, width) != 0 || FUSION_process(fusion) != 0){
+        printf("\tfused, run failed \n");
+        return -1;
+    }
+
+    for(u32 layer = 0; layer < count && layer < fusion->stage_count; layer++){
+        stage = &fusion->stages[layer];
+        // intermediate layers only ever held a few rows
+        if(stage->depth != 0){
+            continue;
+        }
+
+        VALIDATION_compare(stage->layer, golden[layer], &result);
+        printf("\tfused, %d, %d, %d, %g, %d, %g %s\n", layer + 1, result.compared, result.mismatches, result.max_abs,
+               result.max_ulp, result.max_reference, (result.mismatches != 0) ? "FAIL" : "");
+        if(result.mismatches != 0){
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+typedef struct{
+    const Quant_Network *quant;
+    float              **reference;
+} Validation_Capture_Context;
+
+// copies the float heads the int8 run is about to overwrite, dense like the dumps
+static int VALIDATION_capture_done(const Layer *layer, void *context){
+    Validation_Capture_Context *instance = (Validation_Capture_Context*)context;
+    Channel_Node *channel;
+    float *copy;
+    u32    plane;
+
+    for(u32 index = 0; index < instance->quant->layer_count; index++){
+        if(instance->quant->layers[index].layer != layer || !instance->quant->layers[index].head){
+            continue;
+        }
+
+        plane = layer->output_channels.channels->data.height * layer->output_channels.channels->data.width;
+        copy  = (float*)malloc(layer->output_channels.count * plane * sizeof(float));
+        if(copy == NULL){
+            return -1;
+        }
+        instance->reference[index] = copy;
+        for(channel = layer->output_channels.channels; channel != NULL; channel = (Channel_Node*)channel->next){
+            memcpy(copy, channel->data.output_ptr, plane * sizeof(float));
+            copy += plane;
+        }
+    }
+
+    return 0;
+}
+
+// face probabilities (second plane, see BBOX_layer_heads) on the other side of threshold
+static u32 VALIDATION_score_flips(const Layer *layer, const float *golden, float threshold){
+    const Channel_Node *face = (const Channel_Node*)layer->output_channels.channels->next;
+    const float *output;
+    u32 plane;
+    u32 flips = 0;
+
+    if(face == NULL){
+        return 0;
+    }
+    output = (const float*)face->data.output_ptr;
+    plane  = face->data.height * face->data.width;
+
+    golden += plane;
+    for(u32 y = 0; y + VALIDATION_MARGIN < face->data.height; y++){
+        for(u32 x = 0; x + VALIDATION_MARGIN < face->data.width; x++){
+            if((output[(y * face->data.width) + x] >= threshold) != (golden[(y * face->data.width) + x] >= threshold)){
+                flips++;
+            }
+        }
+    }
+
+    return flips;
+}
+
+// largest box offset error over the cells where the reference face probability passes threshold
+static float VALIDATION_box_error(const Layer *layer, const float *golden, const float *score, float threshold){
+    const Channel_Node *channel;
+    const float *output;
+    u32   plane = layer->output_channels.channels->data.height * layer->output_channels.channels->data.width;
+    u32   width = layer->output_channels.channels->data.width;
+    float error;
+    float max_error = 0.0f;
+
+    score += plane;
+    for(channel = layer->output_channels.channels; channel != NULL; channel = (const Channel_Node*)channel->next){
+        output = (const float*)channel->data.output_ptr;
+        for(u32 y = 0; y + VALIDATION_MARGIN < channel->data.height; y++){
+            for(u32 x = 0; x + VALIDATION_MARGIN < width; x++){
+                if(score[(y * width) + x] < threshold){
+                    continue;
+                }
+                error = fabsf(output[(y * width) + x] - golden[(y * width) + x]);
+                if(error > max_error || error != error){
+                    max_error = error;
+                }
+            }
+        }
+        golden += plane;
+    }
+
+    return max_error;
+}
+
+int VALIDATION_run_quant(Quant_Network *quant, u32 height, u32 width, const float *const *golden, u32 count, float threshold){
+    float *captured[VALIDATION_MAX_LAYERS] = {NULL};
+    Validation_Capture_Context context = {quant, captured};
+    Validation_Result result;
+    const Quant_Layer *layer;
+    const float *score = NULL;
+    float box_error;
+    u32 flips;
+    u8  fail;
+    int failed = 0;
+
+    if(NEURAL_NETWORK_update(quant->network, height, width) != 0){
+        printf("\tint8, run failed \n");
+        return -1;
+    }
+
+    if(golden == NULL){
+        printf("Validation: int8 against the float network, layer, compared, mismatches, max abs (mean), max ulp, max |ref|, gate \n");
+        if(NEURAL_NETWORK_process_cb(quant->network, VALIDATION_capture_done, &context) != 0){
+            printf("\tfloat, run failed \n");
+            failed = -1;
+        }
+        golden = (const float *const *)captured;
+        count  = quant->layer_count;
+    }
+
+    if(failed == 0 && QUANT_process(quant) != 0){
+        printf("\tint8, run failed \n");
+        failed = -1;
+    }
+
+    // the box head is only judged where the reference score head detects
+    for(u32 index = 0; failed >= 0 && index < count && index < quant->layer_count; index++){
+        if(quant->layers[index].head && quant->layers[index].layer->activation == LAYER_ACTIVATION_SOFTMAX){
+            score = golden[index];
+        }
+    }
+
+    for(u32 index = 0; failed >= 0 && index < count && index < quant->layer_count; index++){
+        layer = &quant->layers[index];
+        // the other layers only exist as int8 planes
+        if(!layer->head){
+            continue;
+        }
+
+        VALIDATION_compare(layer->layer, golden[index], &result);
+        printf("\tint8, %d, %d, %d, %g (mean %g), %d, %g, ", index + 1, result.compared, result.mismatches, result.max_abs,
+               result.mean_abs, result.max_ulp, result.max_reference);
+        if(layer->layer->activation == LAYER_ACTIVATION_SOFTMAX){
+            flips = VALIDATION_score_flips(layer->layer, golden[index], threshold);
+            fail  = (flips != 0);
+            printf("%d flips at %g", flips, threshold);
+        }
+        else{
+            box_error = (score != NULL) ? VALIDATION_box_error(layer->layer, golden[index], score, threshold) : result.max_abs;
+            fail      = !(box_error <= VALIDATION_INT8_BOX_TOL);
+            printf("%g at detections", box_error);
+        }
+        printf(" %s\n", fail ? "FAIL" : "");
+        if(fail){
+            failed++;
+        }
+    }
+
+    for(u32 index = 0; index < VALIDATION_MAX_LAYERS; index++){
+        free(captured[index]);
+    }
+    return failed;
+}
+
+int VALIDATION_run_half(Half_Network *half, u32 height, u32 width, const float *const *golden, u32 count){
+    Validation_Result result;
+    u8  fail;
+    int failed = 0;
+
+    if(NEURAL_NETWORK_update(half->network, height, width) != 0 || HALF_process(half) != 0){
+        printf("\thalf, run failed \n");
+        return -1;
+    }
+
+    for(u32 layer = 0; layer < count && layer < half->layer_count; layer++){
+        // the other layers only exist as half planes
+        if(!half->layers[layer].head){
+            continue;
+        }
+
+        VALIDATION_compare(half->layers[layer].layer, golden[layer], &result);
+        fail = !(result.mean_abs <= VALIDATION_HALF_TOL * result.max_reference);
+        printf("\thalf, %d, %d, %d, %g (mean %g), %d, %g %s\n", layer + 1, result.compared, result.mismatches, result.max_abs,
+               result.mean_abs, result.max_ulp, result.max_reference, fail ? "FAIL" : "");
+        if(fail){
+            failed++;
+        }
+    }
+
+    return failed;
+}
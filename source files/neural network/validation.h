@@ -0,0 +1,104 @@
+
+#ifndef NET_ENGINE_VALIDATION_H
+#define NET_ENGINE_VALIDATION_H
+
+
+/****************** Include Files ********************/
+#include "xil_types.h"
+#include "neural_network.h"
+#include "fusion.h"
+#include "quantize.h"
+#include "half.h"
+
+/**************************** Type Definitions *****************************/
+#define VALIDATION_MAX_LAYERS   PLAN_MAX_LAYERS
+#define VALIDATION_ABS_TOL      1e-3f
+#define VALIDATION_REL_TOL      1e-4f
+// the reference dumps carry an engine edge artefact in their last row and column
+#define VALIDATION_MARGIN       1
+// int8 box offsets (fractions of the 12 pixel cell) may be this far off where the reference detects a face
+#define VALIDATION_INT8_BOX_TOL 0.1f
+#define VALIDATION_HALF_TOL     0.001f
+
+#define VALIDATION_BATCH_FRAMES 4
+
+typedef struct Validation_Result_{
+    u32   compared;
+    u32   mismatches;           // outside VALIDATION_ABS_TOL + VALIDATION_REL_TOL * |reference|
+    float max_abs;
+    float mean_abs;
+    u32   max_ulp;
+    float max_reference;        // largest |reference|, to put max_abs in scale
+} Validation_Result;
+
+/************************** Function Prototypes ****************************/
+
+#ifdef __linux__
+/**
+ * Reads the data/outpus reference dumps (layer_*.bin, planar CHW floats)
+ * for the first count layers. root is the data/outpus directory.
+ */
+int VALIDATION_load_golden(const float **golden, u32 count, const char *root);
+
+/**
+ * Frees the buffers of VALIDATION_load_golden, NULL entries are skipped.
+ */
+void VALIDATION_free_golden(const float **golden, u32 count);
+#endif
+
+/**
+ * Runs the network once at height x width on whatever the input planes
+ * hold and compares every layer's output with golden[layer], results gets
+ * one entry per layer. Returns the number of layers out of tolerance.
+ */
+int VALIDATION_run(NeuralNetwork *network, u32 height, u32 width, const float *const *golden, u32 count, Validation_Result *results);
+
+/**
+ * VALIDATION_run for every 3x3 backend in turn, printing a report. The
+ * network's backend selection is restored afterwards.
+ */
+int VALIDATION_run_backends(NeuralNetwork *network, u32 height, u32 width, const float *const *golden, u32 count);
+
+/**
+ * Runs the network once on the Net Engine, then on CONV_BACKEND_CPU_ENGINE
+ * and CONV_BACKEND_SPLIT (with the layers' current shares), on whatever the
+ * input planes hold and reports, per layer, whether the outputs are bit
+ * identical to the engine's (through a hash, so nothing is buffered). The
+ * backend selection is restored afterwards.
+ */
+int VALIDATION_run_exact(NeuralNetwork *network, u32 height, u32 width);
+
+/**
+ * Runs count frames of height x width through NEURAL_NETWORK_process_batch,
+ * then each frame on its own, and reports per frame and layer whether the
+ * outputs are bit identical. The input planes hold the frames back to back,
+ * frame b height * width floats after frame 0, and are left holding the
+ * last frame.
+ */
+int VALIDATION_run_batch(NeuralNetwork *network, u32 height, u32 width, u32 count);
+
+/**
+ * Runs fusion once at height x width and compares the layers it writes out
+ * (those no other layer reads) with their golden dumps, printing a report.
+ */
+int VALIDATION_run_fused(Fusion *fusion, u32 height, u32 width, const float *const *golden, u32 count);
+
+/**
+ * Runs the int8 network once at height x width and compares its heads with
+ * golden, printing a report. The score head fails when any face probability
+ * lands on the other side of threshold than the reference, the box head when
+ * an offset is more than VALIDATION_INT8_BOX_TOL off at a cell the reference
+ * detects. With golden NULL the reference is the float network run on the
+ * same input, so inputs without dumps (and not seen by the calibration) can
+ * be checked.
+ */
+int VALIDATION_run_quant(Quant_Network *quant, u32 height, u32 width, const float *const *golden, u32 count, float threshold);
+
+/**
+ * Runs the network with half precision storage once at height x width and
+ * compares its heads with their golden dumps, printing a report. A head
+ * fails when its mean abs error exceeds VALIDATION_HALF_TOL * max |reference|.
+ */
+int VALIDATION_run_half(Half_Network *half, u32 height, u32 width, const float *const *golden, u32 count);
+
+#endif // NET_ENGINE_VALIDATION_H